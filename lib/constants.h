@@ -15,9 +15,6 @@
 #define CLUTPERCCELL 0.5
 // threshold value (on the external static clutter map!) above which gates are excluded as clutter
 #define CLUTTERVALUEMIN 0.1
-// each weather cell identified by findWeatherCells() is grown by a distance
-// equal to 'fringeDist' using a region-growing approach
-#define FRINGEDIST 5000.0
 // when determining whether there are enough vrad observations in
 // each direction, use NBINSGAP sectors
 #define NBINSGAP 8
@@ -114,6 +111,10 @@
 
 // maximum number of input files
 #define INPUTFILESMAX 50
+// maximum number of VPTS CSV files kept open when writing profiles of many volumes
+#define VPTSFILESOPENMAX 32
+// header of VPTS CSV files, see https://aloftdata.eu/vpts-csv
+#define VPTS_CSV_HEADER "radar,datetime,height,u,v,w,ff,dd,sd_vvp,gap,eta,dens,dbz,dbz_all,n,n_dbz,n_all,n_dbz_all,rcs,sd_vvp_threshold,vcp,radar_latitude,radar_longitude,radar_height,radar_wavelength,source_file\n"
 // Raw value used for gates or layers void of data (never ra-diated)
 #define UNDETECT -999
 // Raw value used for gates or layers when below the measurement detection threshold
@@ -189,6 +190,9 @@
 #define PRINT_POINTS_ARRAY 0
 // Whether or not to fit a model to the observed vrad
 #define FIT_VRAD 1
+// Whether to fit the VVP model by solving its 3x3 normal equations in closed form
+// instead of by singular value decomposition (used as fallback for ill-conditioned fits)
+#define VVP_CLOSED_FORM 0
 // Whether to export bird profile as JSON
 #define EXPORT_BIRD_PROFILE_AS_JSON 0
 // Scans with Nyquist velocity lower than this value are excluded
@@ -219,6 +223,15 @@
 #define DEALIAS_VRAD 1
 // whether we should dealias all data once (default), or dealias for each profile individually
 #define DEALIAS_RECYCLE 1
+// whether to start dealiasing each layer from the wind fitted in the layer below,
+// in an earlier profile, or in the previous volume, instead of searching all test fields
+#define DEALIAS_SEED 0
+// the test fields are still searched when the misfit of that wind exceeds this value,
+// relative to the radius nyquist/pi of the torus mapping (0 perfect fit, 4/pi random)
+#define DEALIAS_SEED_COSTMAX 0.6f
+// with DEALIAS_SEED, layers start from the layer below within chunks of this many
+// layers, which are calculated in parallel independent of the number of threads
+#define DEALIAS_SEED_NLAYERS 5
 // Test dealiasing field velocities up to VMAX m/s 
 #define DEALIAS_VMAX 50.0
 // Test field velocities increase in steps VMAX/VAF
@@ -233,6 +246,9 @@
 #define SINGLEPOL 1
 // correlation coefficients higher than this threshold will be classified as precipitation
 #define RHOHVMIN 0.95f
+// each weather cell identified by findWeatherCells() is grown by a fringe
+// of this width [m]
+#define FRINGEDIST 5000.0f
 // whether to resample the input polar volume
 #define RESAMPLE 0
 // resampled range gate length in m
@@ -255,3 +271,12 @@
 // require that radial velocity and spectrum width pixels rendered as mistnet input
 // have a valid corresponding reflectivity value
 #define MISTNET_REQUIRE_DBZ 0
+// number of columns of the profile arrays (HGHT, altmax, u, v, w, ff, dd, sd_vvp, gap, dbz, n, eta, dens, n_dbz)
+#define NCOLS_PROFILE 14
+// number of threads for parallel processing (only used when compiled with OpenMP)
+#define NTHREADS 1
+// directory of the on-disk profile cache, an empty string disables the cache
+#define CACHE_DIR ""
+// maximum size of the profile cache in MB, beyond which the least recently used
+// profiles are removed. A value of zero or less does not limit the size
+#define CACHE_SIZE_MAX 1024
@@ -6,8 +6,12 @@
 
 #include "libdealias.h"
 #include <stdio.h>
+#include <float.h>
 #include <gsl/gsl_multimin.h>
 #include <gsl/gsl_vector.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 void vol2bird_err_printf(const char* fmt, ...);
 
@@ -41,6 +45,74 @@ double test_field(float u, float v,const float *points, const float *pointsTrigo
     return esum;
 }
 
+static inline void sincos_poly(const double t, double* sint, double* cost){
+    // sine and cosine of t by Cody-Waite reduction to [-pi/4,pi/4] and the minimax
+    // polynomials of fdlibm. Accurate to a few ulp for the arguments in test_fields,
+    // and written without branches or table lookups, such that loops over it vectorize.
+    const double round = 0x1.8p52;
+    const double k = (t * M_2_PI + round) - round;
+    const double r = ((t - k * 1.57079632673412561417e+00) - k * 6.07710050630396597660e-11) - k * 2.02226624879595063154e-21;
+    const double z = r * r;
+    const double s = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+                   + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+    const double c = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05
+                   + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+    // quadrant of t, k modulo 4
+    const double q = k - 4.0 * (((k * 0.25 - 0.375) + round) - round);
+    const double sq = (q == 1.0 || q == 3.0) ? c : s;
+    const double cq = (q == 1.0 || q == 3.0) ? s : c;
+    *sint = (q >= 2.0) ? -sq : sq;
+    *cost = (q == 1.0 || q == 2.0) ? -cq : cq;
+}
+
+static void test_fields(const double u[], const double v[], const int nFields, const double *pointsValid, const int nPointsValid,
+    double esum[], double esumTol[], const int nThreads){
+    // evaluates test_field for nFields test velocity fields at once, using vectorizable
+    // trigonometric functions. The result differs slightly from that of test_field;
+    // esumTol[i] bounds the absolute difference between esum[i] and test_field for field i.
+    // pointsValid holds 7 columns of nPointsValid values for the points for which test_field
+    // does not return NAN: sin(azim), cos(azim), cos(elev), x, y, nyquist/pi and pi/nyquist
+    const double *sinAzim = pointsValid;
+    const double *cosAzim = pointsValid + nPointsValid;
+    const double *cosElev = pointsValid + 2*nPointsValid;
+    const double *x = pointsValid + 3*nPointsValid;
+    const double *y = pointsValid + 4*nPointsValid;
+    const double *nyquistOverPi = pointsValid + 5*nPointsValid;
+    const double *piOverNyquist = pointsValid + 6*nPointsValid;
+    double nyquistOverPiSum = 0;
+    int iField;
+
+    for (int iPoint=0; iPoint<nPointsValid; iPoint++) {
+        nyquistOverPiSum += nyquistOverPi[iPoint];
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(nThreads) if(nThreads > 1 && !omp_in_parallel())
+    #endif
+    for (iField=0; iField<nFields; iField++) {
+        // test_field takes the test velocities as floats
+        const double uField = (float) u[iField];
+        const double vField = (float) v[iField];
+        double sum = 0;
+        #ifdef _OPENMP
+        #pragma omp simd reduction(+:sum)
+        #endif
+        for (int iPoint=0; iPoint<nPointsValid; iPoint++) {
+            double sint, cost;
+            double vm = (uField*sinAzim[iPoint] + vField*cosAzim[iPoint])*cosElev[iPoint];
+            sincos_poly(vm*piOverNyquist[iPoint], &sint, &cost);
+            sum += fabs(nyquistOverPi[iPoint]*cost - x[iPoint]) + fabs(nyquistOverPi[iPoint]*sint - y[iPoint]);
+        }
+        esum[iField] = sum;
+        // test_field computes vm in single precision, which changes each term by less than
+        // 10*FLT_EPSILON*(|u|+|v|). The trigonometric functions and the remaining arithmetic
+        // change each term by less than 1e-12*nyquist/pi, and the summation order changes
+        // the sum by less than 2*nPoints*DBL_EPSILON*esum.
+        esumTol[iField] = nPointsValid * 10 * FLT_EPSILON * (fabs(uField) + fabs(vField)) + 1e-12 * nyquistOverPiSum
+                        + 2.0 * nPointsValid * DBL_EPSILON * (sum + 1.0);
+    }
+}
+
 double test_field_gsl(const gsl_vector *uv, void* params){
     double u,v;
     float *points = ((void **) params)[0];
@@ -58,12 +130,7 @@ double test_field_gsl(const gsl_vector *uv, void* params){
  
 }
 
-int fit_field_gsl(gsl_vector *uv, void *params){
-    gsl_vector *ss;
-    
-    // define which minimizer to use
-    const gsl_multimin_fminimizer_type *T = gsl_multimin_fminimizer_nmsimplex2;
-    gsl_multimin_fminimizer *s = NULL;
+int fit_field_gsl(gsl_vector *uv, void *params, gsl_multimin_fminimizer *s){
     
     int iter = 0;
     int status;
@@ -72,16 +139,15 @@ int fit_field_gsl(gsl_vector *uv, void *params){
     double v1 = 0;
     
     // Set initial step sizes to 1
-    ss = gsl_vector_alloc(2);
-    gsl_vector_set_all(ss, 1);
+    double ssData[2] = {1, 1};
+    gsl_vector_view ss = gsl_vector_view_array(ssData, 2);
 
     // Initialize method
     gsl_multimin_function minex_func;
     minex_func.n = 2;
     minex_func.f = &test_field_gsl;
     minex_func.params = params;
-    s = gsl_multimin_fminimizer_alloc (T, 2);
-    gsl_multimin_fminimizer_set (s, &minex_func, uv, ss);
+    gsl_multimin_fminimizer_set (s, &minex_func, uv, &ss.vector);
     
     // minimize by iteration
     do
@@ -119,20 +185,107 @@ int fit_field_gsl(gsl_vector *uv, void *params){
     fprintf(stdout,"Finished dealias at (x,y)=%f,%f at f()=%f ...\n",u1,v1,s->fval);
     #endif
 
-    // clean up
-    gsl_vector_free(ss);
-    gsl_multimin_fminimizer_free (s);
-    
     if (status != GSL_SUCCESS) return 0;
     return 1;
 }
 
 
+static int select_test_field(const double u[], const double v[], const int nFields, const double *pointsValid, const int nPointsValid,
+    void *params, double *esumMin, const int nThreads){
+    // returns the index of the test velocity field with the lowest test_field value, the
+    // first one in case of ties. All fields are first evaluated with test_fields, which
+    // is much faster than test_field but slightly less accurate. Only the fields that
+    // can be the best according to test_field, given the error bounds of test_fields,
+    // are then evaluated with test_field, such that the same field is selected as when
+    // evaluating all of them with test_field. esumMin is set to the test_field value
+    // of the selected field
+    double esumFast[nFields];
+    double esumTol[nFields];
+    double uvData[2];
+    gsl_vector_view uvView = gsl_vector_view_array(uvData, 2);
+    gsl_vector *uv = &uvView.vector;
+    double esum;
+    double min1 = 1e32;
+    double esumMax = 1e32;
+    int iField;
+    int eind = 0;
+
+    test_fields(u, v, nFields, pointsValid, nPointsValid, esumFast, esumTol, nThreads);
+
+    for (iField=0; iField<nFields; iField++) {
+        if (esumFast[iField]+esumTol[iField] < esumMax) {
+            esumMax = esumFast[iField]+esumTol[iField];
+        }
+    }
+
+    for (iField=0; iField<nFields; iField++) {
+
+        if (esumFast[iField]-esumTol[iField] > esumMax) continue;
+
+        gsl_vector_set(uv, 0, u[iField]);
+        gsl_vector_set(uv, 1, v[iField]);
+        esum = test_field_gsl(uv, params);
+
+        if (esum<min1) {
+            min1 = esum;
+            eind = iField;
+        }
+    }
+
+    *esumMin = min1;
+    return eind;
+}
+
+
+dealiasWork_t* dealias_work_alloc(const int nPointsMax){
+
+    dealiasWork_t* work = RAVE_MALLOC(sizeof(dealiasWork_t));
+    if (work == NULL) return NULL;
+
+    work->nPointsMax = nPointsMax;
+    // polarscan matrix, torus projected x coordinate, eq. 6 Haase et al. 2004 jaot
+    work->x = RAVE_MALLOC(sizeof(double) * (nPointsMax > 0 ? nPointsMax : 1));
+    // polarscan matrix, torus projected y coordinate, eq. 7 Haase et al. 2004 jaot
+    work->y = RAVE_MALLOC(sizeof(double) * (nPointsMax > 0 ? nPointsMax : 1));
+    // radial velocities of the best fitting test field
+    work->vt1 = RAVE_MALLOC(sizeof(double) * (nPointsMax > 0 ? nPointsMax : 1));
+    // array with trigonometric conversions of the points array
+    work->pointsTrigon = RAVE_MALLOC(sizeof(float) * 3 * (nPointsMax > 0 ? nPointsMax : 1));
+    // columns of the valid points for test_fields
+    work->pointsValid = RAVE_MALLOC(sizeof(double) * 7 * (nPointsMax > 0 ? nPointsMax : 1));
+    // threads used to evaluate the test velocity fields
+    work->nThreads = 1;
+    // the minimizer used by fit_field_gsl
+    work->minimizer = gsl_multimin_fminimizer_alloc(gsl_multimin_fminimizer_nmsimplex2, 2);
+
+    if (work->x == NULL || work->y == NULL || work->vt1 == NULL || work->pointsTrigon == NULL ||
+        work->pointsValid == NULL || work->minimizer == NULL) {
+        dealias_work_free(work);
+        return NULL;
+    }
+
+    return work;
+}
+
+void dealias_work_free(dealiasWork_t* work){
+
+    if (work == NULL) return;
+
+    RAVE_FREE(work->x);
+    RAVE_FREE(work->y);
+    RAVE_FREE(work->vt1);
+    RAVE_FREE(work->pointsTrigon);
+    RAVE_FREE(work->pointsValid);
+    if (work->minimizer != NULL) gsl_multimin_fminimizer_free(work->minimizer);
+    RAVE_FREE(work);
+}
+
 int dealias_points(const float *points, const int nDims, const float nyquist[], 
-    const double NI_MIN, const float vo[], float vradDealias[], const int nPoints){
+    const double NI_MIN, const float vo[], float vradDealias[], const int nPoints, dealiasWork_t* work,
+    const double uvSeed[], const double seedCostMax){
   
     int i, j, n, m, eind, fitOk;
-    double min1, esum, u1, v1, min2, dmy;
+    double esum, u1, v1, min2, dmy;
     
     // number of rows
     m = DEALIAS_VAF;
@@ -142,18 +295,26 @@ int dealias_points(const float *points, const int nDims, const float nyquist[],
     // max number of folds of nyquist interval to test for
     double MVA=2*ceil(DEALIAS_VMAX/(2*NI_MIN));
 
-    // polarscan matrix, torus projected x coordinate, eq. 6 Haase et al. 2004 jaot
-    double *x = RAVE_CALLOC ((size_t)nPoints, sizeof(double));
-    // polarscan matrix, torus projected y coordinate, eq. 7 Haase et al. 2004 jaot
-    double *y = RAVE_CALLOC ((size_t)nPoints, sizeof(double));
+    // use the work arrays of the caller when they are large enough,
+    // otherwise allocate them for this call only
+    dealiasWork_t* workOwned = NULL;
+    if (work == NULL || work->nPointsMax < nPoints) {
+        workOwned = dealias_work_alloc(nPoints);
+        if (workOwned == NULL) {
+            vol2bird_err_printf("Requested memory could not be allocated in dealias_points!\n");
+            return 0;
+        }
+        work = workOwned;
+    }
+
+    double *x = work->x;
+    double *y = work->y;
+    double *vt1 = work->vt1;
+    float *pointsTrigon = work->pointsTrigon;
     // U-components of test velocity fields
-    double *uh = RAVE_CALLOC ((size_t)(m*n), sizeof(double));
+    double uh[m*n];
     // V-components of test velocity fields
-    double *vh = RAVE_CALLOC ((size_t)(m*n), sizeof(double));
-    // radial velocities of the best fitting test field
-    double *vt1 = RAVE_CALLOC ((size_t)nPoints, sizeof(double));
-    // array with trigonometric conversions of the points array
-    float *pointsTrigon = RAVE_CALLOC ((size_t)(3*nPoints), sizeof(double));
+    double vh[m*n];
     
     // map measured data to 3D
     for (i=0; i<nPoints; i++) {
@@ -178,42 +339,86 @@ int dealias_points(const float *points, const int nDims, const float nyquist[],
         }
     }
 
-    min1 = 1e32;
-    eind = 0;
     u1 = 0;
     v1 = 0;
 
-    gsl_vector *uv;
-    uv = gsl_vector_alloc(2);
+    double uvData[2];
+    gsl_vector_view uvView = gsl_vector_view_array(uvData, 2);
+    gsl_vector *uv = &uvView.vector;
     
     void *params[7] = {(void *) points, (void *) pointsTrigon, (void *) &nPoints, (void *) &nDims, (void *) x, (void *) y, (void *) nyquist};     
    
-    // try several test velocity fields for use as starting point in GSL fit
+    // collect the columns of the points for which test_field does not obtain NAN,
+    // for the evaluation of the test velocity fields with test_fields
 
-    for (i=0; i<m*n; i++) {
-        
-        gsl_vector_set(uv, 0, *(uh+i));
-        gsl_vector_set(uv, 1, *(vh+i));
+    double *pointsValid = work->pointsValid;
+    int nPointsValid = 0;
+    for (int iPoint=0; iPoint<nPoints; iPoint++) {
+        // test_field skips the points for which it obtains NAN
+        if (isnan(x[iPoint]) || isnan(y[iPoint]) || !isfinite(nyquist[iPoint]) || nyquist[iPoint] == 0 ||
+            isnan(pointsTrigon[3*iPoint]) || isnan(pointsTrigon[3*iPoint+1]) || isnan(pointsTrigon[3*iPoint+2])) {
+            continue;
+        }
+        pointsValid[nPointsValid] = pointsTrigon[3*iPoint];
+        pointsValid[nPointsValid+nPoints] = pointsTrigon[3*iPoint+1];
+        pointsValid[nPointsValid+2*nPoints] = pointsTrigon[3*iPoint+2];
+        pointsValid[nPointsValid+3*nPoints] = x[iPoint];
+        pointsValid[nPointsValid+4*nPoints] = y[iPoint];
+        pointsValid[nPointsValid+5*nPoints] = nyquist[iPoint]/M_PI;
+        pointsValid[nPointsValid+6*nPoints] = M_PI/nyquist[iPoint];
+        nPointsValid++;
+    }
+    // make the columns contiguous
+    for (j=1; j<7; j++) {
+        memmove(&pointsValid[j*nPointsValid], &pointsValid[j*nPoints], sizeof(double) * nPointsValid);
+    }
+
+    // use the seed velocity field when it fits the data well enough, which saves the
+    // search of the test fields and the GSL fit. The misfit of a field is the mean
+    // distance between the modelled and observed points on the torus, relative to the
+    // radius nyquist/pi of the torus: 0 for a perfect fit and 4/pi on average for a
+    // field that is unrelated to the data
+    int seeded = 0;
+    if (uvSeed != NULL && !isnan(uvSeed[0]) && !isnan(uvSeed[1]) && nPointsValid > 0) {
+        double nyquistOverPiSum = 0;
+        for (int iPoint=0; iPoint<nPointsValid; iPoint++) {
+            nyquistOverPiSum += pointsValid[5*nPointsValid+iPoint];
+        }
+        gsl_vector_set(uv, 0, uvSeed[0]);
+        gsl_vector_set(uv, 1, uvSeed[1]);
         esum = test_field_gsl(uv, &params);
-                
-        if (esum<min1) {
-            min1 = esum;
-            eind = i;
+
+        #ifdef FPRINTFON
+        fprintf(stdout,"Seed for dealiasing at (x,y)=%f,%f has misfit %f ...\n",uvSeed[0],uvSeed[1],esum/nyquistOverPiSum);
+        #endif
+
+        // like the best test field below, the seed is used as is for dealiasing
+        if (esum <= seedCostMax * nyquistOverPiSum) {
+            u1 = uvSeed[0];
+            v1 = uvSeed[1];
+            fitOk = 1;
+            seeded = 1;
         }
+    }
+
+    // otherwise try several test velocity fields for use as starting point in GSL fit
+    if (!seeded) {
+
+        eind = select_test_field(uh, vh, m*n, pointsValid, nPointsValid, &params, &esum, work->nThreads);
         u1 = *(uh+eind);
         v1 = *(vh+eind);
+        gsl_vector_set(uv, 0, u1);
+        gsl_vector_set(uv, 1, v1);
+
+
+        #ifdef FPRINTFON
+        fprintf(stdout,"Start dealiasing at (x,y)=%f,%f at f()=%f ...\n",u1,v1,esum);
+        #endif
+
+        fitOk = fit_field_gsl(uv, &params, work->minimizer);
+        if(!fitOk) goto cleanup;
     }
-    gsl_vector_set(uv, 0, u1);
-    gsl_vector_set(uv, 1, v1);
 
-    
-    #ifdef FPRINTFON
-    fprintf(stdout,"Start dealiasing at (x,y)=%f,%f at f()=%f ...\n",u1,v1,esum);
-    #endif
-    
-    fitOk = fit_field_gsl(uv, &params);
-    if(!fitOk) goto cleanup;
-        
     // the radial velocity of the best fitting test velocity field:
     for (int iPoint=0; iPoint<nPoints; iPoint++) {
         *(vt1+iPoint) = (u1*sin(points[nDims*iPoint]*DEG2RAD) + v1*cos(points[nDims*iPoint]*DEG2RAD))
@@ -241,13 +446,7 @@ int dealias_points(const float *points, const int nDims, const float nyquist[],
     } // loop over points
 
     cleanup:
-        RAVE_FREE(x);
-        RAVE_FREE(y);
-        RAVE_FREE(uh);
-        RAVE_FREE(vh);
-        RAVE_FREE(vt1);
-        RAVE_FREE(pointsTrigon);
-        gsl_vector_free(uv);
+        dealias_work_free(workOwned);
         
         if(fitOk) return 1;
         else return 0;
@@ -22,5 +22,25 @@
 void printDealias(const float *points, const int nDims, const float nyquist[], 
 	const float vradObs[], float vradDealias[], const int nPoints, const int iProfileType, const int iLayer, const int iPass);
 
+// work arrays of dealias_points. They can be allocated once with
+// dealias_work_alloc and then be reused for up to nPointsMax points
+struct dealiasWork {
+    int nPointsMax;
+    double* x;
+    double* y;
+    double* vt1;
+    float* pointsTrigon;
+    double* pointsValid;
+    void* minimizer;
+    // number of threads used to evaluate the test velocity fields
+    int nThreads;
+};
+typedef struct dealiasWork dealiasWork_t;
+
+dealiasWork_t* dealias_work_alloc(const int nPointsMax);
+
+void dealias_work_free(dealiasWork_t* work);
+
 int dealias_points(const float *points, const int nDims, const float nyquist[], 
-	const double NI_MIN, const float vo[], float vradDealias[], const int nPoints);
+	const double NI_MIN, const float vo[], float vradDealias[], const int nPoints, dealiasWork_t* work,
+	const double uvSeed[], const double seedCostMax);
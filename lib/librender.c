@@ -8,6 +8,7 @@
 #include "constants.h"
 #include "libvol2bird.h"
 #include "librender.h"
+#include "libscanview.h"
 #include <string.h>
 #include <math.h>
 
@@ -906,6 +907,12 @@ int addTensorToPolarVolume(PolarVolume_t* pvol, float ****tensor, int dim1, int
         PolarScanParam_t *mistnetParamBiology = PolarScan_newParam(scan, "BIOLOGY", RaveDataType_DOUBLE);
         PolarScanParam_t *mistnetParamBackground= PolarScan_newParam(scan, "BACKGROUND", RaveDataType_DOUBLE);
         PolarScanParam_t *mistnetParamClassification= PolarScan_newParam(scan, CELLNAME, RaveDataType_INT);
+
+        vol2birdScanView_t viewBackground, viewBiology, viewWeather, viewClassification;
+        scanViewInit(&viewBackground, mistnetParamBackground);
+        scanViewInit(&viewBiology, mistnetParamBiology);
+        scanViewInit(&viewWeather, mistnetParamWeather);
+        scanViewInit(&viewClassification, mistnetParamClassification);
         
         long nRang = PolarScan_getNbins(scan);
         long nAzim = PolarScan_getNrays(scan);
@@ -944,10 +951,10 @@ int addTensorToPolarVolume(PolarVolume_t* pvol, float ****tensor, int dim1, int
                 if(valueWeather > MISTNET_WEATHER_THRESHOLD || valueWeatherAvg > MISTNET_SCAN_AVERAGE_WEATHER_THRESHOLD){
                     valueClassification=MISTNET_WEATHER_CELL_VALUE;
                 }
-                PolarScanParam_setValue(mistnetParamBackground, iRang, iAzim, valueBackground);
-                PolarScanParam_setValue(mistnetParamBiology, iRang, iAzim, valueBiology);
-                PolarScanParam_setValue(mistnetParamWeather, iRang, iAzim, valueWeather);
-                PolarScanParam_setValue(mistnetParamClassification, iRang, iAzim, valueClassification);                
+                scanViewSetValue(&viewBackground, iRang, iAzim, valueBackground);
+                scanViewSetValue(&viewBiology, iRang, iAzim, valueBiology);
+                scanViewSetValue(&viewWeather, iRang, iAzim, valueWeather);
+                scanViewSetValue(&viewClassification, iRang, iAzim, valueClassification);
             }            
         }
         RAVE_OBJECT_RELEASE(mistnetParamWeather);
@@ -982,6 +989,9 @@ int addClassificationToPolarVolume(PolarVolume_t* pvol, float ****tensor, int di
         }
 
         PolarScanParam_t *mistnetParamClassification= PolarScan_newParam(scan, CELLNAME, RaveDataType_INT);
+
+        vol2birdScanView_t viewClassification;
+        scanViewInit(&viewClassification, mistnetParamClassification);
         
         long nRang = PolarScan_getNbins(scan);
         long nAzim = PolarScan_getNrays(scan);
@@ -1015,7 +1025,7 @@ int addClassificationToPolarVolume(PolarVolume_t* pvol, float ****tensor, int di
                 if(valueWeatherAvg > MISTNET_SCAN_AVERAGE_WEATHER_THRESHOLD){
                     valueClassification=MISTNET_WEATHER_CELL_VALUE;
                 }
-                PolarScanParam_setValue(mistnetParamClassification, iRang, iAzim, valueClassification);                
+                scanViewSetValue(&viewClassification, iRang, iAzim, valueClassification);
             }            
         }
         
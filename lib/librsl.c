@@ -13,6 +13,7 @@
 #include "polarscan.h"
 #include "constants.h"
 #include "libvol2bird.h"
+#include "librsl.h"
 #include "rave_debug.h"
 #include <string.h>
 #include <math.h>
@@ -29,6 +30,8 @@ PolarScanParam_t* PolarScanParam_RSL2Rave(Radar *radar, float elev, int RSL_INDE
     
 int rslCopy2Rave(Sweep *rslSweep,PolarScanParam_t* scanparam);
 
+static void rslMapBins(Ray *rslRay, float rscale, long nbins, int *binIndex);
+
 #ifndef MIN
 #define MIN(x,y) (((x) < (y)) ? (x) : (y))
 #endif
@@ -45,14 +48,35 @@ void vol2bird_err_printf(const char* fmt, ...);
 
 // non-public function declarations (local to this file/translation unit)
 
+// maps the range bins of a Rave scan with range bin size rscale onto the bins of the
+// Range array of a RSL ray, in the same way as RSL_get_value_from_ray does for a single
+// range. Bins that fall outside the ray are mapped onto -1.
+static void rslMapBins(Ray *rslRay, float rscale, long nbins, int *binIndex){
+    float range;
+    int index;
+
+    for(long iBin=0; iBin<nbins; iBin++){
+        // range in km, as passed to RSL_get_value_from_ray, and back to m
+        range = iBin*rscale/1000;
+        range = range*1000;
+        index = (int) ((range - rslRay->h.range_bin1)/rslRay->h.gate_size + 0.5);
+        binIndex[iBin] = (index < 0 || index >= rslRay->h.nbins) ? -1 : index;
+    }
+}
+
+
 // copies a RSL sweep to a Rave scan
 int rslCopy2Rave(Sweep *rslSweep,PolarScanParam_t* scanparam){
     float value;
-    double setvalue;
     float rscale;
     int rayindex=0;
     Ray *rslRay;
     long nrays,nbins;
+    double *data, *rayData;
+    int *binIndex;
+    int iBinStart = 0;
+    // the ray geometry for which binIndex was computed
+    int mappedRangeBin1 = 0, mappedGateSize = 0, mappedNbins = -1;
     
     rslRay = RSL_get_first_ray_of_sweep(rslSweep);
     
@@ -63,7 +87,26 @@ int rslCopy2Rave(Sweep *rslSweep,PolarScanParam_t* scanparam){
 
     if (nbins == 0 || nrays == 0) return 0;
 
-    for(int iRay=0; iRay<rslSweep->h.nrays; iRay++){
+    // the scan parameter is created with data type double by PolarScanParam_RSL2Rave,
+    // so we write the converted rays directly into its data array
+    if (PolarScanParam_getDataType(scanparam) != RaveDataType_DOUBLE) {
+        vol2bird_err_printf("Error: rslCopy2Rave expects a scan parameter of data type double\n");
+        return 0;
+    }
+    data = (double*) PolarScanParam_getData(scanparam);
+
+    binIndex = (int*) malloc(sizeof(int) * nbins);
+    if (data == NULL || binIndex == NULL) {
+        vol2bird_err_printf("Error allocating memory in rslCopy2Rave\n");
+        free(binIndex);
+        return 0;
+    }
+
+    const double offset = PolarScanParam_getOffset(scanparam);
+    const double gain = PolarScanParam_getGain(scanparam);
+    const double undetect = PolarScanParam_getUndetect(scanparam);
+
+    for(int iRay=0; iRay<rslSweep->h.nrays && rslRay != NULL; iRay++){
         // determine at which ray index we are in the rave scanparam
         // adding half a ray bin width, to get into the middle of the ray bin
         rayindex=ROUND(nrays*(rslRay->h.azimuth+180.0/nrays)/360.0);
@@ -71,24 +114,42 @@ int rslCopy2Rave(Sweep *rslSweep,PolarScanParam_t* scanparam){
         rscale = rslRay->h.gate_size;
         // only values between 0 and 360 degrees permitted
         if (rayindex >= nrays) rayindex-=nrays;
+
+        if (rslRay->h.gate_size <= 0) {
+            // RSL_get_value_from_ray has no values for this ray
+            rslRay=RSL_get_next_cwise_ray(rslSweep, rslRay);
+            continue;
+        }
+
+        // the range bin mapping only changes with the geometry of the ray,
+        // which is usually the same for all rays of a sweep
+        if (rslRay->h.range_bin1 != mappedRangeBin1 || rslRay->h.gate_size != mappedGateSize || rslRay->h.nbins != mappedNbins){
+            rslMapBins(rslRay, rscale, nbins, binIndex);
+            iBinStart = ROUND((rslRay->h.range_bin1 + 0.5*rscale)/rscale);
+            mappedRangeBin1 = rslRay->h.range_bin1;
+            mappedGateSize = rslRay->h.gate_size;
+            mappedNbins = rslRay->h.nbins;
+        }
+
         // loop over range bins
-        int iBinStart = ROUND((rslRay->h.range_bin1 + 0.5*rscale)/rscale);
-        for(int iBin=iBinStart; iBin<nbins; iBin++){
-            value=RSL_get_value_from_ray(rslRay, iBin*rscale/1000);
+        rayData = data + rayindex * nbins;
+        for(int iBin=MAX(iBinStart,0); iBin<nbins; iBin++){
+            value = binIndex[iBin] < 0 ? BADVAL : rslRay->h.f(rslRay->range[binIndex[iBin]]);
             if (value == BADVAL || value == RFVAL){
                 // BADVAL is used in RSL library to encode for undetects, but also for nodata
                 // In most cases we are dealing with undetects, so encode as such
                 // RFVAL is a range folded value, see RSL documentation.
-                setvalue=PolarScanParam_getUndetect(scanparam);
+                rayData[iBin]=undetect;
             }
             else{
-                setvalue=(value-PolarScanParam_getOffset(scanparam))/PolarScanParam_getGain(scanparam);
+                rayData[iBin]=(value-offset)/gain;
             }
-            PolarScanParam_setValue(scanparam, iBin, rayindex, setvalue);
         }
         rslRay=RSL_get_next_cwise_ray(rslSweep, rslRay);
     }
     
+    free(binIndex);
+
     return 1;
 }
 
@@ -229,10 +290,14 @@ PolarScanParam_t* PolarScanParam_RSL2Rave(Radar *radar, float elev, int RSL_INDE
     PolarScanParam_setUndetect(param,RSL_UNDETECT);
 
     // initialize the data field
-    for(int iRay=0; iRay<nrays; iRay++){
-        for(int iBin=0; iBin<nbins; iBin++){
-            PolarScanParam_setValue(param, iBin, iRay, PolarScanParam_getNodata(param));
-        }
+    double *data = (double*) PolarScanParam_getData(param);
+    if (data == NULL) {
+        vol2bird_err_printf("Error: failed to allocate data of %s sweep in PolarScanParam_RSL2Rave\n",name);
+        RAVE_OBJECT_RELEASE(param);
+        return param;
+    }
+    for(long iGlobal=0; iGlobal<(long) nbins*nrays; iGlobal++){
+        data[iGlobal] = RSL_NODATA;
     }
 
     // Fill the PolarScanParam_t objects with corresponding RSL data
@@ -519,6 +584,24 @@ PolarVolume_t* PolarVolume_vol2bird_RSL2Rave(Radar* radar, float rangeMax){
 
 
 PolarVolume_t* vol2birdGetRSLVolume(char* filename, float rangeMax, int small) {
+
+    // according to documentation of RSL it is not required to parse a callid
+    // but in practice it is for WSR88D.
+
+    char* base = basename(filename);
+    char callid[5];
+    strncpy(callid, base,4);
+    callid[4] = 0; //null terminate destination
+    vol2bird_err_printf("Filename = %s, callid = %s\n", filename, callid);
+
+    return vol2birdGetRSLVolumeWithCallid(filename, callid, rangeMax, small);
+
+}
+
+
+// as vol2birdGetRSLVolume, for files of which the name does not start with the
+// radar call sign, such as data received in memory
+PolarVolume_t* vol2birdGetRSLVolumeWithCallid(char* filename, const char* callid, float rangeMax, int small) {
     Radar *radar;
     PolarVolume_t* volume = NULL;
 
@@ -530,17 +613,7 @@ PolarVolume_t* vol2birdGetRSLVolume(char* filename, float rangeMax, int small) {
     RSL_read_these_sweeps("all",NULL);
     
     // read the file to a RSL radar object
-    
-    // according to documentation of RSL it is not required to parse a callid
-    // but in practice it is for WSR88D.
-
-    char* base = basename(filename);
-    char callid[5];
-    strncpy(callid, base,4);
-    callid[4] = 0; //null terminate destination
-    vol2bird_err_printf("Filename = %s, callid = %s\n", filename, callid);
-    
-    radar = RSL_anyformat_to_radar(filename,callid);
+    radar = RSL_anyformat_to_radar(filename, (char*) callid);
 
     if (radar == NULL) {
         vol2bird_err_printf("critical error, cannot open file %s\n", filename);
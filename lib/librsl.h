@@ -4,4 +4,6 @@
 
 PolarVolume_t* vol2birdGetRSLVolume(char* filename, float rangeMax, int small);
 
+PolarVolume_t* vol2birdGetRSLVolumeWithCallid(char* filename, const char* callid, float rangeMax, int small);
+
 #endif
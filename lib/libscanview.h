@@ -0,0 +1,270 @@
+#ifndef LIBSCANVIEW_H
+#define LIBSCANVIEW_H
+
+#include <limits.h>
+#include <float.h>
+#include <string.h>
+#include "polarscan.h"
+
+// ------------------------------------------------------------- //
+//         direct access to the data of a scan parameter         //
+// ------------------------------------------------------------- //
+
+// A scan view resolves the data array, data type and conversion attributes
+// of a scan parameter once, after which gates are read and written inline
+// instead of through PolarScanParam_getValue / getConvertedValue / setValue,
+// which cost a function call and a data type switch for every gate. The
+// accessors follow the semantics of those RAVE functions, except where
+// scanViewSetValue stores float data (see there). A view does not hold a
+// reference to the parameter, so it is valid as long as the parameter is
+// and its data is not replaced.
+struct vol2birdScanView {
+    // the data array, nRang * nAzim values ordered as iRang + iAzim * nRang
+    void* data;
+    RaveDataType type;
+    long nRang;
+    long nAzim;
+    double gain;
+    double offset;
+    double nodata;
+    double undetect;
+};
+typedef struct vol2birdScanView vol2birdScanView_t;
+
+
+// initializes 'view' for 'param', returns -1 when param is NULL or has no data,
+// in which case the view has no data and setting values through it does nothing
+static inline int scanViewInit(vol2birdScanView_t* view, PolarScanParam_t* param) {
+
+    view->data = NULL;
+    view->type = RaveDataType_UNDEFINED;
+    view->nRang = 0;
+    view->nAzim = 0;
+
+    if (param == NULL) {
+        return -1;
+    }
+
+    view->data = PolarScanParam_getData(param);
+    if (view->data == NULL) {
+        return -1;
+    }
+
+    view->type = PolarScanParam_getDataType(param);
+    view->nRang = PolarScanParam_getNbins(param);
+    view->nAzim = PolarScanParam_getNrays(param);
+    view->gain = PolarScanParam_getGain(param);
+    view->offset = PolarScanParam_getOffset(param);
+    view->nodata = PolarScanParam_getNodata(param);
+    view->undetect = PolarScanParam_getUndetect(param);
+
+    return 0;
+
+} // scanViewInit
+
+
+// the raw value of gate iGlobal = iRang + iAzim * nRang
+static inline double scanViewRaw(const vol2birdScanView_t* view, const long iGlobal) {
+
+    switch (view->type) {
+        case RaveDataType_CHAR:
+            return (double) ((char*) view->data)[iGlobal];
+        case RaveDataType_UCHAR:
+            return (double) ((unsigned char*) view->data)[iGlobal];
+        case RaveDataType_SHORT:
+            return (double) ((short*) view->data)[iGlobal];
+        case RaveDataType_USHORT:
+            return (double) ((unsigned short*) view->data)[iGlobal];
+        case RaveDataType_INT:
+            return (double) ((int*) view->data)[iGlobal];
+        case RaveDataType_UINT:
+            return (double) ((unsigned int*) view->data)[iGlobal];
+        case RaveDataType_LONG:
+            return (double) ((long*) view->data)[iGlobal];
+        case RaveDataType_ULONG:
+            return (double) ((unsigned long*) view->data)[iGlobal];
+        case RaveDataType_FLOAT:
+            return (double) ((float*) view->data)[iGlobal];
+        case RaveDataType_DOUBLE:
+            return ((double*) view->data)[iGlobal];
+        default:
+            return view->nodata;
+    }
+
+} // scanViewRaw
+
+
+// as PolarScanParam_getValue: the raw value and whether it is data, nodata or undetect
+static inline RaveValueType scanViewGetValue(const vol2birdScanView_t* view, const long iRang, const long iAzim, double* value) {
+
+    if (view->data == NULL || iRang < 0 || iRang >= view->nRang || iAzim < 0 || iAzim >= view->nAzim) {
+        return RaveValueType_UNDEFINED;
+    }
+
+    *value = scanViewRaw(view, iRang + iAzim * view->nRang);
+
+    if (*value == view->nodata) {
+        return RaveValueType_NODATA;
+    }
+    if (*value == view->undetect) {
+        return RaveValueType_UNDETECT;
+    }
+    return RaveValueType_DATA;
+
+} // scanViewGetValue
+
+
+// as PolarScanParam_getConvertedValue: data values are converted with gain and offset
+static inline RaveValueType scanViewGetConvertedValue(const vol2birdScanView_t* view, const long iRang, const long iAzim, double* value) {
+
+    RaveValueType type = scanViewGetValue(view, iRang, iAzim, value);
+
+    if (type == RaveValueType_DATA) {
+        *value = view->offset + (*value) * view->gain;
+    }
+
+    return type;
+
+} // scanViewGetConvertedValue
+
+
+// as PolarScanParam_setValue: stores the raw value, clamped to the range of integer data types.
+// Float data is clamped to [-FLT_MAX, FLT_MAX], whereas RAVE clamps it to [FLT_MIN, FLT_MAX] and
+// so stores negative values (e.g. radial velocities) as FLT_MIN. The view deliberately keeps them.
+static inline void scanViewSetValue(vol2birdScanView_t* view, const long iRang, const long iAzim, const double value) {
+
+    if (view->data == NULL || iRang < 0 || iRang >= view->nRang || iAzim < 0 || iAzim >= view->nAzim) {
+        return;
+    }
+
+    long iGlobal = iRang + iAzim * view->nRang;
+
+#define CLAMPED(min, max) (value < (min) ? (min) : (value > (max) ? (max) : value))
+
+    switch (view->type) {
+        case RaveDataType_CHAR:
+            ((char*) view->data)[iGlobal] = (char) CLAMPED(CHAR_MIN, CHAR_MAX);
+            break;
+        case RaveDataType_UCHAR:
+            ((unsigned char*) view->data)[iGlobal] = (unsigned char) CLAMPED(0, UCHAR_MAX);
+            break;
+        case RaveDataType_SHORT:
+            ((short*) view->data)[iGlobal] = (short) CLAMPED(SHRT_MIN, SHRT_MAX);
+            break;
+        case RaveDataType_USHORT:
+            ((unsigned short*) view->data)[iGlobal] = (unsigned short) CLAMPED(0, USHRT_MAX);
+            break;
+        case RaveDataType_INT:
+            ((int*) view->data)[iGlobal] = (int) CLAMPED(INT_MIN, INT_MAX);
+            break;
+        case RaveDataType_UINT:
+            ((unsigned int*) view->data)[iGlobal] = (unsigned int) CLAMPED(0, UINT_MAX);
+            break;
+        case RaveDataType_LONG:
+            ((long*) view->data)[iGlobal] = (long) CLAMPED(LONG_MIN, LONG_MAX);
+            break;
+        case RaveDataType_ULONG:
+            ((unsigned long*) view->data)[iGlobal] = (unsigned long) CLAMPED(0, ULONG_MAX);
+            break;
+        case RaveDataType_FLOAT:
+            ((float*) view->data)[iGlobal] = (float) CLAMPED(-FLT_MAX, FLT_MAX);
+            break;
+        case RaveDataType_DOUBLE:
+            ((double*) view->data)[iGlobal] = value;
+            break;
+        default:
+            break;
+    }
+
+#undef CLAMPED
+
+} // scanViewSetValue
+
+
+// copies the raw values of all gates into 'values', ordered as iRang + iAzim * nRang
+static inline void scanViewGetRawValues(const vol2birdScanView_t* view, double* values) {
+
+    long iGlobal;
+    long nGlobal = view->nRang * view->nAzim;
+
+#define COPY_RAW_VALUES(ctype) \
+    for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) { \
+        values[iGlobal] = (double) ((ctype*) view->data)[iGlobal]; \
+    }
+
+    switch (view->type) {
+        case RaveDataType_CHAR:
+            COPY_RAW_VALUES(char);
+            break;
+        case RaveDataType_UCHAR:
+            COPY_RAW_VALUES(unsigned char);
+            break;
+        case RaveDataType_SHORT:
+            COPY_RAW_VALUES(short);
+            break;
+        case RaveDataType_USHORT:
+            COPY_RAW_VALUES(unsigned short);
+            break;
+        case RaveDataType_INT:
+            COPY_RAW_VALUES(int);
+            break;
+        case RaveDataType_UINT:
+            COPY_RAW_VALUES(unsigned int);
+            break;
+        case RaveDataType_LONG:
+            COPY_RAW_VALUES(long);
+            break;
+        case RaveDataType_ULONG:
+            COPY_RAW_VALUES(unsigned long);
+            break;
+        case RaveDataType_FLOAT:
+            COPY_RAW_VALUES(float);
+            break;
+        case RaveDataType_DOUBLE:
+            COPY_RAW_VALUES(double);
+            break;
+        default:
+            for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
+                values[iGlobal] = view->nodata;
+            }
+    }
+
+#undef COPY_RAW_VALUES
+
+} // scanViewGetRawValues
+
+
+// fills a column of the scan, i.e. the gates of all rays at range bin iRang:
+// values[iAzim] and types[iAzim] as returned by scanViewGetConvertedValue
+static inline void scanViewGetConvertedColumn(const vol2birdScanView_t* view, const long iRang, double* values, RaveValueType* types) {
+
+    long iAzim;
+
+    for (iAzim = 0; iAzim < view->nAzim; iAzim++) {
+        types[iAzim] = scanViewGetConvertedValue(view, iRang, iAzim, &values[iAzim]);
+    }
+
+} // scanViewGetConvertedColumn
+
+
+// sets all gates of the scan to 'value'
+static inline void scanViewFill(vol2birdScanView_t* view, const double value) {
+
+    long iGlobal;
+    long nGlobal = view->nRang * view->nAzim;
+
+    if (view->data == NULL || nGlobal == 0) {
+        return;
+    }
+
+    // convert once through the clamping setter, then copy the typed value
+    scanViewSetValue(view, 0, 0, value);
+
+    int elemSize = get_ravetype_size(view->type);
+    for (iGlobal = 1; iGlobal < nGlobal; iGlobal++) {
+        memcpy((char*) view->data + iGlobal * elemSize, view->data, elemSize);
+    }
+
+} // scanViewFill
+
+#endif
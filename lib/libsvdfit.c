@@ -115,7 +115,7 @@ int svdcmp(float *a,int m,int n,float w[],float *v) {
     int l;
     int nIterationsMax;
     int nm;
-    float *rv1;
+    float rv1[n];
     float s;
     float scale;
     float x;
@@ -127,14 +127,6 @@ int svdcmp(float *a,int m,int n,float w[],float *v) {
     l = 0;
     nm = 0;
 
-    /*Allocation of memory.*/
-
-    rv1 = (float *)malloc(n*sizeof(float));
-    if (rv1 == NULL) {
-        vol2bird_err_printf("Requested memory could not be allocated!\n");
-        return -1;
-    }
-
     /*Start of very stable algorithm by Forsythe et al.*/
     /*Householder reduction to bidiagonal form.*/
 
@@ -411,10 +403,6 @@ int svdcmp(float *a,int m,int n,float w[],float *v) {
         }
     }
 
-    /*Cleaning of memory.*/
-
-    free(rv1);
-
     return 0;
 
 } //svdcmp
@@ -424,7 +412,7 @@ int svdcmp(float *a,int m,int n,float w[],float *v) {
 
 
 float svdfit(const float *points, const int nDims, const float vradObs[], float vradFitted[], const int nPoints,
-             float parameterVector[], float avar[], const int nParsFitted) {
+             float parameterVector[], float avar[], const int nParsFitted, float *work) {
 
 
     // ************************************************************************************************
@@ -436,12 +424,16 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
     // 'points' is equal to 'nDims', generally this will be equal to 1.
     // Here we solve the fitting equations using singular value decomposition of
     // the nPoints by nParsFitted matrix. The program returns values for the array with fit
-    // parameters 'parameterVector', variance matrix 'avar', and the Chi-square fitness score.
+    // parameters 'parameterVector', their variances 'avar' (the diagonal of the inverse of the
+    // normal matrix, as in vvpfit), and the Chi-square fitness score.
     //
     // The user supplies a function with the fit model 'funcs(points,nDims,afunc,nParsFitted)'
     // that returns the 'nParsFitted' basis functions evaluated at points[0..nDims-1] in the
     // array afunc[0..nParsFitted-1].
     //
+    // The caller may pass a 'work' array of at least nPoints*nParsFitted elements to
+    // hold the design matrix, otherwise (work == NULL) it is allocated here.
+    //
     // ************************************************************************************************
 
 
@@ -455,6 +447,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
     float v[nParsFitted*nParsFitted];
     float wti[nParsFitted];
     float *u;
+    float *uOwned = NULL;
     float singularValueMax;
     float sum;
     float chisq;
@@ -470,10 +463,13 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
     }
 
     // Allocation of memory for arrays.
-    u = (float *)malloc(nPoints*nParsFitted*sizeof(float));
-    if (!u) {
-        vol2bird_err_printf("Requested memory could not be allocated!\n");
-        return -1.0;
+    u = work;
+    if (u == NULL) {
+        u = uOwned = (float *)malloc(nPoints*nParsFitted*sizeof(float));
+        if (!u) {
+            vol2bird_err_printf("Requested memory could not be allocated!\n");
+            return -1.0;
+        }
     }
 
     // Filling of the design matrix of the fitting problem (u[iPoint][iParFitted]).
@@ -481,6 +477,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
         // note pointer arithmetic in this next statement:
         if (svd_vvp1func(points+nDims*iPoint,nDims,afunc,nParsFitted)) {
+            free(uOwned);
             return -1.0;
         }
 
@@ -492,6 +489,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
     // Singular value decomposition of the design matrix of the fit.
     if (svdcmp(u,nPoints,nParsFitted,singularValues,v)) {
+        free(uOwned);
         return -1.0;
     }
 
@@ -512,6 +510,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
     // Calculation of fit parameters 'parameterVector' using backsubstitution with 'vradObs'.
     if (svbksb(u,singularValues,v,nPoints,nParsFitted,vradObs,parameterVector)) {
+        free(uOwned);
         return -1.0;
     }
 
@@ -525,15 +524,17 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
         }
     }
 
-    // FIXME the calculation of the variance is still a bit weird...buggy?
-    for (iParFittedCols = 0; iParFittedCols < nParsFitted; iParFittedCols++) {
+    // The variances are the diagonal of the inverse of the normal matrix, V.W^-2.V^T,
+    // where column iParFittedCols of V is the singular vector of singular value
+    // iParFittedCols (as in svbksb). Discarded singular values do not contribute.
+    for (iParFittedRows = 0; iParFittedRows < nParsFitted; iParFittedRows++) {
 
-        avar[iParFittedCols] = 0.0;
+        avar[iParFittedRows] = 0.0;
 
-        for (iParFittedRows = 0 ; iParFittedRows < nParsFitted; iParFittedRows++) {
+        for (iParFittedCols = 0 ; iParFittedCols < nParsFitted; iParFittedCols++) {
 
             k = iParFittedCols + nParsFitted*iParFittedRows;
-            avar[iParFittedCols] += v[k] * v[k] * wti[iParFittedRows];
+            avar[iParFittedRows] += v[k] * v[k] * wti[iParFittedCols];
 
         }
     }
@@ -544,6 +545,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
         // note pointer arithmetic in this next statement:
         if (svd_vvp1func(points+nDims*iPoint,nDims,afunc,nParsFitted)) {
+            free(uOwned);
             return -1.0;
         }
         sum = 0.0;
@@ -559,7 +561,7 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
     /*Cleaning of memory.*/
 
-    free(u);
+    free(uOwned);
 
     return chisq;
 } //svdfit
@@ -569,19 +571,139 @@ float svdfit(const float *points, const int nDims, const float vradObs[], float
 
 
 
-int svbksb(float *u,float w[],float *v,int m,int n,const float b[],float x[])
-{
-    int jj,j,i;
-    float sum,*tmp;
+float vvpfit(const float *points, const int nDims, const float vradObs[], float vradFitted[], const int nPoints,
+             float parameterVector[], float avar[], const int nParsFitted, float *work) {
 
-    /*Allocation of memory.*/
 
-    tmp=(float *)malloc(n*sizeof(float));
-    if (tmp==NULL) {
-        vol2bird_err_printf("Requested memory could not be allocated!\n");
-        return -1;
+    // ************************************************************************************************
+    // This function performs the same fit as svdfit for the three-parameter VVP model of
+    // svd_vvp1func, but solves the 3x3 normal equations in closed form instead of decomposing
+    // the nPoints by nParsFitted design matrix. The normal equations are accumulated in double
+    // precision in a single pass over the points, so no O(nPoints) storage is needed.
+    //
+    // When the normal matrix is ill-conditioned (or for other fit models), the fit is left to
+    // svdfit, which discards the small singular values. The outputs are the same as those of
+    // svdfit; 'avar' holds the diagonal of the inverse of the normal matrix.
+    //
+    // ************************************************************************************************
+
+
+    int iParFitted;
+    int iParFittedRows;
+    int iParFittedCols;
+    int iPoint;
+    float afunc[3];
+    double ata[3][3] = {{0}};
+    double aty[3] = {0};
+    double inv[3][3];
+    double det;
+    double normAta;
+    double normInv;
+    float sum;
+    float chisq;
+
+    if (nDims != 2 || nParsFitted != 3) {
+        return svdfit(points, nDims, vradObs, vradFitted, nPoints, parameterVector, avar, nParsFitted, work);
+    }
+    if (nPoints <= nParsFitted) {
+        vol2bird_err_printf("Number of data points is too small!\n");
+        return -1.0;
     }
 
+    // Accumulation of the normal equations A^T.A.x = A^T.vradObs
+    for (iPoint = 0; iPoint < nPoints; iPoint++) {
+
+        // note pointer arithmetic in this next statement:
+        if (svd_vvp1func(points+nDims*iPoint,nDims,afunc,nParsFitted)) {
+            return -1.0;
+        }
+
+        for (iParFittedRows = 0; iParFittedRows < 3; iParFittedRows++) {
+            for (iParFittedCols = iParFittedRows; iParFittedCols < 3; iParFittedCols++) {
+                ata[iParFittedRows][iParFittedCols] += (double) afunc[iParFittedRows] * afunc[iParFittedCols];
+            }
+            aty[iParFittedRows] += (double) afunc[iParFittedRows] * vradObs[iPoint];
+        }
+    }
+    ata[1][0] = ata[0][1];
+    ata[2][0] = ata[0][2];
+    ata[2][1] = ata[1][2];
+
+    // Inversion of the (symmetric) normal matrix using its cofactors.
+    inv[0][0] = ata[1][1]*ata[2][2] - ata[1][2]*ata[2][1];
+    inv[0][1] = ata[0][2]*ata[2][1] - ata[0][1]*ata[2][2];
+    inv[0][2] = ata[0][1]*ata[1][2] - ata[0][2]*ata[1][1];
+    inv[1][1] = ata[0][0]*ata[2][2] - ata[0][2]*ata[2][0];
+    inv[1][2] = ata[0][2]*ata[1][0] - ata[0][0]*ata[1][2];
+    inv[2][2] = ata[0][0]*ata[1][1] - ata[0][1]*ata[1][0];
+    inv[1][0] = inv[0][1];
+    inv[2][0] = inv[0][2];
+    inv[2][1] = inv[1][2];
+
+    det = ata[0][0]*inv[0][0] + ata[0][1]*inv[1][0] + ata[0][2]*inv[2][0];
+
+    // The condition number (1-norm) of the normal matrix decides whether the closed form
+    // solution can be trusted. The threshold is well below the point where svdfit starts
+    // discarding singular values (condition number 1/SVDTOL^2), such that both agree.
+    normAta = 0.0;
+    normInv = 0.0;
+    for (iParFittedCols = 0; iParFittedCols < 3; iParFittedCols++) {
+        double sumAta = 0.0;
+        double sumInv = 0.0;
+        for (iParFittedRows = 0; iParFittedRows < 3; iParFittedRows++) {
+            sumAta += fabs(ata[iParFittedRows][iParFittedCols]);
+            sumInv += fabs(inv[iParFittedRows][iParFittedCols]);
+        }
+        normAta = XYMAX(normAta, sumAta);
+        normInv = XYMAX(normInv, sumInv);
+    }
+
+    if (!(det > 0.0) || normAta * normInv > det / SVDTOL) {
+        return svdfit(points, nDims, vradObs, vradFitted, nPoints, parameterVector, avar, nParsFitted, work);
+    }
+
+    // Calculation of fit parameters 'parameterVector' and their variances 'avar'.
+    for (iParFittedRows = 0; iParFittedRows < 3; iParFittedRows++) {
+        double x = 0.0;
+        for (iParFittedCols = 0; iParFittedCols < 3; iParFittedCols++) {
+            x += inv[iParFittedRows][iParFittedCols] * aty[iParFittedCols];
+        }
+        parameterVector[iParFittedRows] = x / det;
+        avar[iParFittedRows] = inv[iParFittedRows][iParFittedRows] / det;
+    }
+
+    /*Calculation of vradFitted and Chi-square of the fit.*/
+    chisq = 0.0;
+    for (iPoint = 0; iPoint < nPoints; iPoint++) {
+
+        // note pointer arithmetic in this next statement:
+        if (svd_vvp1func(points+nDims*iPoint,nDims,afunc,nParsFitted)) {
+            return -1.0;
+        }
+        sum = 0.0;
+        for (iParFitted = 0; iParFitted < nParsFitted; iParFitted++) {
+            sum += parameterVector[iParFitted] * afunc[iParFitted];
+        }
+        vradFitted[iPoint] = sum;
+
+        chisq += SQUARE(vradObs[iPoint]-vradFitted[iPoint]);
+
+    }
+    chisq /= nPoints-nParsFitted;
+
+    return chisq;
+} //vvpfit
+
+
+
+
+
+
+int svbksb(float *u,float w[],float *v,int m,int n,const float b[],float x[])
+{
+    int jj,j,i;
+    float sum,tmp[n];
+
     /*First part of inversion: calculation of Tmp = (W^-1.U^T).B. Singular values */
     /*of W are discarded.*/
 
@@ -602,10 +724,6 @@ int svbksb(float *u,float w[],float *v,int m,int n,const float b[],float x[])
         x[j]=sum;
     }
 
-    /*Cleaning of memory.*/
-
-    free(tmp);
-
     return 0;
 } //svbksb
 
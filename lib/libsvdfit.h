@@ -41,7 +41,9 @@ int svd_vvp1func(const float points[], const int nDims, float afunc[], const int
 int svbksb(float *u, float w[], float *v, int m, int n, const float b[], float x[]);
 int svdcmp(float *a, int m, int n, float w[], float *v);
 float svdfit(const float *points, const int nDims, const float yObs[], float yFitted[], const int nPoints,
-             float parameterVector[], float avar[], const int nParsFitted);
+             float parameterVector[], float avar[], const int nParsFitted, float *work);
+float vvpfit(const float *points, const int nDims, const float yObs[], float yFitted[], const int nPoints,
+             float parameterVector[], float avar[], const int nParsFitted, float *work);
 
 
 
@@ -28,6 +28,11 @@
 #include <stdarg.h>
 #include <math.h>
 #include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <utime.h>
 #include <vertical_profile.h>
 #include "rave_io.h"
 #include "rave_debug.h"
@@ -39,6 +44,11 @@
 #undef RAD2DEG // to suppress redefine warning, also defined in dealias.h
 #undef DEG2RAD // to suppress redefine warning, also defined in dealias.h
 #include "libdealias.h"
+#include "libscanview.h"
+#include "libvpb.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "librender.h"
 #include <ctype.h>
 
@@ -46,6 +56,7 @@
 #ifdef RSL
 #include "rsl.h"
 #include "librsl.h"
+#include <zlib.h>
 #endif
 
 #ifdef IRIS
@@ -55,51 +66,136 @@
 
 // non-public function prototypes (local to this file/translation unit)
 
-static int analyzeCells(PolarScan_t *scan, vol2birdScanUse_t scanUse, const int nCells, int dualpol, vol2bird_t *alldata);
+struct vol2birdVptsFile;
+
+struct vptsRow;
+
+struct errMessages;
+
+struct scanData;
+
+static int addScanToPointsArray(struct scanData* scanData, const int iScan, const int nScans,
+                                const int* iRowSlot, const int* nRowsSlot, int* nRowsWritten, vol2bird_t* alldata);
+
+static void addTextureRow(const double* rowValues, const long nRang, const int sign,
+                          double* colSum1, double* colSum2, int* colCount);
+
+static int allocateScratch(vol2birdScratch_t* scratch, const int nPointsMax, vol2bird_t* alldata);
+
+static int analyzeCells(struct scanData* scanData, const int nCells, int dualpol, vol2bird_t *alldata);
+
+static void cacheEntryPath(char* path, const size_t pathSize, const char* key, const char* extension, vol2bird_t* alldata);
 
 static float calcDist(const int range1, const int azim1, const int range2, const int azim2, const float rscale, const float ascale);
 
-static void calcTexture(PolarScan_t *scan, vol2birdScanUse_t scanUse, vol2bird_t* alldata);
+static void calcLayerProfiles(vol2bird_t *alldata, vol2birdScratch_t* scratch, const int iLayer, const int nPasses);
+
+static void calcProfileLayer(vol2bird_t *alldata, vol2birdScratch_t* scratch, const vol2birdLayerGates_t* gates,
+                             const int iProfileType, const int iLayer, const int nPasses, const int recycleDealias,
+                             float* profile);
+
+static void calcTexture(struct scanData* scanData, vol2bird_t* alldata);
 
 static void classifyGatesSimple(vol2bird_t* alldata);
 
+static int compareCacheFilesByKey(const void* a, const void* b);
+
+static int compareCacheFilesByTime(const void* a, const void* b);
+
+static int compareCellsByArea(const void* a, const void* b);
+
+static int compareInt(const void* a, const void* b);
+
+static int compareVptsRows(const void* a, const void* b);
+
+static void closeMemoryFile(const int fd, const char* path);
+
+static int closeVptsFile(struct vol2birdVptsFile* file);
+
+static void collectErrMessages(struct errMessages* messages);
+
 static void constructPointsArray(PolarVolume_t* volume, vol2birdScanUse_t *scanUse, vol2bird_t* alldata);
 
-static int detNumberOfGates(const int iLayer, const float rangeScale, const float elevAngle,
-                            const int nRang, const int nAzim, const float radarHeight, vol2bird_t* alldata);
+static int detNumberOfGates(PolarScan_t* scan, int* nGates, vol2bird_t* alldata);
 
 static int detSvdfitArraySize(PolarVolume_t* volume, vol2birdScanUse_t *scanUse, vol2bird_t* alldata);
 
 static vol2birdScanUse_t *determineScanUse(PolarVolume_t* volume, vol2bird_t* alldata);
 
+static int evictCacheEntries(vol2bird_t* alldata);
+
 static void exportBirdProfileAsJSON(vol2bird_t* alldata);
 
-static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quantityThreshold,
+static void expandVptsPath(char* path, const size_t pathSize, const char* pattern, const char* radar, const char* date);
+
+static int finishCacheKey(uint64_t hash, vol2bird_t* alldata, char* key);
+
+static int findCellRoot(int iCell, int* cellParent);
+
+static int findWeatherCells(struct scanData* scanData, const vol2birdScanView_t* quantityView, float quantityThreshold,
         int selectAboveThreshold, int iCellStart, int initialize, vol2bird_t* alldata);
 
 static int findNearbyGateIndex(const int nAzimParent, const int nRangParent, const int iParent,
                         const int nAzimChild,  const int nRangChild,  const int iChild, int *iAzimReturn, int *iRangReturn);
 
-static void fringeCells(PolarScan_t* scan, vol2bird_t* alldata);
+static void formatTaskArgs(char* taskArgs, const size_t taskArgsSize, vol2bird_t* alldata);
+
+static void freeScratch(vol2birdScratch_t* scratch);
 
-CELLPROP* getCellProperties(PolarScan_t* scan, vol2birdScanUse_t scanUse, const int nCells, vol2bird_t* alldata);
+static void fringeCells(struct scanData* scanData, vol2bird_t* alldata);
 
-static int getListOfSelectedGates(PolarScan_t* scan, vol2birdScanUse_t scanUse,
-                                      const float altitudeMin, const float altitudeMax,
-                                      float* points_local, int iRowPoints, int nColsPoints_local, vol2bird_t* alldata);
+CELLPROP* getCellProperties(const struct scanData* scanData, const int nCells, vol2bird_t* alldata);
+
+#ifdef RSL
+static int getBufferCallid(const void* buffer, const size_t size, const char* name, char* callid);
+#endif
+
+static void getDealiasSeed(vol2bird_t* alldata, const int iLayer, double* uvSeed);
+
+static int getListOfSelectedGates(const struct scanData* scanData, vol2birdPoints_t* points_local,
+                                  const int* iRowSlot, const int* nRowsSlot, int* nRowsWritten,
+                                  vol2bird_t* alldata);
+
+static void getScanGeometry(PolarScan_t* scan, struct scanData* scanData);
 
 static int hasAzimuthGap(const float *points_local, const int nPoints, vol2bird_t* alldata);
 
+static uint64_t hashBytes(uint64_t hash, const void* data, const size_t size);
+
+static int hashFile(uint64_t* hash, const char* filename);
+
+static void initScanData(PolarScan_t* scan, vol2birdScanUse_t scanUse, struct scanData* scanData, vol2bird_t* alldata);
+
+static void initScanView(PolarScan_t* scan, const char* quantity, vol2birdScanView_t* view);
+
+static int isScanUnused(PolarVolume_t* volume, PolarScan_t* scan, vol2bird_t* alldata);
+
+static void loadScanData(PolarScan_t* scan);
+
 static int includeGate(const int iProfileType, const int iQuantityType, const unsigned int gateCode, vol2bird_t* alldata);
 
 const char* libvol2bird_version(void);
 
 static int verticalProfile_AddCustomField(VerticalProfile_t* self, RaveField_t* field, const char* quantity);
 
+static int writeVptsRows(FILE* fp, vol2bird_t* alldata, PolarVolume_t* pvol, char* datetime, const size_t datetimeSize);
+
 static int profileArray2RaveField(vol2bird_t* alldata, int idx_profile, int idx_quantity, const char* quantity, RaveDataType raveType);
 
 static int mapVolumeToProfile(VerticalProfile_t* vp, PolarVolume_t* volume);
 
+static void mergeCells(int iCellFrom, int iCellTo, int* cellParent, int* cellSize, int* cellName);
+
+static int mapRangeBinsToLayers(const struct scanData* scanData, int* iLayerFirst, int* iLayerLast, vol2bird_t* alldata);
+
+static void movePointsRows(vol2birdPoints_t* points_local, const int iRowTo, const int iRowFrom, const int nRows);
+
+static int openMemoryFile(const void* buffer, const size_t size, char* path, const size_t pathSize);
+
+static int openVptsFile(struct vol2birdVptsFile* file, const int merge);
+
+static int parseVptsRow(struct vptsRow* row);
+
 PolarScanParam_t* PolarScan_newParam(PolarScan_t *scan, const char *quantity, RaveDataType type);
 
 int PolarVolume_dealias(PolarVolume_t* pvol);
@@ -124,6 +220,10 @@ PolarScanParam_t* PolarScanParam_resample(PolarScanParam_t* param, double rscale
 
 static void printCellProp(CELLPROP* cellProp, float elev, int nCells, int nCellsValid, vol2bird_t *alldata);
 
+static void printErrMessage(const char* msg);
+
+static void printErrMessages(struct errMessages* messages);
+
 static void printGateCode(char* flags, const unsigned int gateCode);
 
 static void printImage(PolarScan_t* scan, const char* quantity);
@@ -132,26 +232,44 @@ static int printMeta(PolarScan_t* scan, const char* quantity);
 
 static void printProfile(vol2bird_t* alldata);
 
+static void printScanImages(PolarScan_t* scan, vol2birdScanUse_t scanUse, vol2bird_t* alldata);
+
 static int removeDroppedCells(CELLPROP *cellProp, const int nCells);
 
+static void removeUnlistedQuantities(PolarScan_t* scan, const char* quantities);
+
+static void resetPointsRows(vol2birdPoints_t* points_local, const int iRowFrom, const int nRows);
+
 static int selectCellsToDrop(CELLPROP *cellProp, int nCells, int dualpol, vol2bird_t* alldata);
 
 static int selectCellsToDrop_singlePol(CELLPROP *cellProp, int nCells, vol2bird_t* alldata);
 
 static int selectCellsToDrop_dualPol(CELLPROP *cellProp, int nCells, vol2bird_t* alldata);
 
+static void selectLayerGates(vol2bird_t* alldata, const int iLayer, vol2birdLayerGates_t* gates1, vol2birdLayerGates_t* gates3);
+
 static void sortCellsByArea(CELLPROP *cellProp, const int nCells);
 
+static int sortVptsFile(struct vol2birdVptsFile* file);
+
+static int truncateFieldRange(RaveField_t* field, const long nbins, const long nrays, const long nbinsKeep);
+
+static void* truncateRangeBins(void* data, const long nbins, const long nrays, const long nbinsKeep, const RaveDataType type);
+
+static int truncateScanRange(PolarScan_t* scan, const float rangeMax);
+
+static int truncateVolumeRange(PolarVolume_t* volume, const float rangeMax);
+
 static void updateFlagFieldsInPointsArray(const float* yObs, const float* yFitted, const int* includedIndex, 
-                                          const int nPointsIncluded, float* points_local, vol2bird_t* alldata);
+                                          const int nPointsIncluded, uint32_t* gateCode_local, vol2bird_t* alldata);
 
-static int updateMap(PolarScan_t* scan, CELLPROP *cellProp, const int nCells, vol2bird_t* alldata);
+static int updateMap(struct scanData* scanData, CELLPROP *cellProp, const int nCells, vol2bird_t* alldata);
 
 #ifdef IRIS
-PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles);
+PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles, float rangeMax);
 #endif
 
-PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles);
+PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles, float rangeMax, vol2bird_t* alldata);
 
 #ifdef VOL2BIRD_R
 int check_mistnet_loaded_c(void);
@@ -161,6 +279,45 @@ static vol2bird_printfun vol2bird_internal_printf_fun = vol2bird_default_print;
 
 static vol2bird_printfun vol2bird_internal_err_printf_fun = vol2bird_default_err_print;
 
+// the messages of vol2bird_err_printf collected while a scan is segmented
+// in parallel, stored one after the other including their terminating
+// null characters, such that they are printed in scan order afterwards
+struct errMessages {
+    char* text;
+    size_t length;
+    size_t size;
+};
+
+// where vol2bird_err_printf collects the messages of the calling thread,
+// NULL when they are printed right away
+static struct errMessages* errMessagesCollected = NULL;
+#ifdef _OPENMP
+#pragma omp threadprivate(errMessagesCollected)
+#endif
+
+// the data of a scan as used in its segmentation by addScanToPointsArray.
+// initScanData creates the CELL and TEX parameters, reads the metadata and
+// sets up the views before the scans are segmented in parallel, from then on
+// only the data arrays of the views are read and written, RAVE is not called.
+// Views of parameters that the scan does not have have no data.
+struct scanData {
+    long nRang;
+    long nAzim;
+    // range bin size [m], elevation angle [rad] and radar height [m]
+    double rangeScale;
+    double elevAngle;
+    double radarHeight;
+    // the Nyquist velocity (how/NI) [m/s], 0 when not present
+    double nyquist;
+    vol2birdScanView_t dbz;
+    vol2birdScanView_t vrad;
+    vol2birdScanView_t tex;
+    vol2birdScanView_t rhohv;
+    vol2birdScanView_t cell;
+    vol2birdScanView_t clut;
+    struct errMessages messages;
+};
+
 // non-public function declarations (local to this file/translation unit)
 
 void vol2bird_printf(const char* fmt, ...)
@@ -187,9 +344,9 @@ void vol2bird_err_printf(const char* fmt, ...)
   n = vsnprintf(msg, 1024, fmt, ap);
   va_end(ap);
   if (n >= 0 && n <= 65536) {
-    vol2bird_internal_err_printf_fun(msg);
+    printErrMessage(msg);
   } else {
-    vol2bird_internal_err_printf_fun("vol2bird_err_printf failed when printing message");
+    printErrMessage("vol2bird_err_printf failed when printing message");
   }
 }
 
@@ -221,7 +378,73 @@ void vol2bird_set_err_printf(vol2bird_printfun fun)
   }
 }
 
-static int analyzeCells(PolarScan_t *scan, vol2birdScanUse_t scanUse, const int nCells, int dualpol, vol2bird_t *alldata) {
+static void collectErrMessages(struct errMessages* messages) {
+
+    // ------------------------------------------------------------- //
+    // have vol2bird_err_printf collect the messages of the calling  //
+    // thread in 'messages' instead of printing them, until called   //
+    // with NULL. The error printing function may be set by a host   //
+    // (e.g. R) to one that can only be called from a single thread  //
+    // ------------------------------------------------------------- //
+
+    errMessagesCollected = messages;
+
+} // collectErrMessages
+
+
+
+static void printErrMessage(const char* msg) {
+
+    // print 'msg' with the error printing function, or add it to the
+    // messages that the calling thread collects
+
+    struct errMessages* messages = errMessagesCollected;
+
+    if (messages == NULL) {
+        vol2bird_internal_err_printf_fun(msg);
+        return;
+    }
+
+    size_t size = strlen(msg) + 1;
+
+    if (messages->length + size > messages->size) {
+        size_t sizeNew = 2 * (messages->length + size);
+        char* text = realloc(messages->text, sizeNew);
+        if (text == NULL) {
+            // the message is lost, but the ones collected so far are kept
+            return;
+        }
+        messages->text = text;
+        messages->size = sizeNew;
+    }
+
+    memcpy(&messages->text[messages->length], msg, size);
+    messages->length += size;
+
+} // printErrMessage
+
+
+
+static void printErrMessages(struct errMessages* messages) {
+
+    // print the messages collected in 'messages' in the order in which
+    // they were collected, and free them
+
+    size_t iChar = 0;
+
+    while (iChar < messages->length) {
+        vol2bird_internal_err_printf_fun(&messages->text[iChar]);
+        iChar += strlen(&messages->text[iChar]) + 1;
+    }
+
+    free((void*) messages->text);
+    messages->text = NULL;
+    messages->length = 0;
+    messages->size = 0;
+
+} // printErrMessages
+
+static int analyzeCells(struct scanData* scanData, const int nCells, int dualpol, vol2bird_t *alldata) {
 
     // ----------------------------------------------------------------------------------- // 
     //  This function analyzes the cellImage array found by the 'findWeatherCells'         //
@@ -231,39 +454,31 @@ static int analyzeCells(PolarScan_t *scan, vol2birdScanUse_t scanUse, const int
 
     CELLPROP *cellProp;
     int nCellsValid;
-    long nAzim;
-    long nRang;
 
     nCellsValid = nCells;
-    nRang = PolarScan_getNbins(scan);
-    nAzim = PolarScan_getNrays(scan);
     nCellsValid = 0;
     
-    if(!PolarScan_hasParameter(scan, scanUse.cellName)){
+    if (scanData->cell.data == NULL) {
         vol2bird_err_printf("no CELL quantity in polar scan, aborting analyzeCells()\n");
         return 0;
     }
     
     // first deal with the case that no weather cells were detected by findWeatherCells
     if (nCells == 0) {
-        for (int iAzim = 0; iAzim < nAzim; iAzim++) {
-            for (int iRang = 0; iRang < nRang; iRang++) {
-                PolarScan_setParameterValue(scan, scanUse.cellName, iRang, iAzim, -1);
-            }
-        }
+        scanViewFill(&scanData->cell, -1);
         return nCellsValid;
     }
     
-    cellProp = getCellProperties(scan, scanUse, nCells, alldata);
+    cellProp = getCellProperties(scanData, nCells, alldata);
 
     selectCellsToDrop(cellProp, nCells, dualpol, alldata);    
     
     // sorting cell properties according to cell area. Drop small cells from map
-    nCellsValid = updateMap(scan, cellProp, nCells, alldata);
+    nCellsValid = updateMap(scanData, cellProp, nCells, alldata);
         
     // printing of cell properties to stderr
     if (alldata->options.printCellProp == TRUE) {
-        printCellProp(cellProp, (float) PolarScan_getElangle(scan), nCells, nCellsValid, alldata);
+        printCellProp(cellProp, (float) scanData->elevAngle, nCells, nCellsValid, alldata);
     } // endif (printCellProp == TRUE)
 
     free(cellProp);
@@ -300,27 +515,35 @@ static float calcDist(const int iRang1, const int iAzim1, const int iRang2,
 
 
 
-static void calcTexture(PolarScan_t *scan, vol2birdScanUse_t scanUse, vol2bird_t* alldata) {
+static void calcTexture(struct scanData* scanData, vol2bird_t* alldata) {
 
 
     // --------------------------------------------------------------------------------------- //
     // This function computes a texture parameter based on a block of (nRangNeighborhood x     //
     // nAzimNeighborhood) pixels. The texture parameter equals the local standard deviation    //
     // in the radial velocity field                                                            //
+    //                                                                                         //
+    // The standard deviation of the differences between the centre gate and its neighbours    //
+    // equals vradScale times the standard deviation of the raw neighbour values, so only      //
+    // the sum, the sum of squares and the count of valid raw values in the block are needed.  //
+    // These are kept as running sums: per range bin over the azimuth window, updated when     //
+    // moving to the next azimuth, and as cumulative sums over range within each azimuth,      //
+    // such that the cost per gate does not depend on the size of the block.                   //
     // --------------------------------------------------------------------------------------- //
 
 
-    int iRang, iRangLocal;
-    int iAzim, iAzimLocal;
+    int iRang;
+    int iAzim;
+    int iAzimOut;
+    int iAzimIn;
     long nRang;
     long nAzim;
-    int iNeighborhood;
-    int nNeighborhood;
+    int nAzimHalf;
+    int nRangHalf;
+    int iRangFrom;
+    int iRangTo;
     int count;
-    double vradValGlobal;
-    double vradValLocal;
-    double dbzValGlobal;
-    double dbzValLocal;
+    int iGlobal;
     double vradMissingValue;
     double vradUndetectValue;
     double dbzMissingValue;
@@ -328,116 +551,134 @@ static void calcTexture(PolarScan_t *scan, vol2birdScanUse_t scanUse, vol2bird_t
     double texMissingValue;
     double vmoment1;
     double vmoment2;
-    double dbz;
     double tex;
-    int iGlobal;
-    int iLocal;
     double texOffset;
     double texScale;
-    double dbzOffset;
-    double dbzScale;
-    double vradOffset;
     double vradScale;
-    double vRadDiff;
-
-    nRang = PolarScan_getNbins(scan);
-    nAzim = PolarScan_getNrays(scan);
 
-    PolarScanParam_t* texImage = PolarScan_getParameter(scan, scanUse.texName);
-    PolarScanParam_t* vradImage = PolarScan_getParameter(scan, scanUse.vradName);
-    PolarScanParam_t* dbzImage = PolarScan_getParameter(scan, scanUse.dbzName);
-
-    if(scanUse.useScan != 1){
-      vol2bird_err_printf("Error: scanUse unequal to 1 (%i), this scan should not be used\n",scanUse.useScan);
-    }
-    if (texImage == NULL) {
+    double* vradRaw = NULL;
+    double* dbzRaw = NULL;
+    vol2birdScanView_t* vradView = &scanData->vrad;
+    vol2birdScanView_t* dbzView = &scanData->dbz;
+    vol2birdScanView_t* texView = &scanData->tex;
+    double* colSum1 = NULL;
+    double* colSum2 = NULL;
+    int* colCount = NULL;
+    double* cumSum1 = NULL;
+    double* cumSum2 = NULL;
+    int* cumCount = NULL;
+
+    nRang = scanData->nRang;
+    nAzim = scanData->nAzim;
+
+    if (texView->data == NULL) {
       vol2bird_err_printf("Error: Couldn't fetch texture parameter for texture calculation\n");
+      goto done;
     }
-    if (vradImage == NULL) {
+    if (vradView->data == NULL) {
       vol2bird_err_printf("Error: Couldn't fetch radial velocity parameter for texture calculation\n");
+      goto done;
     }
-    if (dbzImage == NULL) {
+    if (dbzView->data == NULL) {
       vol2bird_err_printf("Error: Couldn't fetch reflectivity parameter for texture calculation\n");
+      goto done;
     }
 
-    dbzOffset = PolarScanParam_getOffset(dbzImage);
-    dbzScale = PolarScanParam_getGain(dbzImage);
-    dbzMissingValue = PolarScanParam_getNodata(dbzImage);
-    dbzUndetectValue = PolarScanParam_getUndetect(dbzImage);
-
-    vradOffset = PolarScanParam_getOffset(vradImage);
-    vradScale = PolarScanParam_getGain(vradImage);
-    vradMissingValue = PolarScanParam_getNodata(vradImage);
-    vradUndetectValue = PolarScanParam_getUndetect(vradImage);
-
-    texOffset = PolarScanParam_getOffset(texImage);
-    texScale = PolarScanParam_getGain(texImage);
-    texMissingValue = PolarScanParam_getNodata(texImage);
+    dbzMissingValue = dbzView->nodata;
+    dbzUndetectValue = dbzView->undetect;
 
-    nNeighborhood = (int)(alldata->constants.nRangNeighborhood * alldata->constants.nAzimNeighborhood);
+    vradScale = vradView->gain;
+    vradMissingValue = vradView->nodata;
+    vradUndetectValue = vradView->undetect;
 
-    for (iAzim = 0; iAzim < nAzim; iAzim++) {
-        for (iRang = 0; iRang < nRang; iRang++) {
+    texOffset = texView->offset;
+    texScale = texView->gain;
+    texMissingValue = texView->nodata;
 
-            iGlobal = iRang + iAzim * nRang;
+    nAzimHalf = alldata->constants.nAzimNeighborhood / 2;
+    nRangHalf = alldata->constants.nRangNeighborhood / 2;
 
-            // count number of direct neighbors above threshold
-            count = 0;
-            vmoment1 = 0;
-            vmoment2 = 0;
+    vradRaw = malloc(sizeof(double) * nAzim * nRang);
+    dbzRaw = malloc(sizeof(double) * nAzim * nRang);
+    colSum1 = malloc(sizeof(double) * nRang);
+    colSum2 = malloc(sizeof(double) * nRang);
+    colCount = malloc(sizeof(int) * nRang);
+    cumSum1 = malloc(sizeof(double) * (nRang + 1));
+    cumSum2 = malloc(sizeof(double) * (nRang + 1));
+    cumCount = malloc(sizeof(int) * (nRang + 1));
 
-            dbz = 0;
+    if (vradRaw == NULL || dbzRaw == NULL || colSum1 == NULL || colSum2 == NULL || colCount == NULL ||
+        cumSum1 == NULL || cumSum2 == NULL || cumCount == NULL) {
+        vol2bird_err_printf("Error pre-allocating arrays for texture calculation\n");
+        goto done;
+    }
 
-            for (iNeighborhood = 0; iNeighborhood < nNeighborhood; iNeighborhood++) {
+    scanViewGetRawValues(vradView, vradRaw);
+    scanViewGetRawValues(dbzView, dbzRaw);
 
-                iLocal = findNearbyGateIndex(nAzim,nRang,iGlobal,alldata->constants.nAzimNeighborhood,
-                         alldata->constants.nRangNeighborhood,iNeighborhood,&iAzimLocal,&iRangLocal);
+    // mark the gates that do not count as a neighbor with NAN,
+    // from here on only vradRaw is needed
+    for (iGlobal = 0; iGlobal < nAzim * nRang; iGlobal++) {
+        if (vradRaw[iGlobal] == vradMissingValue || dbzRaw[iGlobal] == dbzMissingValue ||
+            vradRaw[iGlobal] == vradUndetectValue || dbzRaw[iGlobal] == dbzUndetectValue) {
+            vradRaw[iGlobal] = NAN;
+        }
+    }
 
-                #ifdef FPRINTFON
-                vol2bird_err_printf("iLocal = %d; ",iLocal);
-                #endif
+    // sums over the azimuth window of the first azimuth; the azimuth dimension
+    // is wrapped (polar plot), iAzim = 0 is adjacent to iAzim = nAzim-1
+    for (iRang = 0; iRang < nRang; iRang++) {
+        colSum1[iRang] = 0;
+        colSum2[iRang] = 0;
+        colCount[iRang] = 0;
+    }
+    for (iAzimIn = -nAzimHalf; iAzimIn <= nAzimHalf; iAzimIn++) {
+        addTextureRow(&vradRaw[((iAzimIn % nAzim + nAzim) % nAzim) * nRang], nRang, 1, colSum1, colSum2, colCount);
+    }
 
-                if (iLocal < 0) {
-                    // iLocal less than zero are error codes
-                    continue;
-                }
-                
-                PolarScanParam_getValue(vradImage, iRang, iAzim, &vradValGlobal);
-                PolarScanParam_getValue(vradImage, iRangLocal, iAzimLocal, &vradValLocal);
-                PolarScanParam_getValue(dbzImage, iRang, iAzim, &dbzValGlobal);
-                PolarScanParam_getValue(dbzImage, iRangLocal, iAzimLocal, &dbzValLocal);
+    for (iAzim = 0; iAzim < nAzim; iAzim++) {
 
-                
-                if (vradValLocal == vradMissingValue || dbzValLocal == dbzMissingValue ||
-                    vradValLocal == vradUndetectValue || dbzValLocal == dbzUndetectValue) {
-                    continue;
-                }
+        if (iAzim > 0) {
+            // move the azimuth window by one ray
+            iAzimOut = ((iAzim - 1 - nAzimHalf) % nAzim + nAzim) % nAzim;
+            iAzimIn = (iAzim + nAzimHalf) % nAzim;
+            addTextureRow(&vradRaw[iAzimOut * nRang], nRang, -1, colSum1, colSum2, colCount);
+            addTextureRow(&vradRaw[iAzimIn * nRang], nRang, 1, colSum1, colSum2, colCount);
+        }
 
-                vRadDiff = vradOffset + vradScale * (vradValGlobal - vradValLocal);
-                vmoment1 += vRadDiff;
-                vmoment2 += SQUARE(vRadDiff);
+        cumSum1[0] = 0;
+        cumSum2[0] = 0;
+        cumCount[0] = 0;
+        for (iRang = 0; iRang < nRang; iRang++) {
+            cumSum1[iRang + 1] = cumSum1[iRang] + colSum1[iRang];
+            cumSum2[iRang + 1] = cumSum2[iRang] + colSum2[iRang];
+            cumCount[iRang + 1] = cumCount[iRang] + colCount[iRang];
+        }
 
-                dbz += dbzOffset + dbzScale * dbzValLocal;
+        for (iRang = 0; iRang < nRang; iRang++) {
 
-                count++;
+            iGlobal = iRang + iAzim * nRang;
 
-            }
+            // the range dimension is not wrapped
+            iRangFrom = iRang - nRangHalf < 0 ? 0 : iRang - nRangHalf;
+            iRangTo = iRang + nRangHalf > nRang - 1 ? nRang - 1 : iRang + nRangHalf;
 
-            vmoment1 /= count;
-            vmoment2 /= count;
-            dbz /= count;
+            count = cumCount[iRangTo + 1] - cumCount[iRangFrom];
 
             // when not enough neighbors, continue
             if (count < alldata->constants.nCountMin) {
-                PolarScanParam_setValue(texImage,iRang,iAzim,texMissingValue);
+                scanViewSetValue(texView,iRang,iAzim,texMissingValue);
             }
             else {
 
-                tex = sqrt(XABS(vmoment2-SQUARE(vmoment1)));
+                vmoment1 = (cumSum1[iRangTo + 1] - cumSum1[iRangFrom]) / count;
+                vmoment2 = (cumSum2[iRangTo + 1] - cumSum2[iRangFrom]) / count;
+
+                tex = sqrt(XABS(SQUARE(vradScale) * (vmoment2-SQUARE(vmoment1))));
 
                 float tmpTex = (tex - texOffset) / texScale;
                 if (-FLT_MAX <= tmpTex && tmpTex <= FLT_MAX) {
-                    PolarScanParam_setValue(texImage,iRang,iAzim,(double) tmpTex);
+                    scanViewSetValue(texView,iRang,iAzim,(double) tmpTex);
                 }
                 else {
                     vol2bird_err_printf("Error casting texture value of %f to float type at texImage[%d]. Aborting.\n",tmpTex,iGlobal);
@@ -456,24 +697,89 @@ static void calcTexture(PolarScan_t *scan, vol2birdScanUse_t scanUse, vol2bird_t
         } //for
     } //for
 done:
-    RAVE_OBJECT_RELEASE(texImage);
-    RAVE_OBJECT_RELEASE(vradImage);
-    RAVE_OBJECT_RELEASE(dbzImage);
+    free((void*) vradRaw);
+    free((void*) dbzRaw);
+    free((void*) colSum1);
+    free((void*) colSum2);
+    free((void*) colCount);
+    free((void*) cumSum1);
+    free((void*) cumSum2);
+    free((void*) cumCount);
 } // calcTexture
 
 
 
+static void addTextureRow(const double* rowValues, const long nRang, const int sign,
+                          double* colSum1, double* colSum2, int* colCount) {
+
+    // add (sign = 1) or subtract (sign = -1) a ray of raw values to the
+    // running sums of calcTexture, gates marked with NAN are skipped
+
+    long iRang;
+
+    for (iRang = 0; iRang < nRang; iRang++) {
+        if (isnan(rowValues[iRang])) {
+            continue;
+        }
+        colSum1[iRang] += sign * rowValues[iRang];
+        colSum2[iRang] += sign * SQUARE(rowValues[iRang]);
+        colCount[iRang] += sign;
+    }
+
+} // addTextureRow
+
+
+
+static int allocateScratch(vol2birdScratch_t* scratch, const int nPointsMax, vol2bird_t* alldata) {
+
+    // allocates the working buffers of vol2birdCalcProfiles for layers of
+    // up to nPointsMax points. Returns the number of buffers allocated, or
+    // -1 when memory could not be allocated
+
+    const int nPoints = nPointsMax > 0 ? nPointsMax : 1;
+
+    scratch->nPointsMax = nPointsMax;
+    scratch->pointsSelection = (float*) malloc(sizeof(float) * nPoints * alldata->misc.nDims);
+    scratch->yNyquist = (float*) malloc(sizeof(float) * nPoints);
+    scratch->yDealias = (float*) malloc(sizeof(float) * nPoints);
+    scratch->yObs = (float*) malloc(sizeof(float) * nPoints);
+    scratch->yFitted = (float*) malloc(sizeof(float) * nPoints);
+    scratch->includedIndex = (int*) malloc(sizeof(int) * nPoints);
+    scratch->gates1.index = (int*) malloc(sizeof(int) * nPoints);
+    scratch->gates3.index = (int*) malloc(sizeof(int) * nPoints);
+    scratch->svdfitWork = (float*) malloc(sizeof(float) * nPoints * alldata->misc.nParsFitted);
+    scratch->dealiasWork = dealias_work_alloc(nPoints);
+
+    if (scratch->pointsSelection == NULL || scratch->yNyquist == NULL || scratch->yDealias == NULL ||
+        scratch->yObs == NULL || scratch->yFitted == NULL || scratch->includedIndex == NULL ||
+        scratch->gates1.index == NULL || scratch->gates3.index == NULL ||
+        scratch->svdfitWork == NULL || scratch->dealiasWork == NULL) {
+        vol2bird_err_printf("Error pre-allocating working buffers for %d points.\n", nPointsMax);
+        freeScratch(scratch);
+        return -1;
+    }
+
+    // the dealiasing grid search only spreads over threads when it is
+    // not already running inside the parallel loop over the layers
+    scratch->dealiasWork->nThreads = alldata->options.nThreads;
+
+    return 10;
+
+} // allocateScratch
+
+
+
 static void classifyGatesSimple(vol2bird_t* alldata) {
     
     int iPoint;
     
     for (iPoint = 0; iPoint < alldata->points.nRowsPoints; iPoint++) {
     
-        const float azimValue = alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.azimAngleCol];
-        const float dbzValue = alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.dbzValueCol];        
-        const float vradValue = alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.vradValueCol];
-        const int cellValue = (int) alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.cellValueCol];
-        const float clutValue = alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.clutValueCol];
+        const float azimValue = alldata->points.azimAngle[iPoint];
+        const float dbzValue = alldata->points.dbzValue[iPoint];
+        const float vradValue = alldata->points.vradValue[iPoint];
+        const int cellValue = (int) alldata->points.cellValue[iPoint];
+        const float clutValue = alldata->points.clutValue[iPoint];
 
         unsigned int gateCode = 0;
         
@@ -528,7 +834,7 @@ static void classifyGatesSimple(vol2bird_t* alldata) {
             }
         }
 
-        alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.gateCodeCol] = (float) gateCode;
+        alldata->points.gateCode[iPoint] = gateCode;
         
     }
 
@@ -537,259 +843,359 @@ static void classifyGatesSimple(vol2bird_t* alldata) {
 
 
 
-static void constructPointsArray(PolarVolume_t* volume, vol2birdScanUse_t* scanUse, vol2bird_t* alldata) {
-    
-        // iterate over the scans in 'volume'
-        int iScan;
-        int nScans;
-        
-        // determine how many scan elevations the volume object contains
-        nScans = PolarVolume_getNumberOfScans(volume);
-
-
-        for (iScan = 0; iScan < nScans; iScan++) {
-            if (scanUse[iScan].useScan == 1)
-            {
-                // extract the scan object from the volume object
-                PolarScan_t* scan = PolarVolume_getScan(volume, iScan);
+static int addScanToPointsArray(struct scanData* scanData, const int iScan, const int nScans,
+                                const int* iRowSlot, const int* nRowsSlot, int* nRowsWritten, vol2bird_t* alldata) {
 
-                PolarScanParam_t *cellScanParam = NULL;
-                PolarScanParam_t *texScanParam = NULL;
-                
-                // check that CELL parameter is not present, which might be after running MistNet
-                if (!PolarScan_hasParameter(scan, CELLNAME)){
-                    cellScanParam = PolarScan_newParam(scan, scanUse[iScan].cellName, RaveDataType_INT);
-                }
-                // only when dealing with normal (non-dual pol) data, generate a vrad texture field
-                if (alldata->options.singlePol){
-                    // ------------------------------------------------------------- //
-                    //                      calculate vrad texture                   //
-                    // ------------------------------------------------------------- //
+    // ------------------------------------------------------------- //
+    // segment a single scan and write its gates into the slots of   //
+    // the 'points' array that were reserved for this scan, one slot //
+    // per altitude layer. Only this scan's data arrays and slots    //
+    // are modified and RAVE is not called, such that scans can be   //
+    // processed in parallel. 'scanData' is set up by initScanData   //
+    // ------------------------------------------------------------- //
 
-                    texScanParam = PolarScan_newParam(scan, scanUse[iScan].texName, RaveDataType_DOUBLE);
+    // only when dealing with normal (non-dual pol) data, generate a vrad texture field
+    if (alldata->options.singlePol){
+        // ------------------------------------------------------------- //
+        //                      calculate vrad texture                   //
+        // ------------------------------------------------------------- //
 
-                    calcTexture(scan, scanUse[iScan], alldata);					
-                }
+        calcTexture(scanData, alldata);
+    }
 
-                int nCells = -1;
+    int nCells = -1;
 
-                // ------------------------------------------------------------- //
-                //        find (weather) cells in the reflectivity image         //
-                // ------------------------------------------------------------- //
+    // ------------------------------------------------------------- //
+    //        find (weather) cells in the reflectivity image         //
+    // ------------------------------------------------------------- //
 				
-                if (alldata->options.dualPol && !alldata->options.useMistNet){
-                    
-                    if (alldata->options.singlePol){
+    if (alldata->options.dualPol && !alldata->options.useMistNet){
+        
+        if (alldata->options.singlePol){
 						
-                        // first pass: single pol rain filtering
-                        nCells = findWeatherCells(scan,scanUse[iScan].dbzName,alldata->options.dbzThresMin,TRUE,2,TRUE,alldata);
-                        // first pass: single pol analysis of precipitation cells
-                        analyzeCells(scan, scanUse[iScan], nCells, FALSE, alldata);
-                        // second pass: dual pol precipitation filtering
-                        nCells = findWeatherCells(scan,scanUse[iScan].rhohvName,
-                                    alldata->options.rhohvThresMin,TRUE,nCells+1,FALSE,alldata);
-                    }
-                    else{
-                        nCells = findWeatherCells(scan,scanUse[iScan].rhohvName,
-                                    alldata->options.rhohvThresMin,TRUE,2,TRUE,alldata);						
-                    }
+            // first pass: single pol rain filtering
+            nCells = findWeatherCells(scanData,&scanData->dbz,alldata->options.dbzThresMin,TRUE,2,TRUE,alldata);
+            // first pass: single pol analysis of precipitation cells
+            analyzeCells(scanData, nCells, FALSE, alldata);
+            // second pass: dual pol precipitation filtering
+            nCells = findWeatherCells(scanData,&scanData->rhohv,
+                        alldata->options.rhohvThresMin,TRUE,nCells+1,FALSE,alldata);
+        }
+        else{
+            nCells = findWeatherCells(scanData,&scanData->rhohv,
+                        alldata->options.rhohvThresMin,TRUE,2,TRUE,alldata);						
+        }
 
-                }
+    }
 
-                if (!alldata->options.dualPol && !alldata->options.useMistNet){
-                    
-                    nCells = findWeatherCells(scan,scanUse[iScan].dbzName,alldata->options.dbzThresMin,TRUE,2,TRUE,alldata);
+    if (!alldata->options.dualPol && !alldata->options.useMistNet){
+        
+        nCells = findWeatherCells(scanData,&scanData->dbz,alldata->options.dbzThresMin,TRUE,2,TRUE,alldata);
 
-                }
-                
-                if (alldata->options.useMistNet){
-                    nCells = 2;
-                }
-                
-                if (nCells<0){
-                    vol2bird_err_printf("Error: findWeatherCells exited with errors\n");
-                    RAVE_OBJECT_RELEASE(scan);
-                    RAVE_OBJECT_RELEASE(cellScanParam);
-                    RAVE_OBJECT_RELEASE(texScanParam);
-                    return;
-                }
-                
-                if (alldata->options.printCellProp == TRUE) {
-                    vol2bird_err_printf("(%d/%d): found %d cells.\n",iScan+1, nScans, nCells);
-                }
-                
-                // ------------------------------------------------------------- //
-                //                      analyze cells                            //
-                // ------------------------------------------------------------- //
-                if (!alldata->options.useMistNet){
-                    nCells=analyzeCells(scan, scanUse[iScan], nCells, alldata->options.dualPol, alldata);
-                }
-                // ------------------------------------------------------------- //
-                //                     calculate fringe                          //
-                // ------------------------------------------------------------- //
-    
-                fringeCells(scan, alldata); 
-                // ------------------------------------------------------------- //
-                //            print selected outputs to stderr                   //
-                // ------------------------------------------------------------- //
-    
-                if (alldata->options.printDbz == TRUE) {
-                    vol2bird_err_printf("product = dbz\n");
-                    printMeta(scan,scanUse[iScan].dbzName);
-                    printImage(scan,scanUse[iScan].dbzName);
-                }
-                if (alldata->options.printVrad == TRUE) {
-                    vol2bird_err_printf("product = vrad\n");
-                    printMeta(scan,scanUse[iScan].vradName);
-                    printImage(scan,scanUse[iScan].vradName);
-                }
-                if (alldata->options.printRhohv == TRUE) {
-                    vol2bird_err_printf("product = rhohv\n");
-                    printMeta(scan,scanUse[iScan].rhohvName);
-                    printImage(scan,scanUse[iScan].rhohvName);
-                }
-                if (alldata->options.printTex == TRUE) {
-                    vol2bird_err_printf("product = tex\n");
-                    printMeta(scan,scanUse[iScan].texName);
-                    printImage(scan,scanUse[iScan].texName);
-                }
-                if (alldata->options.printCell == TRUE) {
-                    vol2bird_err_printf("product = cell\n");
-                    printMeta(scan,scanUse[iScan].cellName);
-                    printImage(scan,scanUse[iScan].cellName);
-                }
-                if (alldata->options.printClut == TRUE) { 
-                    vol2bird_err_printf("product = clut\n");
-                    printMeta(scan,scanUse[iScan].clutName);
-                    printImage(scan,scanUse[iScan].clutName);
-                }
-                            
-                // ------------------------------------------------------------- //
-                //    fill in the appropriate elements in the points array       //
-                // ------------------------------------------------------------- //
+    }
     
-                int iLayer;
-                
-                for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
-                    
-                    float altitudeMin = iLayer * alldata->options.layerThickness;
-                    float altitudeMax = (iLayer + 1) * alldata->options.layerThickness;
-                    int iRowPoints = alldata->points.indexFrom[iLayer] + alldata->points.nPointsWritten[iLayer];
-                        
-                    int n = getListOfSelectedGates(scan, scanUse[iScan], altitudeMin, altitudeMax, 
-                        &(alldata->points.points[0]), iRowPoints, alldata->points.nColsPoints, alldata);
-                    
-                    alldata->points.nPointsWritten[iLayer] += n;
-
-                    if (alldata->points.indexFrom[iLayer] + alldata->points.nPointsWritten[iLayer] > alldata->points.indexTo[iLayer]) {
-                        vol2bird_err_printf("Problem occurred: writing over existing data\n");
-                        RAVE_OBJECT_RELEASE(scan);
-                        RAVE_OBJECT_RELEASE(cellScanParam);
-                        RAVE_OBJECT_RELEASE(texScanParam);
-                        return;
-                    }
+    if (alldata->options.useMistNet){
+        nCells = 2;
+    }
     
-                } // endfor (iLayer = 0; iLayer < nLayers; iLayer++)
-
-                // ------------------------------------------------------------- //
-                //                         clean up                              //
-                // ------------------------------------------------------------- //
+    if (nCells<0){
+        vol2bird_err_printf("Error: findWeatherCells exited with errors\n");
+        return -1;
+    }
     
-                // free previously malloc'ed arrays                
-                RAVE_OBJECT_RELEASE(scan);
-                RAVE_OBJECT_RELEASE(texScanParam);
-                RAVE_OBJECT_RELEASE(cellScanParam);
-            }
-        } // endfor (iScan = 0; iScan < nScans; iScan++)
-}
+    if (alldata->options.printCellProp == TRUE) {
+        vol2bird_err_printf("(%d/%d): found %d cells.\n",iScan+1, nScans, nCells);
+    }
+    
+    // ------------------------------------------------------------- //
+    //                      analyze cells                            //
+    // ------------------------------------------------------------- //
+    if (!alldata->options.useMistNet){
+        nCells=analyzeCells(scanData, nCells, alldata->options.dualPol, alldata);
+    }
+    // ------------------------------------------------------------- //
+    //                     calculate fringe                          //
+    // ------------------------------------------------------------- //
 
+    fringeCells(scanData, alldata); 
+                
+    // ------------------------------------------------------------- //
+    //    fill in the appropriate elements in the points array       //
+    // ------------------------------------------------------------- //
 
+    if (getListOfSelectedGates(scanData, &(alldata->points),
+            iRowSlot, nRowsSlot, nRowsWritten, alldata) < 0) {
+        vol2bird_err_printf("Problem occurred: writing over existing data\n");
+        return -1;
+    }
 
-static int detNumberOfGates(const int iLayer, 
-                     const float rangeScale, const float elevAngle,
-                     const int nRang, const int nAzim,
-                     const float radarHeight, vol2bird_t* alldata) {
+    return 0;
 
-    // Determine the number of gates that are within the limits set
-    // by (rangeMin,rangeMax) as well as by (iLayer*layerThickness,
-    // (iLayer+1)*layerThickness).
+} // addScanToPointsArray
 
-    int nGates;
-    int iRang;
 
-    float layerHeight;
-    float range;
-    float beamHeight;
 
+static int compareCellsByArea(const void* a, const void* b) {
 
-    nGates = 0;
-    layerHeight = (iLayer + 0.5) * alldata->options.layerThickness;
-    for (iRang = 0; iRang < nRang; iRang++) {
-        range = (iRang + 0.5) * rangeScale;
-        if (range < alldata->options.rangeMin || range > alldata->options.rangeMax) {
-            // the gate is too close to the radar, or too far away
-            continue;
-        }
-        beamHeight = range2height(range, elevAngle) + radarHeight;
-        if (fabs(layerHeight - beamHeight) > 0.5*alldata->options.layerThickness) {
-            // the gate is not close enough to the altitude layer of interest
-            continue;
-        }
+    // comparison function for sorting cells by decreasing number of gates with
+    // qsort. Cells of equal size are kept in order of their index, as the
+    // sorting is done on cells that are ordered by index.
 
-        #ifdef FPRINTFON
-        vol2bird_err_printf("iRang = %d; range = %f; beamHeight = %f\n",iRang,range,beamHeight);
-        #endif
+    const CELLPROP* cellA = (const CELLPROP*) a;
+    const CELLPROP* cellB = (const CELLPROP*) b;
 
-        nGates += nAzim;
+    if (cellA->nGates != cellB->nGates) {
+        return cellA->nGates < cellB->nGates ? 1 : -1;
+    }
 
-    } // for iRang
+    return (cellA->index > cellB->index) - (cellA->index < cellB->index);
 
-    return nGates;
+} // compareCellsByArea
 
-} // detNumberOfGates()
 
 
+static int compareInt(const void* a, const void* b) {
 
+    // comparison function for sorting integers with qsort
 
+    int intA = *((const int*) a);
+    int intB = *((const int*) b);
 
-static int detSvdfitArraySize(PolarVolume_t* volume, vol2birdScanUse_t* scanUse, vol2bird_t* alldata) {
-    
-    int iScan;
-    int nScans = PolarVolume_getNumberOfScans(volume);
+    return (intA > intB) - (intA < intB);
 
-    int iLayer;
-    int nRowsPoints_local = 0;
-    
-    int* nGates = malloc(sizeof(int) * alldata->options.nLayers);
-    int* nGatesAcc = malloc(sizeof(int) * alldata->options.nLayers);
-    
-    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
-        nGates[iLayer] = 0;
-        nGatesAcc[iLayer] = 0;
-    }
+} // compareInt
 
-    for (iScan = 0; iScan < nScans; iScan++) {
-        if (scanUse[iScan].useScan == 1)
-        {
-            for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
-    
-                PolarScan_t* scan = PolarVolume_getScan(volume, iScan);
-                
-                int nRang = (int) PolarScan_getNbins(scan);
-                int nAzim = (int) PolarScan_getNrays(scan);
-                float elevAngle = (float) PolarScan_getElangle(scan);
-                float rangeScale = (float) PolarScan_getRscale(scan);
-                float radarHeight = (float) PolarScan_getHeight(scan);
-
-                nGates[iLayer] += detNumberOfGates(iLayer, 
-                    rangeScale, elevAngle, nRang, 
-                    nAzim, radarHeight, alldata);
-                    
-                RAVE_OBJECT_RELEASE(scan);
 
-            }
-        }
-    }
+
+static void constructPointsArray(PolarVolume_t* volume, vol2birdScanUse_t* scanUse, vol2bird_t* alldata) {
+    
+        // iterate over the scans in 'volume'
+        int iScan;
+        int nScans;
+        int iLayer;
+        int nLayers = alldata->options.nLayers;
+        
+        // determine how many scan elevations the volume object contains
+        nScans = PolarVolume_getNumberOfScans(volume);
+
+        PolarScan_t** scans = malloc(sizeof(PolarScan_t*) * nScans);
+        struct scanData* scanData = malloc(sizeof(struct scanData) * nScans);
+        int* scanResult = malloc(sizeof(int) * nScans);
+        // first row and number of rows reserved in 'points' for each scan and layer
+        int* iRowSlot = malloc(sizeof(int) * nScans * nLayers);
+        int* nRowsSlot = malloc(sizeof(int) * nScans * nLayers);
+        int* nRowsWritten = malloc(sizeof(int) * nScans * nLayers);
+
+        if (scans == NULL || scanData == NULL || scanResult == NULL || iRowSlot == NULL || nRowsSlot == NULL || nRowsWritten == NULL) {
+            vol2bird_err_printf("Error pre-allocating arrays in constructPointsArray\n");
+            free((void*) scans);
+            scans = NULL;
+            free((void*) scanData);
+            scanData = NULL;
+            goto done;
+        }
+
+        for (iScan = 0; iScan < nScans; iScan++) {
+            scans[iScan] = NULL;
+            scanData[iScan].messages.text = NULL;
+            scanData[iScan].messages.length = 0;
+            scanData[iScan].messages.size = 0;
+        }
+
+        // ------------------------------------------------------------- //
+        //   reserve a slot in 'points' for each scan and each layer,    //
+        //   following the order in which scans are stored per layer     //
+        // ------------------------------------------------------------- //
+
+        for (iScan = 0; iScan < nScans; iScan++) {
+            scanResult[iScan] = 0;
+            for (iLayer = 0; iLayer < nLayers; iLayer++) {
+                nRowsSlot[iScan * nLayers + iLayer] = 0;
+                nRowsWritten[iScan * nLayers + iLayer] = 0;
+            }
+            if (scanUse[iScan].useScan == 1) {
+                scans[iScan] = PolarVolume_getScan(volume, iScan);
+                initScanData(scans[iScan], scanUse[iScan], &scanData[iScan], alldata);
+                if (detNumberOfGates(scans[iScan], &nRowsSlot[iScan * nLayers], alldata) < 0) {
+                    goto done;
+                }
+            }
+        }
+
+        for (iLayer = 0; iLayer < nLayers; iLayer++) {
+
+            int iRowPoints = alldata->points.indexFrom[iLayer] + alldata->points.nPointsWritten[iLayer];
+
+            for (iScan = 0; iScan < nScans; iScan++) {
+
+                int iSlot = iScan * nLayers + iLayer;
+
+                iRowSlot[iSlot] = iRowPoints;
+                iRowPoints += nRowsSlot[iSlot];
+            }
+
+            // the last slot may not extend beyond this layer's part of 'points'
+            if (iRowPoints > alldata->points.indexTo[iLayer]) {
+                nRowsSlot[(nScans - 1) * nLayers + iLayer] -= iRowPoints - alldata->points.indexTo[iLayer];
+            }
+        }
+
+        // ------------------------------------------------------------- //
+        //       segment the scans and fill their reserved slots         //
+        // ------------------------------------------------------------- //
+
+        int nThreads = alldata->options.nThreads;
+
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic,1) num_threads(nThreads) if(nThreads > 1)
+#endif
+        for (iScan = 0; iScan < nScans; iScan++) {
+            if (scans[iScan] != NULL) {
+                collectErrMessages(&scanData[iScan].messages);
+                scanResult[iScan] = addScanToPointsArray(&scanData[iScan], iScan, nScans,
+                    &iRowSlot[iScan * nLayers], &nRowsSlot[iScan * nLayers], &nRowsWritten[iScan * nLayers], alldata);
+                collectErrMessages(NULL);
+            }
+        } // endfor (iScan = 0; iScan < nScans; iScan++)
+
+        // the messages and images of the scans are printed in scan order
+        for (iScan = 0; iScan < nScans; iScan++) {
+            printErrMessages(&scanData[iScan].messages);
+            if (scans[iScan] != NULL && scanResult[iScan] == 0) {
+                printScanImages(scans[iScan], scanUse[iScan], alldata);
+            }
+        }
+
+        for (iScan = 0; iScan < nScans; iScan++) {
+            if (scanResult[iScan] != 0) {
+                goto done;
+            }
+        }
+
+        // ------------------------------------------------------------- //
+        //  move the slots of each layer together, such that each layer  //
+        //  is a contiguous block of points ordered by scan              //
+        // ------------------------------------------------------------- //
+
+        for (iLayer = 0; iLayer < nLayers; iLayer++) {
+
+            for (iScan = 0; iScan < nScans; iScan++) {
+
+                int iSlot = iScan * nLayers + iLayer;
+                int iRowPoints = alldata->points.indexFrom[iLayer] + alldata->points.nPointsWritten[iLayer];
+
+                if (iRowPoints != iRowSlot[iSlot] && nRowsWritten[iSlot] > 0) {
+                    movePointsRows(&(alldata->points), iRowPoints, iRowSlot[iSlot], nRowsWritten[iSlot]);
+                }
+
+                alldata->points.nPointsWritten[iLayer] += nRowsWritten[iSlot];
+            }
+
+            // rows left behind by moving the slots are reset to their initial value
+            int iRowPoints = alldata->points.indexFrom[iLayer] + alldata->points.nPointsWritten[iLayer];
+            resetPointsRows(&(alldata->points), iRowPoints, alldata->points.indexTo[iLayer] - iRowPoints);
+        }
+
+    done:
+        if (scans != NULL) {
+            for (iScan = 0; iScan < nScans; iScan++) {
+                RAVE_OBJECT_RELEASE(scans[iScan]);
+            }
+        }
+        if (scanData != NULL) {
+            for (iScan = 0; iScan < nScans; iScan++) {
+                free((void*) scanData[iScan].messages.text);
+            }
+        }
+        free((void*) scans);
+        free((void*) scanData);
+        free((void*) scanResult);
+        free((void*) iRowSlot);
+        free((void*) nRowsSlot);
+        free((void*) nRowsWritten);
+
+} // constructPointsArray
+
+
+
+static int detNumberOfGates(PolarScan_t* scan, int* nGates, vol2bird_t* alldata) {
+
+    // Add to nGates[iLayer] the number of gates of 'scan' that are
+    // within the limits set by (rangeMin,rangeMax) as well as by
+    // (iLayer*layerThickness,(iLayer+1)*layerThickness), for all
+    // layers in a single pass over the range bins.
+
+    int iRang;
+    int iLayer;
+    struct scanData geometry;
+
+    getScanGeometry(scan, &geometry);
+
+    int nRang = (int) geometry.nRang;
+    int nAzim = (int) geometry.nAzim;
+
+    int* iLayerFirst = malloc(sizeof(int) * nRang);
+    int* iLayerLast = malloc(sizeof(int) * nRang);
+
+    if (iLayerFirst == NULL || iLayerLast == NULL) {
+        vol2bird_err_printf("Error pre-allocating range bin layer table.\n");
+        free((void*) iLayerFirst);
+        free((void*) iLayerLast);
+        return -1;
+    }
+
+    mapRangeBinsToLayers(&geometry, iLayerFirst, iLayerLast, alldata);
+
+    for (iRang = 0; iRang < nRang; iRang++) {
+        // iLayerFirst is -1 when the range bin is not in any layer
+        for (iLayer = iLayerFirst[iRang]; iLayer >= 0 && iLayer <= iLayerLast[iRang]; iLayer++) {
+            nGates[iLayer] += nAzim;
+        }
+    }
+
+    free((void*) iLayerFirst);
+    free((void*) iLayerLast);
+
+    return 0;
+
+} // detNumberOfGates()
+
+
+
+
+
+static int detSvdfitArraySize(PolarVolume_t* volume, vol2birdScanUse_t* scanUse, vol2bird_t* alldata) {
+    
+    int iScan;
+    int nScans = PolarVolume_getNumberOfScans(volume);
+
+    int iLayer;
+    int nRowsPoints_local = 0;
+    
+    int* nGates = malloc(sizeof(int) * alldata->options.nLayers);
+    int* nGatesAcc = malloc(sizeof(int) * alldata->options.nLayers);
+    
+    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+        nGates[iLayer] = 0;
+        nGatesAcc[iLayer] = 0;
+    }
+
+    for (iScan = 0; iScan < nScans; iScan++) {
+        if (scanUse[iScan].useScan == 1)
+        {
+            PolarScan_t* scan = PolarVolume_getScan(volume, iScan);
+
+            int result = detNumberOfGates(scan, nGates, alldata);
+
+            RAVE_OBJECT_RELEASE(scan);
+
+            if (result < 0) {
+                free((void*) nGates);
+                free((void*) nGatesAcc);
+                return -1;
+            }
+        }
+    }
 
     for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
         if (iLayer == 0) {
@@ -1274,7 +1680,7 @@ static void exportBirdProfileAsJSON(vol2bird_t *alldata) {
 
 
 
-static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quantityThreshold,
+static int findWeatherCells(struct scanData* scanData, const vol2birdScanView_t* quantityView, float quantityThreshold,
         int selectAboveThreshold, int iCellStart, int initialize, vol2bird_t* alldata) {
 
     //  ----------------------------------------------------------------------------- //
@@ -1287,12 +1693,11 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
 
     int iCellIdentifier;
     int nCells;
-    int iRang,iRangLocal;
+    int iRang;
     int nRang;
     int iAzim, iAzimLocal;
     int nAzim;
     int iNeighborhood;
-    int nNeighborhood;
     int count;
     int cellImageInitialValue;
 
@@ -1305,93 +1710,59 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
 
     double quantityMissing;
     double quantityUndetect;
-    int quantitynAzim;
-    int quantitynRang;
     double quantityValueOffset;
     double quantityValueScale;
-    double quantityValueGlobal, quantityValueLocal;
-    double cellValueGlobal, cellValueLocal, cellValueOther;
-
+    double quantityValueGlobal;
 
     float quantityRangeScale;
 
-
-    // These next two local variables 'nAzimNeighborhood' and 
-    // 'nRangNeighborhood' shadow two static global variables of the 
-    // same name, but that is in fact what you want. This is because the
-    // value of 'nAzimNeighborHood' (function scope) is not equal to 
-    // 'nAzimNeighborHood' (file scope) and because 'nRangNeighborHood' 
-    // (function scope) is not equal to 'nRangNeighborHood' (file 
-    // scope). The variable names are the same though, because they play
-    // the same role in 'findNearbyGateIndex()'.
-    int nAzimNeighborhood_local;
-    int nRangNeighborhood_local;
-    
-    int nHalfNeighborhood;
-
-    int cellIdentifierGlobal;
-    int cellIdentifierGlobalOther;
-    int iGlobalInner;
-
-
-    #ifdef FPRINTFON
-    int dbg = 0;
-    #endif
-
-    if (scan==NULL) {
-        vol2bird_err_printf("Input scan is NULL.\n");
-        return -1;
-    }
-    
-    PolarScanParam_t *scanParam = PolarScan_getParameter(scan, quantity);
-    PolarScanParam_t *cellParam = PolarScan_getParameter(scan, CELLNAME);
-
-    if (scanParam == NULL || cellParam == NULL) {
-        RAVE_OBJECT_RELEASE(scanParam);
-        RAVE_OBJECT_RELEASE(cellParam);
-        vol2bird_err_printf("%s and/or CELL quantities not found in polar scan\n", quantity);
+    int nCellsLabeled = 0;
+    int nCellSets;
+    int nCellSetsMax;
+    int iCell;
+    int iCellGlobal;
+    int iCellLocal;
+    int nLabels = 0;
+
+    double* quantityData = NULL;
+    int* cellLabels = NULL;
+    int* cellOfGate = NULL;
+    int* cellParent = NULL;
+    int* cellSize = NULL;
+    int* cellName = NULL;
+
+    // offsets (azimuth, range) of the gates that precede a gate in the
+    // scanning order within its 3x3 neighborhood
+    const int neighborAzim[4] = {-1, -1, -1, 0};
+    const int neighborRang[4] = {-1, 0, 1, -1};
+
+    if (quantityView->data == NULL || scanData->cell.data == NULL) {
+        vol2bird_err_printf("quantity and/or CELL data not found in polar scan\n");
         return -1;
     }
 
     // get direct pointer to the data block
-    int* cellParamData = (int*) PolarScanParam_getData(cellParam);
+    int* cellParamData = (int*) scanData->cell.data;
     
-    quantityMissing = PolarScanParam_getNodata(scanParam);
-    quantityUndetect = PolarScanParam_getUndetect(scanParam);
-    quantitynAzim = PolarScan_getNrays(scan);
-    quantitynRang = PolarScan_getNbins(scan);
-    quantityValueOffset = PolarScanParam_getOffset(scanParam);
-    quantityValueScale = PolarScanParam_getGain(scanParam);
-    quantityRangeScale = PolarScan_getRscale(scan);
+    quantityMissing = quantityView->nodata;
+    quantityUndetect = quantityView->undetect;
+    quantityValueOffset = quantityView->offset;
+    quantityValueScale = quantityView->gain;
+    quantityRangeScale = scanData->rangeScale;
 
-    nAzim = quantitynAzim;
-    nRang = quantitynRang;
+    nAzim = scanData->nAzim;
+    nRang = scanData->nRang;
 
     nGlobal = nAzim * nRang;
-    
-    // We use a neighborhood of 3x3, because in this function we are
-    // interested in a cell's direct neighbors. See also comment at
-    // variable definitions of 'nAzimNeighborhood' and 'nRangNeighborhood'
-    // above. 
-    nAzimNeighborhood_local = 3;
-    nRangNeighborhood_local = 3;
-    
-    nNeighborhood = nAzimNeighborhood_local * nRangNeighborhood_local;
-    nHalfNeighborhood = (nNeighborhood - 1)/2;
-
 
-    if (scanParam != NULL) {
-        quantityThres = (float) ((quantityThreshold - quantityValueOffset) / quantityValueScale);
-    }
+    quantityThres = (float) ((quantityThreshold - quantityValueOffset) / quantityValueScale);
 
     cellImageInitialValue = CELLINIT;
-	if(initialize){
-		for (int iAzim = 0; iAzim < nAzim; iAzim++) {
-			for (int iRang = 0; iRang < nRang; iRang++) {
-				PolarScanParam_setValue(cellParam, iRang, iAzim, cellImageInitialValue);
-			}
-		}
-	}
+    if (initialize) {
+        for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
+            cellParamData[iGlobal] = cellImageInitialValue;
+        }
+    }
 
     // If threshold value is equal to missing value, produce a warning
     if (quantityThres == quantityMissing) {
@@ -1400,13 +1771,82 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
 
     // ----------------------------------------------------------------------- //
     // Labeling of groups of connected pixels using horizontal, vertical, and  //
-    // diagonal connections. The algorithm is described in 'Digital Image      //
-    // Processing' by Gonzales and Woods published by Addison-Wesley.          //
+    // diagonal connections. Gates are labeled in a single pass over the scan, //
+    // labels that turn out to be connected are merged using a disjoint-set    //
+    // forest (union-find), after which a second pass writes the final label   //
+    // of each gate into the cell image.                                       //
+    //                                                                         //
+    // Each set of connected labels carries the identifier that the cell has   //
+    // in the image. When two sets merge, the identifier of the set of the     //
+    // neighboring gate is kept, as is the case when relabeling the image.     //
     // ----------------------------------------------------------------------- //
 
+    quantityData = malloc(sizeof(double) * nGlobal);
+    cellOfGate = malloc(sizeof(int) * nGlobal);
+
+    if (quantityData == NULL || cellOfGate == NULL) {
+        vol2bird_err_printf("Error pre-allocating arrays in findWeatherCells\n");
+        nCells = -1;
+        goto done;
+    }
+
+    scanViewGetRawValues(quantityView, quantityData);
+
+    // gates that are part of a cell before this call (when not initializing)
+    // start out in a set per identifier
+    if (!initialize) {
+        cellLabels = malloc(sizeof(int) * nGlobal);
+        if (cellLabels == NULL) {
+            vol2bird_err_printf("Error pre-allocating arrays in findWeatherCells\n");
+            nCells = -1;
+            goto done;
+        }
+        for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
+            if (cellParamData[iGlobal] != cellImageInitialValue) {
+                cellLabels[nLabels] = cellParamData[iGlobal];
+                nLabels++;
+            }
+        }
+        qsort(cellLabels, nLabels, sizeof(int), compareInt);
+        nCellsLabeled = 0;
+        for (iCell = 0; iCell < nLabels; iCell++) {
+            if (iCell == 0 || cellLabels[iCell] != cellLabels[iCell - 1]) {
+                cellLabels[nCellsLabeled] = cellLabels[iCell];
+                nCellsLabeled++;
+            }
+        }
+    }
+
+    // a gate starts at most one new set
+    nCellSetsMax = nCellsLabeled + nGlobal;
+    cellParent = malloc(sizeof(int) * nCellSetsMax);
+    cellSize = malloc(sizeof(int) * nCellSetsMax);
+    cellName = malloc(sizeof(int) * nCellSetsMax);
+
+    if (cellParent == NULL || cellSize == NULL || cellName == NULL) {
+        vol2bird_err_printf("Error pre-allocating arrays in findWeatherCells\n");
+        nCells = -1;
+        goto done;
+    }
+
+    for (iCell = 0; iCell < nCellsLabeled; iCell++) {
+        cellParent[iCell] = iCell;
+        cellSize[iCell] = 1;
+        cellName[iCell] = cellLabels[iCell];
+    }
+
+    for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
+        cellOfGate[iGlobal] = -1;
+        if (cellParamData[iGlobal] != cellImageInitialValue) {
+            int* label = bsearch(&cellParamData[iGlobal], cellLabels, nCellsLabeled, sizeof(int), compareInt);
+            cellOfGate[iGlobal] = (int) (label - cellLabels);
+        }
+    }
+
     // Typically the first cell will have iCellIdentifier = 2, because we reserve 1 for fringe
     // to be added by function fringeCells
     iCellIdentifier = iCellStart;
+    nCellSets = nCellsLabeled;
 
     for (iAzim = 0; iAzim < nAzim; iAzim++) {
         for (iRang = 0; iRang < nRang; iRang++) {
@@ -1416,35 +1856,10 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
             if ((float)(iRang + 1) * quantityRangeScale > alldata->misc.rCellMax) {
                 continue;
             }
-            else {
-                #ifdef FPRINTFON
-                vol2bird_err_printf("iGlobal = %d\niRang + 1 = %d\n"
-                "quantityRangeScale = %f\n"
-                "rCellMax = %f\n"
-                "(iRang + 1) * quantityRangeScale = %f\n"
-                "((iRang + 1) * quantityRangeScale > rCellMax) = %d\n"
-                "dbg=%d\n",iGlobal,iRang + 1,quantityRangeScale,alldata->misc.rCellMax,
-                (iRang + 1) * quantityRangeScale,
-                ((iRang + 1) * quantityRangeScale > alldata->misc.rCellMax),dbg);
-                
-                dbg++;
-                #endif
-            }
-
-            #ifdef FPRINTFON
-            vol2bird_err_printf("iGlobal = %d\n",iGlobal);
-            #endif
-            
-            PolarScanParam_getValue(scanParam, iRang, iAzim, &quantityValueGlobal);
-            PolarScanParam_getValue(cellParam, iRang, iAzim, &cellValueGlobal);
 
+            quantityValueGlobal = quantityData[iGlobal];
 
             if (quantityValueGlobal == quantityMissing || quantityValueGlobal == quantityUndetect) {
-
-                #ifdef FPRINTFON
-                vol2bird_err_printf("quantityImage[%d] == quantityMissing\n",iGlobal);
-                #endif
-
                 continue;
             }
             
@@ -1455,78 +1870,65 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
                 continue;
             }
 
-            // count number of direct neighbors above threshold
+            // count number of direct neighbors above threshold, the azimuth
+            // dimension is wrapped (iAzim = 0 is adjacent to iAzim = nAzim-1)
             count = 0;
-            for (iNeighborhood = 0; iNeighborhood < nNeighborhood; iNeighborhood++) {
-
-                iLocal = findNearbyGateIndex(nAzim,nRang,iGlobal,nAzimNeighborhood_local,nRangNeighborhood_local,iNeighborhood,&iAzimLocal,&iRangLocal);
-
-                if (iLocal < 0) {
-                    // iLocal below zero are error codes
-                    continue;
-                }
-                
-                PolarScanParam_getValue(scanParam, iRangLocal, iAzimLocal, &quantityValueLocal);
-
-                if (quantityValueLocal > quantityThres) {
-                    count++;
+            for (iAzimLocal = iAzim - 1; iAzimLocal <= iAzim + 1; iAzimLocal++) {
+                for (iLocal = iRang - 1; iLocal <= iRang + 1; iLocal++) {
+                    if (iLocal < 0 || iLocal > nRang - 1) {
+                        continue;
+                    }
+                    if (quantityData[iLocal + ((iAzimLocal + nAzim) % nAzim) * nRang] > quantityThres) {
+                        count++;
+                    }
                 }
-
             }
             // when not enough qualified neighbors, continue
             if (count - 1 < alldata->constants.nNeighborsMin) {
                 continue;
             }
 
-            #ifdef FPRINTFON
-            vol2bird_err_printf("iGlobal = %d, count = %d\n",iGlobal,count);
-            #endif
-
-
             // Looking for horizontal, vertical, forward diagonal, and backward diagonal connections.
-            for (iNeighborhood = 0; iNeighborhood < nHalfNeighborhood; iNeighborhood++) {
+            iCellGlobal = cellOfGate[iGlobal];
 
-                iLocal = findNearbyGateIndex(nAzim,nRang,iGlobal,nAzimNeighborhood_local,nRangNeighborhood_local,iNeighborhood,&iAzimLocal,&iRangLocal);
-//                fprintf(stderr, "iLocal %i - args %i %i %i %i %i %i %i %i\n",iLocal,nAzim,nRang,iGlobal,nAzimNeighborhood_local,nRangNeighborhood_local,iNeighborhood,iAzimLocal,iRangLocal);
-                if (iLocal < 0) {
-                    // iLocal less than zero are error codes
+            for (iNeighborhood = 0; iNeighborhood < 4; iNeighborhood++) {
+
+                iLocal = iRang + neighborRang[iNeighborhood];
+                if (iLocal < 0 || iLocal > nRang - 1) {
                     continue;
                 }
-                
-                PolarScanParam_getValue(cellParam, iRangLocal, iAzimLocal, &cellValueLocal);
+                iLocal += ((iAzim + neighborAzim[iNeighborhood] + nAzim) % nAzim) * nRang;
+
+                iCellLocal = cellOfGate[iLocal];
 
                 // no connection found, go to next pixel within neighborhood
-                if ((int) cellValueLocal == cellImageInitialValue) {
+                if (iCellLocal < 0) {
                     continue;
                 }
 
-                // if pixel still unassigned, assign same iCellIdentifier as connection
-                if ((int) cellValueGlobal == cellImageInitialValue) {
-                    PolarScanParam_setValue(cellParam, iRang, iAzim, cellValueLocal);
-                    cellValueGlobal = cellValueLocal;
+                // if pixel still unassigned, assign same cell as connection
+                if (iCellGlobal < 0) {
+                    iCellGlobal = iCellLocal;
+                    cellOfGate[iGlobal] = iCellGlobal;
                 }
                 else {
-                    // if connection found but pixel is already assigned a different iCellIdentifier:
-                    if (cellValueGlobal != cellValueLocal) {
-                        // merging cells detected: replace all other occurences by value of connection:
-                        for (iGlobalOther = 0; iGlobalOther < nGlobal; iGlobalOther++) {
-                            if (cellParamData[iGlobalOther] == cellValueGlobal) {
-                                cellParamData[iGlobalOther] = cellValueLocal;
-                            }
-                            // note: not all iCellIdentifier need to be used eventually
-                        }
-                    }
+                    // merging cells detected, the cell keeps the identifier of the connection
+                    mergeCells(iCellGlobal, iCellLocal, cellParent, cellSize, cellName);
                 }
             }
 
             // When no connections are found, give a new number.
-            if ((int) cellValueGlobal == cellImageInitialValue) {
+            if (iCellGlobal < 0) {
 
                 #ifdef FPRINTFON
                 vol2bird_err_printf("new cell found...assigning number %d\n",iCellIdentifier);
                 #endif
-                
-                PolarScanParam_setValue(cellParam, iRang, iAzim, iCellIdentifier);
+
+                cellParent[nCellSets] = nCellSets;
+                cellSize[nCellSets] = 1;
+                cellName[nCellSets] = iCellIdentifier;
+                cellOfGate[iGlobal] = nCellSets;
+                nCellSets++;
                 iCellIdentifier++;
             }
 
@@ -1536,47 +1938,85 @@ static int findWeatherCells(PolarScan_t *scan, const char* quantity, float quant
 
     // check whether a cell crosses the border of the array (remember that iAzim=0 is
     // adjacent to iAzim=nAzim-1):
-    iAzim = 0;
-
     for (iRang = 0; iRang < nRang; iRang++) {
 
-        iGlobal = iRang + iAzim * nRang;
-        // index 1 in a 3x3 child array refers to the cell that is a direct neighbor of
-        // iGlobal, but on the other side of the array (because the polar plot is wrapped
-        // in the azimuth dimension):
-        iGlobalOther = findNearbyGateIndex(nAzim,nRang,iGlobal,3,3,1,&iAzimLocal,&iRangLocal);
-        PolarScanParam_getValue(cellParam, iRangLocal, iAzimLocal, &cellValueOther);
-
-        #ifdef FPRINTFON
-        vol2bird_err_printf("iGlobal = %d, iGlobalOther = %d\n",iGlobal,iGlobalOther);
-        #endif
+        iGlobal = iRang;
+        iGlobalOther = iRang + (nAzim - 1) * nRang;
 
-        cellIdentifierGlobal = cellValueGlobal;
-        cellIdentifierGlobalOther = cellValueOther;
-        if (cellIdentifierGlobal != cellImageInitialValue && cellIdentifierGlobalOther != cellImageInitialValue ) {
-            // adjacent gates, both part of a cell -> assign them the same identifier, i.e. assign
-            // all elements of cellImage that are equal to cellImage[iGlobalOther] the value of
-            // cellImage[iGlobal]
+        if (cellOfGate[iGlobal] >= 0 && cellOfGate[iGlobalOther] >= 0) {
+            // adjacent gates, both part of a cell -> assign them the same identifier,
+            // i.e. the identifier of the cell at iAzim = 0
+            mergeCells(cellOfGate[iGlobalOther], cellOfGate[iGlobal], cellParent, cellSize, cellName);
+        }
+    }
 
-            for (iGlobalInner = 0; iGlobalInner < nGlobal; iGlobalInner++) {
-                if (cellParamData[iGlobalInner] == cellIdentifierGlobalOther) {
-                    cellParamData[iGlobalInner] = cellIdentifierGlobal;
-                }
-            }
+    // second pass: write the identifier of each gate's cell into the image
+    for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
+        if (cellOfGate[iGlobal] >= 0) {
+            cellParamData[iGlobal] = cellName[findCellRoot(cellOfGate[iGlobal], cellParent)];
         }
     }
 
     // Returning number of detected cells (including fringe/clutter)
     nCells = iCellIdentifier;
 
-    RAVE_OBJECT_RELEASE(scanParam);
-    RAVE_OBJECT_RELEASE(cellParam);
+done:
+    free((void*) quantityData);
+    free((void*) cellLabels);
+    free((void*) cellOfGate);
+    free((void*) cellParent);
+    free((void*) cellSize);
+    free((void*) cellName);
 
     return nCells;
 } // findWeatherCells
 
 
 
+static int findCellRoot(int iCell, int* cellParent) {
+
+    // find the root of the set that contains iCell, halving the
+    // path to the root on the way
+
+    while (cellParent[iCell] != iCell) {
+        cellParent[iCell] = cellParent[cellParent[iCell]];
+        iCell = cellParent[iCell];
+    }
+
+    return iCell;
+
+} // findCellRoot
+
+
+
+static void mergeCells(int iCellFrom, int iCellTo, int* cellParent, int* cellSize, int* cellName) {
+
+    // merge the set that contains iCellFrom with the set that contains
+    // iCellTo, the merged set keeps the identifier of iCellTo's set
+
+    int iRootFrom = findCellRoot(iCellFrom, cellParent);
+    int iRootTo = findCellRoot(iCellTo, cellParent);
+    int name = cellName[iRootTo];
+
+    if (iRootFrom == iRootTo) {
+        return;
+    }
+
+    // attach the smaller tree to the larger one
+    if (cellSize[iRootFrom] > cellSize[iRootTo]) {
+        int iRootTmp = iRootFrom;
+        iRootFrom = iRootTo;
+        iRootTo = iRootTmp;
+    }
+
+    cellParent[iRootFrom] = iRootTo;
+    cellSize[iRootTo] += cellSize[iRootFrom];
+    cellName[iRootTo] = name;
+
+} // mergeCells
+
+
+
 static int findNearbyGateIndex(const int nAzimParent, const int nRangParent, const int iParent,
                         const int nAzimChild,  const int nRangChild,  const int iChild, int *iAzimReturn, int *iRangReturn) {
 
@@ -1643,124 +2083,245 @@ static int findNearbyGateIndex(const int nAzimParent, const int nRangParent, con
 } // findNearbyGateIndex
 
 
-static void fringeCells(PolarScan_t* scan, vol2bird_t* alldata) {
+
+static void freeScratch(vol2birdScratch_t* scratch) {
+
+    free((void*) scratch->pointsSelection);
+    free((void*) scratch->yNyquist);
+    free((void*) scratch->yDealias);
+    free((void*) scratch->yObs);
+    free((void*) scratch->yFitted);
+    free((void*) scratch->includedIndex);
+    free((void*) scratch->gates1.index);
+    free((void*) scratch->gates3.index);
+    free((void*) scratch->svdfitWork);
+    dealias_work_free(scratch->dealiasWork);
+
+    scratch->nPointsMax = 0;
+    scratch->pointsSelection = NULL;
+    scratch->yNyquist = NULL;
+    scratch->yDealias = NULL;
+    scratch->yObs = NULL;
+    scratch->yFitted = NULL;
+    scratch->includedIndex = NULL;
+    scratch->gates1.index = NULL;
+    scratch->gates3.index = NULL;
+    scratch->svdfitWork = NULL;
+    scratch->dealiasWork = NULL;
+
+} // freeScratch
+
+
+static void fringeCells(struct scanData* scanData, vol2bird_t* alldata) {
 
     // -------------------------------------------------------------------------- //
     // This function enlarges cells in cellImage by an additional fringe.         //
-    // First a block around each pixel is searched for pixels within a distance   //
-    // equal to 'fringeDist'.                                                     //
+    // All pixels that are not part of a cell and that are within a distance      //
+    // equal to 'fringeDist' of a pixel on the edge of a cell become fringe.      //
+    //                                                                            //
+    // The distance between two pixels only depends on their range bins and on    //
+    // their difference in azimuth. For each pair of range bins the fringe        //
+    // therefore extends a fixed number of azimuth bins to both sides of an edge  //
+    // pixel. Using cumulative counts of the edge pixels along the azimuth        //
+    // dimension, whether a pixel is within reach of an edge pixel is known in    //
+    // constant time for each range bin within 'fringeDist'.                      //
     // -------------------------------------------------------------------------- //
 
-    if(!PolarScan_hasParameter(scan, CELLNAME)){
+    if (scanData->cell.data == NULL) {
         vol2bird_err_printf("no CELL quantity in polar scan, aborting fringeCells()\n");
         return;
     }
 
-    int nRang = (int) PolarScan_getNbins(scan);
-    int nAzim = (int) PolarScan_getNrays(scan);
+    int nRang = (int) scanData->nRang;
+    int nAzim = (int) scanData->nAzim;
     float aScale = 360.0f/ nAzim;
-    float rScale = (float) PolarScan_getRscale(scan);
-    PolarScanParam_t *cellParam = PolarScan_getParameter(scan,CELLNAME);
-    int *cellImage = (int *) PolarScanParam_getData(cellParam);
+    float rScale = (float) scanData->rangeScale;
+    float fringeDist = alldata->options.fringeDist;
+    int *cellImage = (int *) scanData->cell.data;
 
     int iRang;
     int iAzim;
-    int iNeighborhood;
-    int nNeighborhood;
     int iRangLocal;
     int iAzimLocal;
-    int iLocal;
+    int iRangEdge;
     int rBlock;
     int aBlock;
+    int nRangBlock;
     int isEdge;
     int iGlobal;
-    float theDist;
-    int nAzimChild;
-    int nRangChild;
+    int nEdges;
+    int halfWidth;
+    int halfWidthMin;
+    int halfWidthMax;
+    int iAzimFrom;
+    int iAzimTo;
 
     float actualRange;
     float circumferenceAtActualRange;
 
+    int* edgeCount = NULL;
+    int* azimHalfWidth = NULL;
 
-    rBlock = ROUND(alldata->constants.fringeDist / rScale);
-    for (iAzim = 0; iAzim < nAzim; iAzim++) {
-        for (iRang = 0; iRang < nRang; iRang++) {
+    if (fringeDist <= 0) {
+        goto done;
+    }
 
-            iGlobal = iRang + iAzim * nRang;
+    rBlock = ROUND(fringeDist / rScale);
+    nRangBlock = 2 * rBlock + 1;
 
-            if (cellImage[iGlobal] <= 1) {
-                continue; // with the next iGlobal; already fringe or not in cellImage
-            }
+    // edgeCount[iRang * (nAzim + 1) + iAzim] is the number of pixels on the
+    // edge of a cell at range bin iRang with an azimuth bin below iAzim
+    edgeCount = malloc(sizeof(int) * nRang * (nAzim + 1));
+    // azimHalfWidth[iRang * nRangBlock + rBlock + iRangLocal - iRang] is the number
+    // of azimuth bins the fringe extends from an edge pixel at range bin iRang to
+    // both sides at range bin iRangLocal, or -1 when out of reach
+    azimHalfWidth = malloc(sizeof(int) * nRang * nRangBlock);
 
-            // determine whether current pixel is a pixel on the edge of a cell
-            isEdge = FALSE;
-            for (iNeighborhood = 0; iNeighborhood < 9 && isEdge == FALSE; iNeighborhood++) {
+    if (edgeCount == NULL || azimHalfWidth == NULL) {
+        vol2bird_err_printf("Error pre-allocating arrays in fringeCells\n");
+        goto done;
+    }
 
-                iLocal = findNearbyGateIndex(nAzim,nRang,iGlobal,3,3,iNeighborhood,&iAzimLocal,&iRangLocal);
+    // ------------------------------------------------------------- //
+    //            find the pixels on the edge of a cell              //
+    // ------------------------------------------------------------- //
 
-                if (iLocal < 0) {
-                    // iLocal less than zero are error codes
-                    continue; // with the next iGlobal
-                }
+    for (iRang = 0; iRang < nRang; iRang++) {
 
-                if (cellImage[iLocal] < 1) { //FIXME: Strictly this should be <=1, but then much slower
-                    isEdge = TRUE;           //Now only pixels without any bordering fringe are 'fringed', giving very similar result (but improvement welcome)
-                }
+        int* edgeCountRang = &edgeCount[iRang * (nAzim + 1)];
 
-            }
-            
-            if (isEdge == FALSE) {
-                continue; // with the next iGlobal
-            }
+        edgeCountRang[0] = 0;
 
-            actualRange = (iRang+0.5) * rScale;
-            circumferenceAtActualRange = 2 * PI * actualRange;
-            aBlock = (alldata->constants.fringeDist / circumferenceAtActualRange) * nAzim;
+        for (iAzim = 0; iAzim < nAzim; iAzim++) {
 
+            isEdge = FALSE;
 
-            #ifdef FPRINTFON
-            vol2bird_err_printf("actualRange = %f\n",actualRange);
-            vol2bird_err_printf("circumferenceAtActualRange = %f\n",circumferenceAtActualRange);
-            vol2bird_err_printf("fringeDist / circumferenceAtActualRange = %f\n",alldata->constants.fringeDist / circumferenceAtActualRange);
-            vol2bird_err_printf("aBlock = %d\n", aBlock);
-            vol2bird_err_printf("rBlock = %d\n", rBlock);
-            #endif
+            // a pixel of a cell is on the edge when one of its direct
+            // neighbors is not part of a cell (or already fringe)
+            if (cellImage[iRang + iAzim * nRang] > 1) {
+                for (iAzimLocal = iAzim - 1; iAzimLocal <= iAzim + 1 && isEdge == FALSE; iAzimLocal++) {
+                    for (iRangLocal = iRang - 1; iRangLocal <= iRang + 1; iRangLocal++) {
+                        if (iRangLocal < 0 || iRangLocal > nRang - 1) {
+                            continue;
+                        }
+                        // the azimuth dimension is wrapped (polar plot)
+                        if (cellImage[iRangLocal + ((iAzimLocal + nAzim) % nAzim) * nRang] <= 1) {
+                            isEdge = TRUE;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            edgeCountRang[iAzim + 1] = edgeCountRang[iAzim] + isEdge;
+        }
+    }
+
+    // ------------------------------------------------------------- //
+    //   determine the reach of the fringe for each pair of ranges   //
+    // ------------------------------------------------------------- //
+
+    for (iRang = 0; iRang < nRang; iRang++) {
+
+        actualRange = (iRang+0.5) * rScale;
+        circumferenceAtActualRange = 2 * PI * actualRange;
+        aBlock = (fringeDist / circumferenceAtActualRange) * nAzim;
+
+        // the distance increases with the difference in azimuth up to half a circle
+        if (aBlock > nAzim / 2) {
+            aBlock = nAzim / 2;
+        }
+
+        for (iRangLocal = iRang - rBlock; iRangLocal <= iRang + rBlock; iRangLocal++) {
+
+            halfWidth = -1;
+
+            if (iRangLocal >= 0 && iRangLocal < nRang &&
+                calcDist(iRang, 0, iRangLocal, 0, rScale, aScale) <= fringeDist) {
+                // bisection for the largest azimuth difference within reach
+                halfWidthMin = 0;
+                halfWidthMax = aBlock;
+                while (halfWidthMin < halfWidthMax) {
+                    halfWidth = (halfWidthMin + halfWidthMax + 1) / 2;
+                    if (calcDist(iRang, 0, iRangLocal, halfWidth, rScale, aScale) <= fringeDist) {
+                        halfWidthMin = halfWidth;
+                    }
+                    else {
+                        halfWidthMax = halfWidth - 1;
+                    }
+                }
+                halfWidth = halfWidthMin;
+            }
+
+            azimHalfWidth[iRang * nRangBlock + rBlock + iRangLocal - iRang] = halfWidth;
+        }
+    }
+
+    // ------------------------------------------------------------- //
+    //       include the pixels within reach of an edge in fringe    //
+    // ------------------------------------------------------------- //
+
+    for (iAzim = 0; iAzim < nAzim; iAzim++) {
+        for (iRang = 0; iRang < nRang; iRang++) {
 
-            nAzimChild = 2 * aBlock + 1;
-            nRangChild = 2 * rBlock + 1;
-            nNeighborhood = nAzimChild * nRangChild;
+            iGlobal = iRang + iAzim * nRang;
 
-            for (iNeighborhood = 0; iNeighborhood < nNeighborhood; iNeighborhood++) {
+            // if already in cellImage or already a fringe, do nothing
+            if (cellImage[iGlobal] >= 1) {
+                continue;
+            }
 
-                iLocal = findNearbyGateIndex(nAzim,nRang,iGlobal,nAzimChild,nRangChild,iNeighborhood,&iAzimLocal,&iRangLocal);
+            for (iRangEdge = iRang - rBlock; iRangEdge <= iRang + rBlock; iRangEdge++) {
 
-                if (iLocal < 0) {
-                    // iLocal less than zero are error codes
+                if (iRangEdge < 0 || iRangEdge > nRang - 1) {
                     continue;
                 }
 
-//                iAzimLocal = iLocal / nRang;
-//                iRangLocal = iLocal % nRang;
+                int* edgeCountRang = &edgeCount[iRangEdge * (nAzim + 1)];
+
+                halfWidth = azimHalfWidth[iRangEdge * nRangBlock + rBlock + iRang - iRangEdge];
 
-                // if not within range or already in cellImage or already a fringe, do nothing
-                theDist = calcDist(iRang, iAzim, iRangLocal, iAzimLocal, rScale, aScale);
-                if (theDist > alldata->constants.fringeDist || cellImage[iLocal] >= 1) {
-                    continue; // with the next iGlobal
+                if (halfWidth < 0 || edgeCountRang[nAzim] == 0) {
+                    continue;
                 }
-                // include pixel (iRangLocal,iAzimLocal) in fringe
-                cellImage[iLocal] = 1;
-                
-            } // (iNeighborhood = 0; iNeighborhood < nNeighborhood; iNeighborhood++)
+
+                // count the edge pixels at range bin iRangEdge within reach,
+                // wrapping around in the azimuth dimension
+                if (2 * halfWidth + 1 >= nAzim) {
+                    nEdges = edgeCountRang[nAzim];
+                }
+                else {
+                    iAzimFrom = iAzim - halfWidth;
+                    iAzimTo = iAzim + halfWidth;
+                    if (iAzimFrom < 0) {
+                        nEdges = edgeCountRang[iAzimTo + 1] + edgeCountRang[nAzim] - edgeCountRang[iAzimFrom + nAzim];
+                    }
+                    else if (iAzimTo > nAzim - 1) {
+                        nEdges = edgeCountRang[nAzim] - edgeCountRang[iAzimFrom] + edgeCountRang[iAzimTo - nAzim + 1];
+                    }
+                    else {
+                        nEdges = edgeCountRang[iAzimTo + 1] - edgeCountRang[iAzimFrom];
+                    }
+                }
+
+                if (nEdges > 0) {
+                    // include pixel (iRang,iAzim) in fringe
+                    cellImage[iGlobal] = 1;
+                    break;
+                }
+            } // (iRangEdge = iRang - rBlock; iRangEdge <= iRang + rBlock; iRangEdge++)
         } // (iRang = 0; iRang < nRang; iRang++)
     } // (iAzim = 0; iAzim < nAzim; iAzim++)
 
-    RAVE_OBJECT_RELEASE(cellParam);
+done:
+    free((void*) edgeCount);
+    free((void*) azimHalfWidth);
     return;
 
 } // fringeCells
 
 
-CELLPROP* getCellProperties(PolarScan_t* scan, vol2birdScanUse_t scanUse, const int nCells, vol2bird_t* alldata){    
+CELLPROP* getCellProperties(const struct scanData* scanData, const int nCells, vol2bird_t* alldata){    
     int iCell;
     int iGlobal;
     int iRang;
@@ -1776,15 +2337,15 @@ CELLPROP* getCellProperties(PolarScan_t* scan, vol2birdScanUse_t scanUse, const
     double clutterValue = alldata->options.clutterValueMin;
     double cellValue;
     
-    PolarScanParam_t *dbzParam = PolarScan_getParameter(scan,scanUse.dbzName);
-    PolarScanParam_t *vradParam = PolarScan_getParameter(scan,scanUse.vradName);
-    PolarScanParam_t *texParam = PolarScan_getParameter(scan,scanUse.texName);
-    PolarScanParam_t *cellParam = PolarScan_getParameter(scan,scanUse.cellName);
-    PolarScanParam_t *clutParam = PolarScan_getParameter(scan,scanUse.clutName);
+    const vol2birdScanView_t* dbzView = &scanData->dbz;
+    const vol2birdScanView_t* vradView = &scanData->vrad;
+    const vol2birdScanView_t* texView = &scanData->tex;
+    const vol2birdScanView_t* cellView = &scanData->cell;
+    const vol2birdScanView_t* clutView = &scanData->clut;
 
-    nRang = PolarScan_getNbins(scan);
-    nAzim = PolarScan_getNrays(scan);
-    rScale = PolarScan_getRscale(scan);
+    nRang = scanData->nRang;
+    nAzim = scanData->nAzim;
+    rScale = scanData->rangeScale;
     aScale = (360.0/nAzim)*PI/180; // in radials
     
     // Allocating and initializing memory for cell properties.
@@ -1818,11 +2379,11 @@ CELLPROP* getCellProperties(PolarScan_t* scan, vol2birdScanUse_t scanUse, const
 
             iGlobal = iRang + iAzim * nRang;
 
-            typeDbz=PolarScanParam_getConvertedValue(dbzParam, iRang, iAzim, &dbzValue);
-            typeVrad=PolarScanParam_getConvertedValue(vradParam, iRang, iAzim, &vradValue);
-            if (clutParam != NULL) PolarScanParam_getConvertedValue(clutParam, iRang, iAzim, &clutterValue);
-            if (texParam != NULL) typeTex=PolarScanParam_getConvertedValue(texParam, iRang, iAzim, &texValue);
-            typeCell = PolarScanParam_getConvertedValue(cellParam, iRang, iAzim, &cellValue);
+            typeDbz=scanViewGetConvertedValue(dbzView, iRang, iAzim, &dbzValue);
+            typeVrad=scanViewGetConvertedValue(vradView, iRang, iAzim, &vradValue);
+            if (clutView->data != NULL) scanViewGetConvertedValue(clutView, iRang, iAzim, &clutterValue);
+            if (texView->data != NULL) typeTex=scanViewGetConvertedValue(texView, iRang, iAzim, &texValue);
+            typeCell = scanViewGetConvertedValue(cellView, iRang, iAzim, &cellValue);
 	    
             iCell = (int) cellValue;
 
@@ -1907,160 +2468,229 @@ CELLPROP* getCellProperties(PolarScan_t* scan, vol2birdScanUse_t scanUse, const
             cellProp[iCell].cv = cellProp[iCell].texAvg / cellProp[iCell].dbzAvg;
         }
     }
-    
-    RAVE_OBJECT_RELEASE(dbzParam);
-    RAVE_OBJECT_RELEASE(vradParam);
-    RAVE_OBJECT_RELEASE(texParam);
-    RAVE_OBJECT_RELEASE(cellParam);
-    RAVE_OBJECT_RELEASE(clutParam);
 
     return cellProp;
 } // getCellProperties
 
 
 
-static int getListOfSelectedGates(PolarScan_t* scan, vol2birdScanUse_t scanUse, const float altitudeMin, const float altitudeMax,
-                           float* points_local, int iRowPoints, int nColsPoints_local, vol2bird_t* alldata) {
+static void getDealiasSeed(vol2bird_t* alldata, const int iLayer, double* uvSeed) {
+
+    // ------------------------------------------------------------- //
+    // the wind from which dealias_points starts for layer iLayer:   //
+    // that of the same layer in an earlier profile of this volume,  //
+    // else that of the layer below when it lies in the same chunk   //
+    // of DEALIAS_SEED_NLAYERS layers, else that of the same layer   //
+    // in the previous volume. NAN when none of these was fitted     //
+    // ------------------------------------------------------------- //
+
+    const int iVolume = alldata->misc.iVolume;
+    const int* seedVolume = alldata->misc.dealiasSeedVolume;
+    int iLayerSeed = -1;
+
+    // the chunks are calculated in parallel, one chunk per thread, so only
+    // the rows of 'dealiasSeed' of the own chunk are read. This keeps the
+    // seeds independent of the number of threads
+    if (seedVolume[iLayer] == iVolume) {
+        iLayerSeed = iLayer;
+    } else if (iLayer % DEALIAS_SEED_NLAYERS != 0 && seedVolume[iLayer - 1] == iVolume) {
+        iLayerSeed = iLayer - 1;
+    } else if (seedVolume[iLayer] == iVolume - 1) {
+        iLayerSeed = iLayer;
+    }
+
+    if (iLayerSeed < 0) {
+        uvSeed[0] = NAN;
+        uvSeed[1] = NAN;
+    } else {
+        uvSeed[0] = alldata->misc.dealiasSeed[2 * iLayerSeed];
+        uvSeed[1] = alldata->misc.dealiasSeed[2 * iLayerSeed + 1];
+    }
+
+} // getDealiasSeed
+
+
+
+static int getListOfSelectedGates(const struct scanData* scanData, vol2birdPoints_t* points_local,
+                           const int* iRowSlot, const int* nRowsSlot, int* nRowsWritten,
+                           vol2bird_t* alldata) {
 
     // ------------------------------------------------------------------- //
     // Write combinations of an azimuth angle, an elevation angle, an      // 
     // observed vrad value, an observed dbz value, and a cell identifier   //
-    // value into an external larger list.                                 //
+    // value into an external larger list. The gates of layer iLayer are   //
+    // written to the nRowsSlot[iLayer] rows starting at iRowSlot[iLayer], //
+    // the number of rows written is returned in nRowsWritten[iLayer].     //
+    // Returns -1 when more gates were selected than fit in a slot.        //
     // ------------------------------------------------------------------- //
 
     int iAzim;
     int iRang;
+    int iLayer;
+    int iRowPoints;
     int nRang;
     int nAzim;
-    int nPointsWritten_local;
+    int result = 0;
 
-    float gateHeight;
     float gateRange;
     float gateAzim;
     float rangeScale;
     float azimuthScale;
     float elevAngle;
-    float radarHeight;
     double vradValue;
     double dbzValue;
     double cellValue;
     double clutValue = NAN;
-    double nyquist = 0;
-    
-    nPointsWritten_local = 0;
+    double nyquist = scanData->nyquist;
     
     RaveValueType vradValueType, dbzValueType;
     
-    nRang = (int) PolarScan_getNbins(scan);
-    nAzim = (int) PolarScan_getNrays(scan);
-    rangeScale = (float) PolarScan_getRscale(scan);
+    nRang = (int) scanData->nRang;
+    nAzim = (int) scanData->nAzim;
+    rangeScale = (float) scanData->rangeScale;
     azimuthScale = 360.0f/nAzim;
-    elevAngle = (float) PolarScan_getElangle(scan);
-    radarHeight = (float) PolarScan_getHeight(scan);
-    RaveAttribute_t* attr = PolarScan_getAttribute(scan, "how/NI");
-    if (attr != (RaveAttribute_t *) NULL){ 
-        RaveAttribute_getDouble(attr, &nyquist);
+    elevAngle = (float) scanData->elevAngle;
+
+    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+        nRowsWritten[iLayer] = 0;
     }
-    RAVE_OBJECT_RELEASE(attr);
-    
-    PolarScanParam_t* vradParam = PolarScan_getParameter(scan,scanUse.vradName);
-    PolarScanParam_t* dbzParam = PolarScan_getParameter(scan,scanUse.dbzName);
-    PolarScanParam_t* cellParam = PolarScan_getParameter(scan,scanUse.cellName);
-    PolarScanParam_t* clutParam = NULL;
 
-    if (alldata->options.useClutterMap){
-        clutParam = PolarScan_getParameter(scan,scanUse.clutName);
+    int* iLayerFirst = malloc(sizeof(int) * nRang);
+    int* iLayerLast = malloc(sizeof(int) * nRang);
+
+    if (iLayerFirst == NULL || iLayerLast == NULL) {
+        vol2bird_err_printf("Error pre-allocating range bin layer table.\n");
+        free((void*) iLayerFirst);
+        free((void*) iLayerLast);
+        return -1;
     }
 
-    for (iRang = 0; iRang < nRang; iRang++) {
+    mapRangeBinsToLayers(scanData, iLayerFirst, iLayerLast, alldata);
 
-        // so gateRange represents a distance along the view direction (not necessarily horizontal)
-        gateRange = ((float) iRang + 0.5f) * rangeScale;
+    const vol2birdScanView_t* vradView = &scanData->vrad;
+    const vol2birdScanView_t* dbzView = &scanData->dbz;
+    const vol2birdScanView_t* cellView = &scanData->cell;
+    const vol2birdScanView_t* clutView = &scanData->clut;
 
-        // note that "sin(elevAngle*DEG2RAD)" is equivalent to = "cos((90 - elevAngle)*DEG2RAD)":
-        gateHeight = range2height(gateRange, elevAngle) + radarHeight;
+    // the gates of all rays at the current range bin
+    double vradColumn[nAzim];
+    double dbzColumn[nAzim];
+    double clutColumn[nAzim];
+    RaveValueType vradTypes[nAzim];
+    RaveValueType dbzTypes[nAzim];
+    RaveValueType clutTypes[nAzim];
 
-        if (gateRange < alldata->options.rangeMin || gateRange > alldata->options.rangeMax) {
-            // the current gate is either 
-            // (1) too close to the radar; or
-            // (2) too far away.
-            continue;
-        }
-        if (gateHeight < altitudeMin || gateHeight > altitudeMax) {
-            // if the height of the middle of the current gate is too far away from
-            // the requested height, continue with the next gate
+    for (iRang = 0; iRang < nRang && result == 0; iRang++) {
+
+        if (iLayerFirst[iRang] < 0) {
             continue;
         }
 
-        // the gates at this range and elevation angle are within bounds,
-        // include their data in the 'points' array:
+        // so gateRange represents a distance along the view direction (not necessarily horizontal)
+        gateRange = ((float) iRang + 0.5f) * rangeScale;
 
-        for (iAzim = 0; iAzim < nAzim; iAzim++) {
+        // read the range bin once, it may be included in two layers
+        scanViewGetConvertedColumn(vradView, iRang, vradColumn, vradTypes);
+        scanViewGetConvertedColumn(dbzView, iRang, dbzColumn, dbzTypes);
+        if (alldata->options.useClutterMap){
+            scanViewGetConvertedColumn(clutView, iRang, clutColumn, clutTypes);
+        }
 
-            gateAzim = ((float) iAzim + 0.5f) * azimuthScale;
-            vradValueType = PolarScanParam_getConvertedValue(vradParam, iRang, iAzim, &vradValue);
-            dbzValueType = PolarScanParam_getConvertedValue(dbzParam, iRang, iAzim, &dbzValue);
-            PolarScanParam_getValue(cellParam, iRang, iAzim, &cellValue);
-            if (alldata->options.useClutterMap){
-                PolarScanParam_getConvertedValue(clutParam, iRang, iAzim, &clutValue);
-            }
+        // a range bin on the boundary between two layers is included in both
+        for (iLayer = iLayerFirst[iRang]; iLayer >= 0 && iLayer <= iLayerLast[iRang]; iLayer++) {
 
-            // in the points array, store missing reflectivity values as the lowest possible reflectivity
-            // this is to treat undetects as absence of scatterers
-            if (dbzValueType != RaveValueType_DATA){
-                dbzValue = NAN;
+            // the gates at this range and elevation angle are within bounds,
+            // include their data in the 'points' array, if there is room:
+            if (nRowsWritten[iLayer] + nAzim > nRowsSlot[iLayer]) {
+                result = -1;
+                break;
             }
 
-            // in the points array, store missing vrad values as NAN
-            // this is necessary because different scans may have different missing values
-            if (vradValueType != RaveValueType_DATA){
-                vradValue = NAN;
-            }
+            iRowPoints = iRowSlot[iLayer] + nRowsWritten[iLayer];
+
+            for (iAzim = 0; iAzim < nAzim; iAzim++) {
+
+                gateAzim = ((float) iAzim + 0.5f) * azimuthScale;
+                vradValueType = vradTypes[iAzim];
+                vradValue = vradColumn[iAzim];
+                dbzValueType = dbzTypes[iAzim];
+                dbzValue = dbzColumn[iAzim];
+                scanViewGetValue(cellView, iRang, iAzim, &cellValue);
+                if (alldata->options.useClutterMap){
+                    clutValue = clutColumn[iAzim];
+                }
+
+                // in the points array, store missing reflectivity values as the lowest possible reflectivity
+                // this is to treat undetects as absence of scatterers
+                if (dbzValueType != RaveValueType_DATA){
+                    dbzValue = NAN;
+                }
+
+                // in the points array, store missing vrad values as NAN
+                // this is necessary because different scans may have different missing values
+                if (vradValueType != RaveValueType_DATA){
+                    vradValue = NAN;
+                }
 
-            // store the location as a range, azimuth angle, elevation angle combination
-            points_local[iRowPoints * nColsPoints_local + alldata->points.rangeCol] = gateRange;
-            points_local[iRowPoints * nColsPoints_local + alldata->points.azimAngleCol] = gateAzim;
-            points_local[iRowPoints * nColsPoints_local + alldata->points.elevAngleCol] = elevAngle * RAD2DEG;
+                // store the location as a range, azimuth angle, elevation angle combination
+                points_local->range[iRowPoints] = gateRange;
+                points_local->azimAngle[iRowPoints] = gateAzim;
+                points_local->elevAngle[iRowPoints] = elevAngle * RAD2DEG;
 
-            // also store the dbz value --useful when estimating the bird density
-            points_local[iRowPoints * nColsPoints_local + alldata->points.dbzValueCol] = (float) dbzValue;
+                // also store the dbz value --useful when estimating the bird density
+                points_local->dbzValue[iRowPoints] = (float) dbzValue;
             
-            // store the corresponding observed vrad value
-            points_local[iRowPoints * nColsPoints_local + alldata->points.vradValueCol] = (float) vradValue;
+                // store the corresponding observed vrad value
+                points_local->vradValue[iRowPoints] = (float) vradValue;
 
-            // store the corresponding cellImage value
-            points_local[iRowPoints * nColsPoints_local + alldata->points.cellValueCol] = (float) cellValue;
+                // store the corresponding cellImage value
+                points_local->cellValue[iRowPoints] = (float) cellValue;
 
-            // set the gateCode to zero for now
-            points_local[iRowPoints * nColsPoints_local + alldata->points.gateCodeCol] = (float) 0;
+                // set the gateCode to zero for now
+                points_local->gateCode[iRowPoints] = 0;
 
-            // store the corresponding observed nyquist velocity
-            points_local[iRowPoints * nColsPoints_local + alldata->points.nyquistCol] = (float) nyquist;
+                // store the corresponding observed nyquist velocity
+                points_local->nyquist[iRowPoints] = (float) nyquist;
 
-            // store the corresponding observed vrad value for now (to be dealiased later)
-            points_local[iRowPoints * nColsPoints_local + alldata->points.vraddValueCol] = (float) vradValue;
+                // store the corresponding observed vrad value for now (to be dealiased later)
+                points_local->vraddValue[iRowPoints] = (float) vradValue;
 
-            // store the corresponding observed clutter value
-            points_local[iRowPoints * nColsPoints_local + alldata->points.clutValueCol] = (float) clutValue;
+                // store the corresponding observed clutter value
+                points_local->clutValue[iRowPoints] = (float) clutValue;
 
-            // raise the row counter by 1
-            iRowPoints += 1;
-            
-            // raise number of points written by 1
-            nPointsWritten_local += 1;
+                // raise the row counter by 1
+                iRowPoints += 1;
+
+            }  //for iAzim
+
+            // raise number of points written by nAzim
+            nRowsWritten[iLayer] += nAzim;
 
-        }  //for iAzim
+        } //for iLayer
     } //for iRang
 
-    RAVE_OBJECT_RELEASE(vradParam);
-    RAVE_OBJECT_RELEASE(dbzParam);
-    RAVE_OBJECT_RELEASE(cellParam);
-    RAVE_OBJECT_RELEASE(clutParam);
+    free((void*) iLayerFirst);
+    free((void*) iLayerLast);
 
-    return nPointsWritten_local;
+    return result;
 } // getListOfSelectedGates
 
 
+
+static void getScanGeometry(PolarScan_t* scan, struct scanData* scanData) {
+
+    // set the dimensions, range bin size, elevation angle and radar
+    // height of 'scanData' from 'scan'
+
+    scanData->nRang = PolarScan_getNbins(scan);
+    scanData->nAzim = PolarScan_getNrays(scan);
+    scanData->rangeScale = PolarScan_getRscale(scan);
+    scanData->elevAngle = PolarScan_getElangle(scan);
+    scanData->radarHeight = PolarScan_getHeight(scan);
+
+} // getScanGeometry
+
+
 int vol2birdLoadClutterMap(PolarVolume_t* volume, char* file, float rangeMax){
     PolarVolume_t* clutVol = NULL;
 
@@ -2168,14 +2798,10 @@ PolarScanParam_t* PolarScan_newParam(PolarScan_t *scan, const char *quantity, Ra
     PolarScanParam_setGain(scanParam,1);
     
     // initialize all values to NODATA
-    // (NOTE: this fails for negative values when type == RaveDataType_FLOAT, results in 0 being set. RAVE bug?)
-    double nodata = PolarScanParam_getNodata(scanParam);
-    for(int iRang = 0; iRang < PolarScan_getNbins(scan); iRang++){
-        for(int iAzim = 0; iAzim < PolarScan_getNrays(scan); iAzim++){
-            
-            PolarScanParam_setValue(scanParam, iRang, iAzim, nodata);
-        }
-    }
+    // (NOTE: PolarScanParam_setValue sets 0 for negative values when type == RaveDataType_FLOAT, the scan view does not)
+    vol2birdScanView_t view;
+    scanViewInit(&view, scanParam);
+    scanViewFill(&view, PolarScanParam_getNodata(scanParam));
         
     PolarScan_addParameter(scan, scanParam);
     
@@ -2550,16 +3176,21 @@ PolarScanParam_t* PolarScanParam_resample(PolarScanParam_t* param, double rscale
     double value;
     RaveValueType valueType;
     
+    vol2birdScanView_t view;
+    vol2birdScanView_t view_proj;
+    scanViewInit(&view, param);
+    scanViewInit(&view_proj, param_proj);
+
     // project onto new grid
     for(int iRay=0; iRay<nrays_proj; iRay++){
         for(int iBin=0; iBin<nbins_proj; iBin++){
             // initialize to nodata
-            PolarScanParam_setValue(param_proj, iBin, iRay, PolarScanParam_getNodata(param));
+            scanViewSetValue(&view_proj, iBin, iRay, view.nodata);
             // read data from the scan parameter
-            valueType = PolarScanParam_getValue(param, round(iBin*bin_scaling - 0.499999), round(iRay*ray_scaling - 0.499999), &value);
+            valueType = scanViewGetValue(&view, round(iBin*bin_scaling - 0.499999), round(iRay*ray_scaling - 0.499999), &value);
             // write data from the source scan parameter, to the newly projected scan paramter
             if (valueType != RaveValueType_UNDEFINED){
-                PolarScanParam_setValue(param_proj, iBin, iRay, value);
+                scanViewSetValue(&view_proj, iBin, iRay, value);
             }
         }
     }
@@ -2811,6 +3442,67 @@ static int includeGate(const int iProfileType, const int iQuantityType, const un
 } // includeGate
 
 
+
+static void initScanData(PolarScan_t* scan, vol2birdScanUse_t scanUse, struct scanData* scanData, vol2bird_t* alldata) {
+
+    // ------------------------------------------------------------- //
+    // prepare 'scanData' for the segmentation of 'scan': add the    //
+    // CELL and TEX parameters to the scan, read its metadata and    //
+    // set up views on the data of the parameters. This decodes data //
+    // that is read lazily, such that from here on the scan can be   //
+    // segmented without calling RAVE. The views stay valid as long  //
+    // as the scan holds the parameters                              //
+    // ------------------------------------------------------------- //
+
+    PolarScanParam_t* param;
+
+    getScanGeometry(scan, scanData);
+
+    scanData->nyquist = 0;
+    RaveAttribute_t* attr = PolarScan_getAttribute(scan, "how/NI");
+    if (attr != (RaveAttribute_t *) NULL){
+        RaveAttribute_getDouble(attr, &scanData->nyquist);
+    }
+    RAVE_OBJECT_RELEASE(attr);
+
+    // check that CELL parameter is not present, which might be after running MistNet
+    if (!PolarScan_hasParameter(scan, CELLNAME)){
+        param = PolarScan_newParam(scan, scanUse.cellName, RaveDataType_INT);
+        RAVE_OBJECT_RELEASE(param);
+    }
+    // only when dealing with normal (non-dual pol) data, generate a vrad texture field
+    if (alldata->options.singlePol){
+        param = PolarScan_newParam(scan, scanUse.texName, RaveDataType_DOUBLE);
+        RAVE_OBJECT_RELEASE(param);
+    }
+
+    initScanView(scan, scanUse.dbzName, &scanData->dbz);
+    initScanView(scan, scanUse.vradName, &scanData->vrad);
+    initScanView(scan, scanUse.texName, &scanData->tex);
+    initScanView(scan, scanUse.rhohvName, &scanData->rhohv);
+    initScanView(scan, scanUse.cellName, &scanData->cell);
+    initScanView(scan, scanUse.clutName, &scanData->clut);
+
+} // initScanData
+
+
+
+static void initScanView(PolarScan_t* scan, const char* quantity, vol2birdScanView_t* view) {
+
+    // set up 'view' on parameter 'quantity' of 'scan', a view
+    // without data when the scan does not have the parameter
+
+    PolarScanParam_t* param = NULL;
+
+    if (PolarScan_hasParameter(scan, quantity)) {
+        param = PolarScan_getParameter(scan, quantity);
+    }
+    scanViewInit(view, param);
+    RAVE_OBJECT_RELEASE(param);
+
+} // initScanView
+
+
 /**
  * Function name: isRegularFile
  * Intent: determines whether the given path is to a regular file
@@ -2848,6 +3540,7 @@ static int readUserConfigOptions(cfg_t** cfg, const char * optsConfFilename) {
         CFG_BOOL("PRINT_CLUT",PRINT_CLUT,CFGF_NONE),
         CFG_BOOL("PRINT_OPTIONS",PRINT_OPTIONS,CFGF_NONE),
         CFG_BOOL("FIT_VRAD",FIT_VRAD,CFGF_NONE),
+        CFG_BOOL("VVP_CLOSED_FORM",VVP_CLOSED_FORM,CFGF_NONE),
         CFG_BOOL("PRINT_PROFILE",PRINT_PROFILE,CFGF_NONE),
         CFG_BOOL("PRINT_POINTS_ARRAY",PRINT_POINTS_ARRAY,CFGF_NONE),
         CFG_FLOAT("MIN_NYQUIST_VELOCITY",MIN_NYQUIST_VELOCITY,CFGF_NONE),
@@ -2862,11 +3555,14 @@ static int readUserConfigOptions(cfg_t** cfg, const char * optsConfFilename) {
         CFG_BOOL("REQUIRE_VRAD",REQUIRE_VRAD,CFGF_NONE),
         CFG_BOOL("DEALIAS_VRAD",DEALIAS_VRAD,CFGF_NONE),
         CFG_BOOL("DEALIAS_RECYCLE",DEALIAS_RECYCLE,CFGF_NONE),
+        CFG_BOOL("DEALIAS_SEED",DEALIAS_SEED,CFGF_NONE),
+        CFG_FLOAT("DEALIAS_SEED_COSTMAX",DEALIAS_SEED_COSTMAX,CFGF_NONE),
         CFG_BOOL("EXPORT_BIRD_PROFILE_AS_JSON",FALSE,CFGF_NONE),
         CFG_BOOL("DUALPOL",DUALPOL,CFGF_NONE),
         CFG_BOOL("SINGLEPOL",SINGLEPOL,CFGF_NONE),
         CFG_FLOAT("DBZMIN",DBZMIN,CFGF_NONE),
         CFG_FLOAT("RHOHVMIN",RHOHVMIN,CFGF_NONE),
+        CFG_FLOAT("FRINGEDIST",FRINGEDIST,CFGF_NONE),
         CFG_BOOL("RESAMPLE",RESAMPLE,CFGF_NONE),
         CFG_FLOAT("RESAMPLE_RSCALE",RESAMPLE_RSCALE,CFGF_NONE),
         CFG_INT("RESAMPLE_NBINS",RESAMPLE_NBINS,CFGF_NONE),
@@ -2875,6 +3571,9 @@ static int readUserConfigOptions(cfg_t** cfg, const char * optsConfFilename) {
         CFG_BOOL("MISTNET_ELEVS_ONLY", MISTNET_ELEVS_ONLY, CFGF_NONE),
         CFG_BOOL("USE_MISTNET", USE_MISTNET, CFGF_NONE),
         CFG_STR("MISTNET_PATH",MISTNET_PATH,CFGF_NONE),
+        CFG_INT("NTHREADS",NTHREADS,CFGF_NONE),
+        CFG_STR("CACHE_DIR",CACHE_DIR,CFGF_NONE),
+        CFG_FLOAT("CACHE_SIZE_MAX",CACHE_SIZE_MAX,CFGF_NONE),
         CFG_END()
     };
     
@@ -2899,6 +3598,88 @@ static int readUserConfigOptions(cfg_t** cfg, const char * optsConfFilename) {
 #endif
 
 
+static int mapRangeBinsToLayers(const struct scanData* scanData, int* iLayerFirst, int* iLayerLast, vol2bird_t* alldata) {
+
+    // ------------------------------------------------------------------- //
+    // Determine for each range bin of the scan the altitude layers that   //
+    // contain the height of the middle of the gate, such that the gates   //
+    // of all layers can be selected in a single pass over the scan. A     //
+    // gate exactly on a layer boundary belongs to both adjacent layers.   //
+    // iLayerFirst and iLayerLast are -1 for bins outside any layer, or    //
+    // outside (rangeMin,rangeMax). Returns the number of range bins.      //
+    // ------------------------------------------------------------------- //
+
+    int iRang;
+    int iLayer;
+    int nRang = (int) scanData->nRang;
+    int nLayers = alldata->options.nLayers;
+    float layerThickness = alldata->options.layerThickness;
+    float rangeScale = (float) scanData->rangeScale;
+    float elevAngle = (float) scanData->elevAngle;
+    float radarHeight = (float) scanData->radarHeight;
+    float gateRange;
+    float gateHeight;
+
+    for (iRang = 0; iRang < nRang; iRang++) {
+
+        iLayerFirst[iRang] = -1;
+        iLayerLast[iRang] = -1;
+
+        gateRange = ((float) iRang + 0.5f) * rangeScale;
+
+        if (gateRange < alldata->options.rangeMin || gateRange > alldata->options.rangeMax) {
+            // the current gate is either 
+            // (1) too close to the radar; or
+            // (2) too far away.
+            continue;
+        }
+
+        // note that "sin(elevAngle*DEG2RAD)" is equivalent to = "cos((90 - elevAngle)*DEG2RAD)":
+        gateHeight = range2height(gateRange, elevAngle) + radarHeight;
+
+        // candidate layer, its neighbours are checked with the exact layer
+        // limits to get the boundary cases right
+        int iLayerGuess = (int) floorf(gateHeight / layerThickness);
+
+        for (iLayer = iLayerGuess - 1; iLayer <= iLayerGuess + 1; iLayer++) {
+            if (iLayer < 0 || iLayer >= nLayers) {
+                continue;
+            }
+            float altitudeMin = iLayer * layerThickness;
+            float altitudeMax = (iLayer + 1) * layerThickness;
+            if (gateHeight < altitudeMin || gateHeight > altitudeMax) {
+                continue;
+            }
+            if (iLayerFirst[iRang] < 0) {
+                iLayerFirst[iRang] = iLayer;
+            }
+            iLayerLast[iRang] = iLayer;
+        }
+    }
+
+    return nRang;
+
+} // mapRangeBinsToLayers
+
+
+
+static void movePointsRows(vol2birdPoints_t* points_local, const int iRowTo, const int iRowFrom, const int nRows) {
+
+    // moves nRows rows of the 'points' store from iRowFrom to iRowTo, one
+    // column at a time. The source and destination rows may overlap.
+
+    int iColPoints;
+
+    for (iColPoints = 0; iColPoints < points_local->nColsPoints; iColPoints++) {
+        float* column = &(points_local->points[iColPoints * points_local->nRowsPoints]);
+        memmove(&column[iRowTo], &column[iRowFrom], sizeof(float) * nRows);
+    }
+    memmove(&(points_local->gateCode[iRowTo]), &(points_local->gateCode[iRowFrom]), sizeof(uint32_t) * nRows);
+
+} // movePointsRows
+
+
+
 // copies shared metadata from rave polar volume to rave vertical profile
 static int mapVolumeToProfile(VerticalProfile_t* vp, PolarVolume_t* volume){
     //assert that the volume and vertical profile are defined
@@ -3285,31 +4066,21 @@ int saveToODIM(RaveCoreObject* object, const char* filename){
 }
 
 
-int saveToCSV(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol){
-    
-    // ----------------------------------------------------------------------------------------- //
-    // this function writes the vertical profile to CSV format https://aloftdata.eu/vpts-csv     //
-    // ---------------------------------------------------------------------------------------- //
+// writes the rows of the vertical profile in VPTS CSV format to fp, without header,
+// and stores the datetime of the profile in 'datetime'. Returns -1 on failure.
+static int writeVptsRows(FILE* fp, vol2bird_t* alldata, PolarVolume_t* pvol, char* datetime, const size_t datetimeSize){
 
     //get attributes from polar volume
     double longitude, latitude;
     int height;
-    const char *source, *date, *time;
+    const char *date, *time;
 
     longitude = PolarVolume_getLongitude(pvol) / (M_PI/180.0);
     latitude = PolarVolume_getLatitude(pvol) / (M_PI/180.0);
     height = (int)PolarVolume_getHeight(pvol);
-    source = PolarVolume_getSource(pvol);
     date= PolarVolume_getDate(pvol);
     time = PolarVolume_getTime(pvol);    
 
-    FILE *fp;
-    fp = fopen(filename, "w");
-    if (fp == NULL) {
-        vol2bird_printf("Failed to open file %s for writing.\n", filename);
-        return 0;
-    }
-
     //get attributes from vertical profile
     int nRowsProfile = vol2birdGetNRowsProfile(alldata);
     int nColsProfile = vol2birdGetNColsProfile(alldata);
@@ -3329,15 +4100,14 @@ int saveToCSV(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol){
     radar_name = alldata->misc.radarName;
     fileIn = alldata->misc.filename_pvol;
     
-    fprintf(fp,"radar,datetime,height,u,v,w,ff,dd,sd_vvp,gap,eta,dens,dbz,dbz_all,n,n_dbz,n_all,n_dbz_all,rcs,sd_vvp_threshold,vcp,radar_latitude,radar_longitude,radar_height,radar_wavelength,source_file\n");
+    snprintf(datetime, datetimeSize, "%.4s-%.2s-%.2sT%.2s:%.2s:%.2sZ", date, date+4, date+6, time, time+2, time+4);
+
 
     int iRowProfile;
     int iCopied = 0;
     for (iRowProfile = 0; iRowProfile < nRowsProfile; iRowProfile++) {
         iCopied=iRowProfile*nColsProfile;
 
-        char datetime[24];
-        snprintf(datetime, sizeof(datetime), "%.4s-%.2s-%.2sT%.2s:%.2s:%.2sZ", date, date+4, date+6, time, time+2, time+4);
         char printbuffer[1024];
 
         //write to CSV format
@@ -3370,9 +4140,31 @@ int saveToCSV(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol){
 
     profileAll = NULL;
     profileBio = NULL;
-    free((void*) profileAll);
-    free((void*) profileBio);
+
+    return ferror(fp) ? -1 : 0;
+
+} // writeVptsRows
+
+
+int saveToCSV(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol){
     
+    // ----------------------------------------------------------------------------------------- //
+    // this function writes the vertical profile to CSV format https://aloftdata.eu/vpts-csv     //
+    // ---------------------------------------------------------------------------------------- //
+
+    char datetime[24];
+
+    FILE *fp;
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+        vol2bird_printf("Failed to open file %s for writing.\n", filename);
+        return 0;
+    }
+
+    fprintf(fp, "%s", VPTS_CSV_HEADER);
+
+    writeVptsRows(fp, alldata, pvol, datetime, sizeof(datetime));
+
     if (fclose(fp) != 0) {
         vol2bird_printf("Failed to close file %s.\n", filename);
         return 0;
@@ -3392,35 +4184,959 @@ int isCSV(const char *filename) {
     return 0;
 }
 
-static void printCellProp(CELLPROP* cellProp, float elev, int nCells, int nCellsValid, vol2bird_t *alldata){
-    
-    // ---------------------------------------------------------- //
-    // this function prints the cell properties struct to stderr  //
-    // ---------------------------------------------------------- //
-    
-    vol2bird_err_printf("#Cell analysis for elevation %f:\n",elev*RAD2DEG);
-    vol2bird_err_printf("#Minimum cell area in km^2     : %f\n",alldata->constants.areaCellMin);
-    vol2bird_err_printf("#Threshold for mean dBZ cell   : %g dBZ\n",alldata->misc.cellDbzMin);
-    vol2bird_err_printf("#Threshold for mean stdev cell : %g m/s\n",alldata->options.cellStdDevMax);
-    vol2bird_err_printf("#Valid cells                   : %i/%i\n#\n",nCellsValid,nCells);
-    vol2bird_err_printf("cellProp: .index .nGates .nGatesClutter   .Area .dbzAvg .texAvg .cv   .dbzMax .iRangOfMax .iAzimOfMax .drop\n");
-    for (int iCell = 0; iCell < nCells; iCell++) {
-        if (cellProp[iCell].drop == TRUE) {
-            continue;
-        }
-        vol2bird_err_printf("cellProp: %6d %7d %14d %7.2f %7.2f %7.2f %5.2f %7.2f %11d %11d %5c\n",
-            cellProp[iCell].index,
-            cellProp[iCell].nGates,
-            cellProp[iCell].nGatesClutter,
-            cellProp[iCell].area,
-            cellProp[iCell].dbzAvg,
-            cellProp[iCell].texAvg,
-            cellProp[iCell].cv,
-            cellProp[iCell].dbzMax,
-            cellProp[iCell].iRangOfMax,
-            cellProp[iCell].iAzimOfMax,
-            cellProp[iCell].drop == TRUE ? 'T' : 'F');
-    }
+
+int saveToVPB(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol){
+
+    // ----------------------------------------------------------------------------------------- //
+    // this function appends the vertical profile to a binary vpb time series, see libvpb.h     //
+    // ----------------------------------------------------------------------------------------- //
+
+    vpbMeta_t meta;
+
+    memset(&meta, 0, sizeof(meta));
+    strncpy(meta.radar, alldata->misc.radarName, sizeof(meta.radar) - 1);
+    meta.time = vpbTime(PolarVolume_getDate(pvol), PolarVolume_getTime(pvol));
+    meta.latitude = PolarVolume_getLatitude(pvol) / (M_PI/180.0);
+    meta.longitude = PolarVolume_getLongitude(pvol) / (M_PI/180.0);
+    meta.height = PolarVolume_getHeight(pvol);
+    meta.wavelength = alldata->options.radarWavelength;
+    meta.rcs = alldata->options.birdRadarCrossSection;
+    meta.sdVvpThresh = alldata->options.stdDevMinBird;
+    meta.vcp = alldata->misc.vcp;
+
+    if (vpbAppend(filename, &meta, vol2birdGetNRowsProfile(alldata), vol2birdGetNColsProfile(alldata),
+                  vol2birdGetProfile(1, alldata), vol2birdGetProfile(3, alldata)) != 0) {
+        return 0;
+    }
+
+    return 1;
+
+}
+
+    //check if file extension is vpb
+int isVPB(const char *filename) {
+    const char *dot = strrchr(filename, '.');
+    if (dot && !strcasecmp(dot, ".vpb")) {
+        return 1;
+    }
+    return 0;
+}
+
+
+// ------------------------------------------------------------- //
+//          streaming VPTS CSV output for many volumes           //
+// ------------------------------------------------------------- //
+
+// A VPTS writer keeps the VPTS CSV files of a run open, such that the profiles
+// of many volumes end up in one file with a single header. Rows are appended
+// as volumes come in, which keeps the file sorted when the volumes are
+// processed in time order. Otherwise the file is sorted (and rows for the same
+// radar, datetime and height are deduplicated) when the writer is closed.
+
+// a VPTS CSV file written by a VPTS writer
+struct vol2birdVptsFile {
+    // path of the file, after expanding the {radar} and {date} placeholders
+    char path[1000];
+    // NULL when the file is (no longer) open
+    FILE* fp;
+    // the latest datetime in the file, and whether the rows are in time order
+    char datetimeLast[24];
+    int isSorted;
+    // when the file was last added to, used to close the least recently used file
+    long lastUse;
+    struct vol2birdVptsFile* next;
+};
+
+struct vol2birdVptsWriter {
+    struct vol2birdVptsFile* files;
+    int nOpen;
+    long nAdded;
+};
+
+// a row of a VPTS CSV file, with the fields it is sorted on
+struct vptsRow {
+    char* line;
+    long index;
+    int radarLength;
+    const char* datetime;
+    double height;
+};
+
+
+
+static int compareVptsRows(const void* a, const void* b) {
+
+    const struct vptsRow* rowA = (const struct vptsRow*) a;
+    const struct vptsRow* rowB = (const struct vptsRow*) b;
+
+    int result = strncmp(rowA->datetime, rowB->datetime, 20);
+    if (result == 0) {
+        result = rowA->radarLength == rowB->radarLength ? strncmp(rowA->line, rowB->line, rowA->radarLength) :
+                                                          rowA->radarLength - rowB->radarLength;
+    }
+    if (result == 0 && rowA->height != rowB->height) {
+        result = rowA->height < rowB->height ? -1 : 1;
+    }
+    if (result == 0) {
+        result = rowA->index < rowB->index ? -1 : 1;
+    }
+
+    return result;
+
+} // compareVptsRows
+
+
+
+// splits off the radar, datetime and height fields of a VPTS CSV row,
+// returns -1 when the row does not have these fields
+static int parseVptsRow(struct vptsRow* row) {
+
+    const char* comma1 = strchr(row->line, ',');
+    const char* comma2 = comma1 == NULL ? NULL : strchr(comma1 + 1, ',');
+
+    if (comma2 == NULL) {
+        return -1;
+    }
+
+    row->radarLength = comma1 - row->line;
+    row->datetime = comma1 + 1;
+    row->height = atof(comma2 + 1);
+
+    return 0;
+
+} // parseVptsRow
+
+
+
+// expands the {radar} and {date} placeholders in a VPTS CSV file name
+static void expandVptsPath(char* path, const size_t pathSize, const char* pattern, const char* radar, const char* date) {
+
+    size_t iPath = 0;
+    const char* p = pattern;
+
+    while (*p != '\0' && iPath + 1 < pathSize) {
+        const char* insert = NULL;
+        if (strncmp(p, "{radar}", 7) == 0) {
+            insert = radar;
+            p += 7;
+        }
+        else if (strncmp(p, "{date}", 6) == 0) {
+            insert = date;
+            p += 6;
+        }
+        if (insert != NULL) {
+            iPath += snprintf(path + iPath, pathSize - iPath, "%s", insert);
+            if (iPath >= pathSize) {
+                iPath = pathSize - 1;
+            }
+        }
+        else {
+            path[iPath++] = *p++;
+        }
+    }
+    path[iPath] = '\0';
+
+} // expandVptsPath
+
+
+
+// opens a VPTS CSV file of a writer, writing the header when it is empty. With merge,
+// or when the file was written before in this run, rows are added to an existing file,
+// otherwise an existing file is overwritten. Returns -1 on failure.
+static int openVptsFile(struct vol2birdVptsFile* file, const int merge) {
+
+    char line[1024];
+    const char* datetime;
+
+    file->fp = fopen(file->path, merge ? "a+" : "w+");
+    if (file->fp == NULL) {
+        vol2bird_printf("Failed to open file %s for writing.\n", file->path);
+        return -1;
+    }
+    setvbuf(file->fp, NULL, _IOFBF, 1 << 16);
+
+    // find out whether the rows in the file are in time order, and the latest datetime
+    file->datetimeLast[0] = '\0';
+    file->isSorted = TRUE;
+    rewind(file->fp);
+    if (fgets(line, sizeof(line), file->fp) == NULL) {
+        fprintf(file->fp, "%s", VPTS_CSV_HEADER);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file->fp) != NULL) {
+        datetime = strchr(line, ',');
+        if (datetime == NULL) {
+            continue;
+        }
+        datetime++;
+        if (strncmp(datetime, file->datetimeLast, 20) < 0) {
+            file->isSorted = FALSE;
+        }
+        else {
+            snprintf(file->datetimeLast, sizeof(file->datetimeLast), "%.20s", datetime);
+        }
+    }
+    fseek(file->fp, 0, SEEK_END);
+
+    return 0;
+
+} // openVptsFile
+
+
+
+// rewrites a VPTS CSV file with its rows sorted on datetime, radar and height,
+// keeping only the row added last for rows with the same datetime, radar and height
+static int sortVptsFile(struct vol2birdVptsFile* file) {
+
+    char header[1024];
+    char line[1024];
+    char pathTmp[1010];
+    struct vptsRow* rows = NULL;
+    long nRows = 0;
+    long nRowsMax = 0;
+    long iRow;
+    int result = -1;
+    FILE* fp;
+
+    fflush(file->fp);
+    rewind(file->fp);
+    if (fgets(header, sizeof(header), file->fp) == NULL) {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file->fp) != NULL) {
+        if (nRows == nRowsMax) {
+            nRowsMax = nRowsMax == 0 ? 1024 : 2 * nRowsMax;
+            struct vptsRow* rowsNew = realloc(rows, nRowsMax * sizeof(struct vptsRow));
+            if (rowsNew == NULL) {
+                vol2bird_err_printf("Error allocating memory for sorting VPTS file %s\n", file->path);
+                goto done;
+            }
+            rows = rowsNew;
+        }
+        rows[nRows].line = strdup(line);
+        rows[nRows].index = nRows;
+        if (rows[nRows].line == NULL) {
+            vol2bird_err_printf("Error allocating memory for sorting VPTS file %s\n", file->path);
+            goto done;
+        }
+        if (parseVptsRow(&rows[nRows]) != 0) {
+            free(rows[nRows].line);
+            continue;
+        }
+        nRows++;
+    }
+
+    qsort(rows, nRows, sizeof(struct vptsRow), compareVptsRows);
+
+    // write to a new file that replaces the old one when complete
+    snprintf(pathTmp, sizeof(pathTmp), "%s.tmp", file->path);
+    fp = fopen(pathTmp, "w");
+    if (fp == NULL) {
+        vol2bird_printf("Failed to open file %s for writing.\n", pathTmp);
+        goto done;
+    }
+    fprintf(fp, "%s", header);
+    for (iRow = 0; iRow < nRows; iRow++) {
+        // of duplicate rows, the last one is the most recently added
+        if (iRow + 1 < nRows && rows[iRow].radarLength == rows[iRow + 1].radarLength &&
+            strncmp(rows[iRow].line, rows[iRow + 1].line, rows[iRow].radarLength) == 0 &&
+            strncmp(rows[iRow].datetime, rows[iRow + 1].datetime, 20) == 0 &&
+            rows[iRow].height == rows[iRow + 1].height) {
+            continue;
+        }
+        fprintf(fp, "%s", rows[iRow].line);
+    }
+    if (fclose(fp) != 0 || rename(pathTmp, file->path) != 0) {
+        vol2bird_printf("Failed to write file %s.\n", file->path);
+        remove(pathTmp);
+        goto done;
+    }
+
+    result = 0;
+
+done:
+    for (iRow = 0; iRow < nRows; iRow++) {
+        free(rows[iRow].line);
+    }
+    free(rows);
+
+    return result;
+
+} // sortVptsFile
+
+
+
+static int closeVptsFile(struct vol2birdVptsFile* file) {
+
+    int result = 0;
+
+    if (file->fp == NULL) {
+        return 0;
+    }
+
+    if (!file->isSorted && sortVptsFile(file) != 0) {
+        result = -1;
+    }
+
+    if (fclose(file->fp) != 0) {
+        vol2bird_printf("Failed to close file %s.\n", file->path);
+        result = -1;
+    }
+    file->fp = NULL;
+
+    return result;
+
+} // closeVptsFile
+
+
+
+vol2birdVptsWriter_t* vol2birdVptsWriterNew(void) {
+
+    vol2birdVptsWriter_t* writer = (vol2birdVptsWriter_t*) malloc(sizeof(vol2birdVptsWriter_t));
+
+    if (writer == NULL) {
+        vol2bird_err_printf("Error allocating memory for VPTS writer\n");
+        return NULL;
+    }
+
+    writer->files = NULL;
+    writer->nOpen = 0;
+    writer->nAdded = 0;
+
+    return writer;
+
+} // vol2birdVptsWriterNew
+
+
+
+// adds the profile of a volume to the VPTS CSV file 'pattern', in which {radar} and
+// {date} are replaced by the radar name and the (YYYYMMDD) date of the volume, such
+// that e.g. "{radar}_vpts_{date}.csv" gives one file per radar per day. With merge,
+// the rows are merged with those of an existing file, otherwise an existing file is
+// overwritten the first time it is written to by this writer.
+// Returns 1 on success and 0 on failure, as saveToCSV
+int vol2birdVptsWriterAdd(vol2birdVptsWriter_t* writer, const char* pattern, const int merge,
+                          vol2bird_t* alldata, PolarVolume_t* pvol) {
+
+    char path[1000];
+    char datetime[24];
+    struct vol2birdVptsFile* file;
+    struct vol2birdVptsFile* fileOldest = NULL;
+    int isReopened = FALSE;
+
+    expandVptsPath(path, sizeof(path), pattern, alldata->misc.radarName, PolarVolume_getDate(pvol));
+
+    for (file = writer->files; file != NULL; file = file->next) {
+        if (strcmp(file->path, path) == 0) {
+            break;
+        }
+    }
+
+    if (file == NULL) {
+        file = (struct vol2birdVptsFile*) malloc(sizeof(struct vol2birdVptsFile));
+        if (file == NULL) {
+            vol2bird_err_printf("Error allocating memory for VPTS file %s\n", path);
+            return 0;
+        }
+        snprintf(file->path, sizeof(file->path), "%s", path);
+        file->fp = NULL;
+        file->next = writer->files;
+        writer->files = file;
+    }
+    else {
+        isReopened = TRUE;
+    }
+
+    if (file->fp == NULL) {
+        // limit the number of open files, e.g. for batches of many radars and days
+        if (writer->nOpen >= VPTSFILESOPENMAX) {
+            struct vol2birdVptsFile* fileOpen;
+            for (fileOpen = writer->files; fileOpen != NULL; fileOpen = fileOpen->next) {
+                if (fileOpen->fp != NULL && (fileOldest == NULL || fileOpen->lastUse < fileOldest->lastUse)) {
+                    fileOldest = fileOpen;
+                }
+            }
+            writer->nOpen--;
+            if (closeVptsFile(fileOldest) != 0) {
+                return 0;
+            }
+        }
+        if (openVptsFile(file, merge || isReopened) != 0) {
+            return 0;
+        }
+        writer->nOpen++;
+    }
+
+    file->lastUse = writer->nAdded++;
+
+    if (writeVptsRows(file->fp, alldata, pvol, datetime, sizeof(datetime)) != 0) {
+        return 0;
+    }
+
+    // a volume that is not later than the ones before, e.g. a reprocessed one, needs sorting
+    if (strncmp(datetime, file->datetimeLast, 20) <= 0) {
+        file->isSorted = FALSE;
+    }
+    else {
+        snprintf(file->datetimeLast, sizeof(file->datetimeLast), "%s", datetime);
+    }
+
+    return 1;
+
+} // vol2birdVptsWriterAdd
+
+
+
+// closes all files of the writer, sorting those that were not written in time order,
+// and frees the writer. Returns 1 on success and 0 on failure
+int vol2birdVptsWriterClose(vol2birdVptsWriter_t* writer) {
+
+    int result = 1;
+
+    if (writer == NULL) {
+        return 1;
+    }
+
+    while (writer->files != NULL) {
+        struct vol2birdVptsFile* file = writer->files;
+        if (closeVptsFile(file) != 0) {
+            result = 0;
+        }
+        writer->files = file->next;
+        free(file);
+    }
+    free(writer);
+
+    return result;
+
+} // vol2birdVptsWriterClose
+
+
+// ------------------------------------------------------------- //
+//                    on-disk profile cache                      //
+// ------------------------------------------------------------- //
+
+// The profile cache keeps the profiles of processed volumes in options.cacheDir,
+// such that reprocessing unchanged input with unchanged options returns the stored
+// profile without reading and processing the polar volume again. An entry consists
+// of the ODIM profile <key>.h5 and a single record vpb file <key>.vpb holding the
+// profile arrays. The vpb file is written last, an entry without it is not used.
+// The key is a 64-bit FNV-1a hash of the content of the input files and the static
+// clutter map, the options and constants in task_args format, and the vol2bird version.
+
+// the directory entries of the cache, used for eviction
+struct cacheFile {
+    char key[VOL2BIRD_CACHE_KEY_LENGTH];
+    time_t mtime;
+    long long bytes;
+};
+
+
+static uint64_t hashBytes(uint64_t hash, const void* data, const size_t size) {
+
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+
+} // hashBytes
+
+
+static int hashFile(uint64_t* hash, const char* filename) {
+
+    unsigned char buffer[65536];
+    char sizeString[32];
+    unsigned long long nBytes = 0;
+    size_t nRead;
+    FILE* fp;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        vol2bird_err_printf("Failed to open file %s for reading.\n", filename);
+        return -1;
+    }
+    while ((nRead = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        *hash = hashBytes(*hash, buffer, nRead);
+        nBytes += nRead;
+    }
+    int result = ferror(fp) ? -1 : 0;
+    fclose(fp);
+
+    // separates the content of consecutive files
+    snprintf(sizeString, sizeof(sizeString), ",%llu,", nBytes);
+    *hash = hashBytes(*hash, sizeString, strlen(sizeString));
+
+    return result;
+
+} // hashFile
+
+
+// adds everything but the input volume to the hash of the input and formats the key
+static int finishCacheKey(uint64_t hash, vol2bird_t* alldata, char* key) {
+
+    char taskArgs[3000];
+    char elev[32];
+
+    if (alldata->options.useClutterMap && hashFile(&hash, alldata->options.clutterMap) != 0) {
+        return -1;
+    }
+
+    // the options as configured, vol2birdSetUp adapts some of them to the
+    // volume, which is already covered by the hash of the input
+    formatTaskArgs(taskArgs, sizeof(taskArgs), alldata);
+    hash = hashBytes(hash, taskArgs, strlen(taskArgs) + 1);
+
+    // the MistNet elevations are not part of task_args
+    if (alldata->options.useMistNet) {
+        for (int iElev = 0; iElev < alldata->options.mistNetNElevs; iElev++) {
+            snprintf(elev, sizeof(elev), "%f,", alldata->options.mistNetElevs[iElev]);
+            hash = hashBytes(hash, elev, strlen(elev));
+        }
+    }
+
+    hash = hashBytes(hash, VERSION, strlen(VERSION) + 1);
+
+    snprintf(key, VOL2BIRD_CACHE_KEY_LENGTH, "%016llx", (unsigned long long) hash);
+
+    return 0;
+
+} // finishCacheKey
+
+
+// computes the cache key of the polar volume read from 'filenames' with the
+// options in alldata, 'key' has room for VOL2BIRD_CACHE_KEY_LENGTH characters.
+// Returns -1 when the cache is disabled or the input cannot be read.
+int vol2birdCacheKey(char* filenames[], int nInputFiles, vol2bird_t* alldata, char* key) {
+
+    uint64_t hash = 14695981039346656037ULL;
+
+    if (alldata->options.cacheDir[0] == '\0') {
+        return -1;
+    }
+
+    for (int iFile = 0; iFile < nInputFiles; iFile++) {
+        if (hashFile(&hash, filenames[iFile]) != 0) {
+            return -1;
+        }
+    }
+
+    return finishCacheKey(hash, alldata, key);
+
+} // vol2birdCacheKey
+
+
+// computes the cache key of a polar volume held in memory, as read by vol2birdGetVolumeFromBuffer
+int vol2birdCacheKeyFromBuffer(const void* buffer, size_t size, vol2bird_t* alldata, char* key) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    char sizeString[32];
+
+    if (alldata->options.cacheDir[0] == '\0') {
+        return -1;
+    }
+
+    hash = hashBytes(hash, buffer, size);
+    snprintf(sizeString, sizeof(sizeString), ",%llu,", (unsigned long long) size);
+    hash = hashBytes(hash, sizeString, strlen(sizeString));
+
+    return finishCacheKey(hash, alldata, key);
+
+} // vol2birdCacheKeyFromBuffer
+
+
+static void cacheEntryPath(char* path, const size_t pathSize, const char* key, const char* extension, vol2bird_t* alldata) {
+
+    snprintf(path, pathSize, "%s/%s%s", alldata->options.cacheDir, key, extension);
+
+} // cacheEntryPath
+
+
+// looks up a profile in the cache. On a hit, it sets up alldata as vol2birdSetUp and
+// vol2birdCalcProfiles would have done and fills alldata->vp as mapDataToRave would have
+// done, and returns 0 with a polar volume holding only the metadata of the original volume
+// (date, time, source, location). Release the volume and call vol2birdTearDownVolume as usual.
+// Returns -1 when the profile is not in the cache.
+int vol2birdCacheLoad(const char* key, vol2bird_t* alldata, PolarVolume_t** volume) {
+
+    char pathVpb[1100];
+    char pathOdim[1100];
+    vpbReader_t* reader = NULL;
+    RaveIO_t* raveio = NULL;
+    VerticalProfile_t* vp = NULL;
+    RaveAttribute_t* attr = NULL;
+    char* taskArgs = NULL;
+    vpbMeta_t meta;
+
+    *volume = NULL;
+
+    if (alldata->options.cacheDir[0] == '\0' || key == NULL) {
+        return -1;
+    }
+
+    cacheEntryPath(pathVpb, sizeof(pathVpb), key, ".vpb", alldata);
+    cacheEntryPath(pathOdim, sizeof(pathOdim), key, ".h5", alldata);
+
+    if (!isRegularFile(pathVpb) || !isRegularFile(pathOdim)) {
+        goto miss;
+    }
+
+    // the schema of the profile arrays that vol2birdSetUp allocates
+    reader = vpbOpen(pathVpb);
+    if (reader == NULL || reader->nRecords != 1 || reader->nLayers != alldata->options.nLayers ||
+        reader->nCols != NCOLS_PROFILE || reader->nProfiles != VPB_NPROFILES ||
+        vpbGetMeta(reader, 0, &meta) != 0) {
+        vol2bird_err_printf("Warning: ignoring invalid profile cache entry %s\n", pathVpb);
+        goto miss;
+    }
+
+    raveio = RaveIO_open(pathOdim, 0, NULL);
+    if (raveio == NULL || RaveIO_getObjectType(raveio) != Rave_ObjectType_VP) {
+        vol2bird_err_printf("Warning: ignoring invalid profile cache entry %s\n", pathOdim);
+        goto miss;
+    }
+    vp = (VerticalProfile_t*) RaveIO_getObject(raveio);
+
+    // the polar volume metadata that the profile outputs use
+    *volume = RAVE_OBJECT_NEW(&PolarVolume_TYPE);
+    if (vp == NULL || *volume == NULL) {
+        vol2bird_err_printf("Error allocating memory for cached profile\n");
+        goto miss;
+    }
+    PolarVolume_setDate(*volume, VerticalProfile_getDate(vp));
+    PolarVolume_setTime(*volume, VerticalProfile_getTime(vp));
+    PolarVolume_setSource(*volume, VerticalProfile_getSource(vp));
+    PolarVolume_setLatitude(*volume, VerticalProfile_getLatitude(vp));
+    PolarVolume_setLongitude(*volume, VerticalProfile_getLongitude(vp));
+    PolarVolume_setHeight(*volume, VerticalProfile_getHeight(vp));
+
+    // the profile arrays, profile types 1 and 3 are the ones vol2bird outputs
+    const size_t nValues = (size_t) reader->nLayers * reader->nCols;
+    alldata->profiles.profile = (float*) malloc(sizeof(float) * nValues);
+    alldata->profiles.profile1 = (float*) malloc(sizeof(float) * nValues);
+    alldata->profiles.profile2 = (float*) malloc(sizeof(float) * nValues);
+    alldata->profiles.profile3 = (float*) malloc(sizeof(float) * nValues);
+    if (alldata->profiles.profile == NULL || alldata->profiles.profile1 == NULL ||
+        alldata->profiles.profile2 == NULL || alldata->profiles.profile3 == NULL) {
+        vol2bird_err_printf("Error pre-allocating profile arrays for cached profile\n");
+        free((void*) alldata->profiles.profile);
+        free((void*) alldata->profiles.profile1);
+        free((void*) alldata->profiles.profile2);
+        free((void*) alldata->profiles.profile3);
+        goto miss;
+    }
+    for (size_t iValue = 0; iValue < nValues; iValue++) {
+        alldata->profiles.profile[iValue] = NODATA;
+        alldata->profiles.profile2[iValue] = NODATA;
+    }
+    if (vpbGetProfile(reader, 0, 0, alldata->profiles.profile1) != 0 ||
+        vpbGetProfile(reader, 0, 1, alldata->profiles.profile3) != 0) {
+        vol2bird_err_printf("Warning: ignoring invalid profile cache entry %s\n", pathVpb);
+        free((void*) alldata->profiles.profile);
+        free((void*) alldata->profiles.profile1);
+        free((void*) alldata->profiles.profile2);
+        free((void*) alldata->profiles.profile3);
+        goto miss;
+    }
+    alldata->profiles.nProfileTypes = 3;
+    alldata->profiles.nRowsProfile = reader->nLayers;
+    alldata->profiles.nColsProfile = reader->nCols;
+    alldata->profiles.iProfileTypeLast = -1;
+
+    // nothing else is allocated for a cached profile
+    alldata->points.points = NULL;
+    alldata->points.gateCode = NULL;
+    alldata->points.indexFrom = NULL;
+    alldata->points.indexTo = NULL;
+    alldata->points.nPointsWritten = NULL;
+    alldata->misc.scatterersAreNotBirds = NULL;
+    alldata->misc.scratch = NULL;
+    alldata->misc.nScratch = 0;
+
+    // the settings that vol2birdSetUp adapted to the original volume
+    snprintf(alldata->misc.radarName, sizeof(alldata->misc.radarName), "%s", meta.radar);
+    alldata->misc.vcp = meta.vcp;
+    alldata->options.radarWavelength = meta.wavelength;
+    alldata->options.birdRadarCrossSection = meta.rcs;
+    alldata->options.stdDevMinBird = meta.sdVvpThresh;
+    alldata->misc.vol2birdSuccessful = TRUE;
+
+    attr = VerticalProfile_getAttribute(vp, "how/task_args");
+    if (attr != NULL && RaveAttribute_getString(attr, &taskArgs) && taskArgs != NULL) {
+        snprintf(alldata->misc.task_args, sizeof(alldata->misc.task_args), "%s", taskArgs);
+    }
+    RAVE_OBJECT_RELEASE(attr);
+
+    // the file names of this run rather than those of the run that stored the profile
+    attr = RaveAttributeHelp_createString("how/filename_pvol", alldata->misc.filename_pvol);
+    VerticalProfile_addAttribute(vp, attr);
+    RAVE_OBJECT_RELEASE(attr);
+    attr = RaveAttributeHelp_createString("how/filename_vp", alldata->misc.filename_vp);
+    VerticalProfile_addAttribute(vp, attr);
+    RAVE_OBJECT_RELEASE(attr);
+
+    alldata->vp = vp;
+    alldata->misc.initializationSuccessful = TRUE;
+
+    // the modification time orders the entries for eviction
+    utime(pathVpb, NULL);
+    utime(pathOdim, NULL);
+
+    vpbClose(reader);
+    RAVE_OBJECT_RELEASE(raveio);
+
+    alldata->misc.cacheHits++;
+
+    return 0;
+
+miss:
+    vpbClose(reader);
+    RAVE_OBJECT_RELEASE(raveio);
+    RAVE_OBJECT_RELEASE(vp);
+    RAVE_OBJECT_RELEASE(*volume);
+
+    alldata->misc.cacheMisses++;
+
+    return -1;
+
+} // vol2birdCacheLoad
+
+
+static int compareCacheFilesByKey(const void* a, const void* b) {
+
+    return strcmp(((const struct cacheFile*) a)->key, ((const struct cacheFile*) b)->key);
+
+} // compareCacheFilesByKey
+
+
+static int compareCacheFilesByTime(const void* a, const void* b) {
+
+    const struct cacheFile* fileA = (const struct cacheFile*) a;
+    const struct cacheFile* fileB = (const struct cacheFile*) b;
+
+    if (fileA->mtime != fileB->mtime) {
+        return fileA->mtime < fileB->mtime ? -1 : 1;
+    }
+
+    return strcmp(fileA->key, fileB->key);
+
+} // compareCacheFilesByTime
+
+
+// determines the size of the cache and, when it exceeds options.cacheSizeMax,
+// removes the least recently used entries. Returns the number of entries removed.
+static int evictCacheEntries(vol2bird_t* alldata) {
+
+    const long long bytesMax = (long long) (alldata->options.cacheSizeMax * 1024 * 1024);
+    struct cacheFile* files = NULL;
+    struct dirent* dirEntry;
+    struct stat st;
+    char path[1100];
+    int nFiles = 0;
+    int nFilesAllocated = 0;
+    int nEvicted = 0;
+    DIR* dir;
+
+    // the size is kept up to date by vol2birdCacheStore, so the directory
+    // is only scanned the first time and when entries have to be removed
+    if (alldata->misc.cacheBytes >= 0 && (bytesMax <= 0 || alldata->misc.cacheBytes <= bytesMax)) {
+        return 0;
+    }
+
+    dir = opendir(alldata->options.cacheDir);
+    if (dir == NULL) {
+        vol2bird_err_printf("Warning: failed to read profile cache directory %s\n", alldata->options.cacheDir);
+        return 0;
+    }
+
+    alldata->misc.cacheBytes = 0;
+    while ((dirEntry = readdir(dir)) != NULL) {
+        const char* dot = strchr(dirEntry->d_name, '.');
+        if (dot == NULL || dot - dirEntry->d_name != VOL2BIRD_CACHE_KEY_LENGTH - 1 ||
+            (strcmp(dot, ".vpb") != 0 && strcmp(dot, ".h5") != 0)) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", alldata->options.cacheDir, dirEntry->d_name);
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (nFiles == nFilesAllocated) {
+            nFilesAllocated = nFilesAllocated > 0 ? 2 * nFilesAllocated : 256;
+            struct cacheFile* filesNew = (struct cacheFile*) realloc(files, nFilesAllocated * sizeof(struct cacheFile));
+            if (filesNew == NULL) {
+                vol2bird_err_printf("Error allocating memory for profile cache index\n");
+                closedir(dir);
+                free(files);
+                alldata->misc.cacheBytes = -1;
+                return 0;
+            }
+            files = filesNew;
+        }
+        snprintf(files[nFiles].key, VOL2BIRD_CACHE_KEY_LENGTH, "%.*s", VOL2BIRD_CACHE_KEY_LENGTH - 1, dirEntry->d_name);
+        files[nFiles].mtime = st.st_mtime;
+        files[nFiles].bytes = (long long) st.st_size;
+        alldata->misc.cacheBytes += files[nFiles].bytes;
+        nFiles++;
+    }
+    closedir(dir);
+
+    if (bytesMax > 0 && alldata->misc.cacheBytes > bytesMax) {
+
+        // merge the files of each entry, which are removed together
+        int nEntries = 0;
+        qsort(files, nFiles, sizeof(struct cacheFile), compareCacheFilesByKey);
+        for (int iFile = 0; iFile < nFiles; iFile++) {
+            if (nEntries > 0 && strcmp(files[nEntries - 1].key, files[iFile].key) == 0) {
+                files[nEntries - 1].bytes += files[iFile].bytes;
+                if (files[iFile].mtime > files[nEntries - 1].mtime) {
+                    files[nEntries - 1].mtime = files[iFile].mtime;
+                }
+            }
+            else {
+                files[nEntries++] = files[iFile];
+            }
+        }
+        qsort(files, nEntries, sizeof(struct cacheFile), compareCacheFilesByTime);
+
+        // leave some room, such that the next profiles can be stored without another scan
+        const long long bytesTarget = bytesMax - bytesMax / 10;
+        for (int iEntry = 0; iEntry < nEntries && alldata->misc.cacheBytes > bytesTarget; iEntry++) {
+            // the vpb file first, which invalidates the entry
+            cacheEntryPath(path, sizeof(path), files[iEntry].key, ".vpb", alldata);
+            remove(path);
+            cacheEntryPath(path, sizeof(path), files[iEntry].key, ".h5", alldata);
+            remove(path);
+            alldata->misc.cacheBytes -= files[iEntry].bytes;
+            nEvicted++;
+        }
+    }
+
+    free(files);
+
+    alldata->misc.cacheEvictions += nEvicted;
+
+    return nEvicted;
+
+} // evictCacheEntries
+
+
+// stores the profile of a volume in the cache, after mapDataToRave. Returns 1 on
+// success and 0 on failure, in which case processing can continue without the cache.
+int vol2birdCacheStore(const char* key, PolarVolume_t* volume, vol2bird_t* alldata) {
+
+    char pathVpb[1100];
+    char pathOdim[1100];
+    char pathVpbTmp[1100];
+    char pathOdimTmp[1100];
+    char suffix[64];
+    struct stat st;
+    long long bytes = 0;
+
+    if (alldata->options.cacheDir[0] == '\0' || key == NULL) {
+        return 0;
+    }
+
+    if (alldata->misc.initializationSuccessful == FALSE) {
+        vol2bird_err_printf("You need to initialize vol2bird before you can use it. Aborting.\n");
+        return 0;
+    }
+
+    if (mkdir(alldata->options.cacheDir, 0777) != 0 && errno != EEXIST) {
+        vol2bird_err_printf("Warning: failed to create profile cache directory %s\n", alldata->options.cacheDir);
+        return 0;
+    }
+
+    cacheEntryPath(pathVpb, sizeof(pathVpb), key, ".vpb", alldata);
+    cacheEntryPath(pathOdim, sizeof(pathOdim), key, ".h5", alldata);
+
+    // write to temporary files first, such that concurrent runs never read a partial entry
+    snprintf(suffix, sizeof(suffix), ".%ld.tmp.vpb", (long) getpid());
+    cacheEntryPath(pathVpbTmp, sizeof(pathVpbTmp), key, suffix, alldata);
+    snprintf(suffix, sizeof(suffix), ".%ld.tmp.h5", (long) getpid());
+    cacheEntryPath(pathOdimTmp, sizeof(pathOdimTmp), key, suffix, alldata);
+
+    // saveToVPB appends, so start from an empty file
+    remove(pathVpbTmp);
+
+    if (saveToODIM((RaveCoreObject*) alldata->vp, pathOdimTmp) == FALSE ||
+        saveToVPB(pathVpbTmp, alldata, volume) == FALSE ||
+        rename(pathOdimTmp, pathOdim) != 0 || rename(pathVpbTmp, pathVpb) != 0) {
+        vol2bird_err_printf("Warning: failed to store profile in cache %s\n", alldata->options.cacheDir);
+        remove(pathOdimTmp);
+        remove(pathVpbTmp);
+        remove(pathVpb);
+        return 0;
+    }
+
+    if (stat(pathOdim, &st) == 0) {
+        bytes += (long long) st.st_size;
+    }
+    if (stat(pathVpb, &st) == 0) {
+        bytes += (long long) st.st_size;
+    }
+    if (alldata->misc.cacheBytes >= 0) {
+        alldata->misc.cacheBytes += bytes;
+    }
+    alldata->misc.cacheStores++;
+
+    evictCacheEntries(alldata);
+
+    return 1;
+
+} // vol2birdCacheStore
+
+
+void vol2birdCachePrintStats(vol2bird_t* alldata) {
+
+    if (alldata->options.cacheDir[0] == '\0') {
+        return;
+    }
+
+    vol2bird_err_printf("profile cache %s: %ld hits, %ld misses, %ld stored, %ld evicted",
+                        alldata->options.cacheDir, alldata->misc.cacheHits, alldata->misc.cacheMisses,
+                        alldata->misc.cacheStores, alldata->misc.cacheEvictions);
+    if (alldata->misc.cacheBytes >= 0) {
+        vol2bird_err_printf(", %.1f MB\n", alldata->misc.cacheBytes / (1024.0 * 1024.0));
+    }
+    else {
+        vol2bird_err_printf("\n");
+    }
+
+} // vol2birdCachePrintStats
+
+static void printCellProp(CELLPROP* cellProp, float elev, int nCells, int nCellsValid, vol2bird_t *alldata){
+    
+    // ---------------------------------------------------------- //
+    // this function prints the cell properties struct to stderr  //
+    // ---------------------------------------------------------- //
+    
+    vol2bird_err_printf("#Cell analysis for elevation %f:\n",elev*RAD2DEG);
+    vol2bird_err_printf("#Minimum cell area in km^2     : %f\n",alldata->constants.areaCellMin);
+    vol2bird_err_printf("#Threshold for mean dBZ cell   : %g dBZ\n",alldata->misc.cellDbzMin);
+    vol2bird_err_printf("#Threshold for mean stdev cell : %g m/s\n",alldata->options.cellStdDevMax);
+    vol2bird_err_printf("#Valid cells                   : %i/%i\n#\n",nCellsValid,nCells);
+    vol2bird_err_printf("cellProp: .index .nGates .nGatesClutter   .Area .dbzAvg .texAvg .cv   .dbzMax .iRangOfMax .iAzimOfMax .drop\n");
+    for (int iCell = 0; iCell < nCells; iCell++) {
+        if (cellProp[iCell].drop == TRUE) {
+            continue;
+        }
+        vol2bird_err_printf("cellProp: %6d %7d %14d %7.2f %7.2f %7.2f %5.2f %7.2f %11d %11d %5c\n",
+            cellProp[iCell].index,
+            cellProp[iCell].nGates,
+            cellProp[iCell].nGatesClutter,
+            cellProp[iCell].area,
+            cellProp[iCell].dbzAvg,
+            cellProp[iCell].texAvg,
+            cellProp[iCell].cv,
+            cellProp[iCell].dbzMax,
+            cellProp[iCell].iRangOfMax,
+            cellProp[iCell].iAzimOfMax,
+            cellProp[iCell].drop == TRUE ? 'T' : 'F');
+    }
 }
 
 
@@ -3719,27 +5435,7 @@ static void sortCellsByArea(CELLPROP *cellProp, const int nCells) {
     // Sorting of the cell properties based on cell area.               //
     // ---------------------------------------------------------------- // 
 
-    int iCell;
-    int iCellOther;
-    CELLPROP tmp;
-
-    //Sorting of data elements using straight insertion method.
-    for (iCell = 1; iCell < nCells; iCell++) {
-
-        tmp = cellProp[iCell];
-
-        iCellOther = iCell - 1;
-
-        while (iCellOther >= 0 && cellProp[iCellOther].nGates < tmp.nGates) {
-
-            cellProp[iCellOther + 1] = cellProp[iCellOther];
-
-            iCellOther--;
-        }
-
-        cellProp[iCellOther + 1] = tmp;
-
-    } //for iCell
+    qsort(cellProp, nCells, sizeof(CELLPROP), compareCellsByArea);
 
     return;
 } // sortCellsByArea
@@ -3851,9 +5547,98 @@ static int removeDroppedCells(CELLPROP *cellProp, const int nCells) {
 
 
 
+static void resetPointsRows(vol2birdPoints_t* points_local, const int iRowFrom, const int nRows) {
+
+    // resets nRows rows of the 'points' store, starting at iRowFrom,
+    // to their initial (empty) value
+
+    int iColPoints;
+    int iRowPoints;
+
+    for (iColPoints = 0; iColPoints < points_local->nColsPoints; iColPoints++) {
+        float* column = &(points_local->points[iColPoints * points_local->nRowsPoints]);
+        for (iRowPoints = iRowFrom; iRowPoints < iRowFrom + nRows; iRowPoints++) {
+            column[iRowPoints] = NAN;
+        }
+    }
+    for (iRowPoints = iRowFrom; iRowPoints < iRowFrom + nRows; iRowPoints++) {
+        points_local->gateCode[iRowPoints] = 0;
+    }
+
+} // resetPointsRows
+
+
+
+static void selectLayerGates(vol2bird_t* alldata, const int iLayer, vol2birdLayerGates_t* gates1, vol2birdLayerGates_t* gates3) {
+
+    // ------------------------------------------------------------- //
+    // select the gates of altitude layer iLayer that contribute to  //
+    // profile types 1 and 3, in a single pass over the layer's rows //
+    // of 'points'. This also clears the flagPositionVDifMax bit and //
+    // resets the dealiased vrad value of the layer's gates, as is   //
+    // needed before calculating profile type 3                      //
+    // ------------------------------------------------------------- //
+
+    const int iPointFrom = alldata->points.indexFrom[iLayer];
+    const int nPointsLayer = alldata->points.nPointsWritten[iLayer];
+    const uint32_t flagVDifMax = 1u << (alldata->flags.flagPositionVDifMax);
+    const uint32_t excludeZ1 = alldata->flags.excludeMask[1][0];
+    const uint32_t excludeZ3 = alldata->flags.excludeMask[3][0];
+    const uint32_t excludeVrad1 = alldata->flags.excludeMask[1][1];
+    const uint32_t excludeVrad3 = alldata->flags.excludeMask[3][1];
+    int iPoint;
+
+    gates1->nIndex = 0;
+    gates1->undbzSum = 0.0;
+    gates1->nPointsIncludedZ = 0;
+    gates3->nIndex = 0;
+    gates3->undbzSum = 0.0;
+    gates3->nPointsIncludedZ = 0;
+
+    for (iPoint = iPointFrom; iPoint < iPointFrom + nPointsLayer; iPoint++) {
+
+        const uint32_t gateCode = alldata->points.gateCode[iPoint] & ~flagVDifMax;
+        alldata->points.gateCode[iPoint] = gateCode;
+        alldata->points.vraddValue[iPoint] = alldata->points.vradValue[iPoint];
+
+        // gates that contribute to the average reflectivity Z of the layer
+        const int includeZ1 = (gateCode & excludeZ1) == 0;
+        const int includeZ3 = (gateCode & excludeZ3) == 0;
+
+        if (includeZ1 == TRUE || includeZ3 == TRUE) {
+            // convert the dbz value at this [azimuth, elevation] from dB scale to linear scale
+            float dbzValue = alldata->points.dbzValue[iPoint];
+            float undbzValue;
+            if (isnan(dbzValue) == TRUE) {
+                undbzValue = 0;
+            } else {
+                undbzValue = (float) exp(0.1 * log(10) * dbzValue);
+            }
+            if (includeZ1 == TRUE) {
+                gates1->undbzSum += undbzValue;
+                gates1->nPointsIncludedZ += 1;
+            }
+            if (includeZ3 == TRUE) {
+                gates3->undbzSum += undbzValue;
+                gates3->nPointsIncludedZ += 1;
+            }
+        }
+
+        // gates that may contribute to the VVP fit of the layer, written
+        // unconditionally and kept by advancing the counter
+        gates1->index[gates1->nIndex] = iPoint;
+        gates1->nIndex += (gateCode & excludeVrad1) == 0;
+        gates3->index[gates3->nIndex] = iPoint;
+        gates3->nIndex += (gateCode & excludeVrad3) == 0;
+    }
+
+} // selectLayerGates
+
+
+
 
 static void updateFlagFieldsInPointsArray(const float* yObs, const float* yFitted, const int* includedIndex, 
-                                   const int nPointsIncluded, float* points_local, vol2bird_t* alldata) {
+                                   const int nPointsIncluded, uint32_t* gateCode_local, vol2bird_t* alldata) {
                                        
     // ----------------------------------------------------------------------------------- //
     // after the first svdfit to the selection of points, we want to identify gates that   //
@@ -3865,7 +5650,6 @@ static void updateFlagFieldsInPointsArray(const float* yObs, const float* yFitte
 
     int iPointIncluded;
     int iPoint;
-    unsigned int gateCode;
 
     for (iPointIncluded = 0; iPointIncluded < nPointsIncluded; iPointIncluded++) {
 
@@ -3874,8 +5658,7 @@ static void updateFlagFieldsInPointsArray(const float* yObs, const float* yFitte
         if (absVDif > alldata->constants.absVDifMax) {
             
             iPoint = includedIndex[iPointIncluded];
-            gateCode = (unsigned int) points_local[iPoint * alldata->points.nColsPoints + alldata->points.gateCodeCol];
-            points_local[iPoint * alldata->points.nColsPoints + alldata->points.gateCodeCol] = (float) (gateCode |= 1<<(alldata->flags.flagPositionVDifMax));
+            gateCode_local[iPoint] |= 1<<(alldata->flags.flagPositionVDifMax);
 
         }
     } 
@@ -3884,7 +5667,7 @@ static void updateFlagFieldsInPointsArray(const float* yObs, const float* yFitte
 
 
 
-static int updateMap(PolarScan_t* scan, CELLPROP *cellProp, const int nCells, vol2bird_t* alldata) {
+static int updateMap(struct scanData* scanData, CELLPROP *cellProp, const int nCells, vol2bird_t* alldata) {
 
     // ------------------------------------------------------------------------- //
     // This function updates cellImage by dropping cells and reindexing the map. //
@@ -3896,11 +5679,11 @@ static int updateMap(PolarScan_t* scan, CELLPROP *cellProp, const int nCells, vo
     int iCellNew;
     int nCellsValid;
     int cellImageValue;
+    int* cellImageNew;
 
-    PolarScanParam_t *cellParam = PolarScan_getParameter(scan, CELLNAME);
-    int* cellImage = (int *) PolarScanParam_getData(cellParam);
+    int* cellImage = (int *) scanData->cell.data;
 
-    int nGlobal = PolarScanParam_getNbins(cellParam) * PolarScanParam_getNrays(cellParam);
+    int nGlobal = scanData->cell.nRang * scanData->cell.nAzim;
 
     #ifdef FPRINTFON
     int minValue = cellImage[0];
@@ -3917,23 +5700,22 @@ static int updateMap(PolarScan_t* scan, CELLPROP *cellProp, const int nCells, vo
     vol2bird_err_printf("maximum value in cellImage array = %d.\n", maxValue);
     #endif
 
-    nCellsValid = nCells;
-
-    for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
-
-        if (cellImage[iGlobal] == -1) {
-            continue;
-        }
-
-        cellImageValue = cellImage[iGlobal];
+    // lookup table of the new value for each cell index value in cellImage, by
+    // default cells are marked with a negative value (offset by -100) as done
+    // for values that do not refer to a valid cell
+    cellImageNew = (int*) malloc(sizeof(int) * (nCells > 0 ? nCells : 1));
+    if (cellImageNew == NULL) {
+        vol2bird_err_printf("Error pre-allocating lookup table in updateMap\n");
+        return -1;
+    }
 
-        if (cellImageValue > nCells - 1) {
-            vol2bird_err_printf( "You just asked for the properties of cell %d, which does not exist.\n", cellImageValue);
-            continue;
+    // cells that have been dropped are removed from cellImage
+    for (iCell = 0; iCell < nCells; iCell++) {
+        if (cellProp[iCell].drop == TRUE) {
+            cellImageNew[iCell] = -1;
         }
-
-        if (cellProp[cellImageValue].drop == TRUE) {
-            cellImage[iGlobal] = -1;
+        else {
+            cellImageNew[iCell] = -1 * iCell - 100;
         }
     }
 
@@ -3956,424 +5738,469 @@ static int updateMap(PolarScan_t* scan, CELLPROP *cellProp, const int nCells, vo
     vol2bird_err_printf("\n");
     #endif
 
-    // replace the values in cellImage with newly calculated index values:
+    // the remaining cells are numbered by area, leaving index 0 and 1 unused
     for (iCell = 0; iCell < nCells; iCell++) {
 
         if (iCell < nCellsValid) {
-            iCellNew = -1 * (iCell + 2 + 100);
+            iCellNew = iCell + 2;
+            if (cellProp[iCell].index >= 0 && cellProp[iCell].index < nCells) {
+                cellImageNew[cellProp[iCell].index] = iCellNew;
+            }
         }
         else {
             iCellNew = -1;
         }
 
         #ifdef FPRINTFON
-        vol2bird_err_printf("before: cellProp[%d].index = %d.\n",iCell,cellProp[iCell].index);
-        vol2bird_err_printf("before: cellProp[%d].nGates = %d.\n",iCell,cellProp[iCell].nGates);
-        vol2bird_err_printf("before: iCell = %d.\n",iCell);
-        vol2bird_err_printf("before: iCellNew = %d.\n",iCellNew);
+        vol2bird_err_printf("cellProp[%d].index = %d -> %d.\n",iCell,cellProp[iCell].index,iCellNew);
+        vol2bird_err_printf("cellProp[%d].nGates = %d.\n",iCell,cellProp[iCell].nGates);
         vol2bird_err_printf("\n");
         #endif
 
-        for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
-            if (cellImage[iGlobal] == cellProp[iCell].index) {
-                cellImage[iGlobal] = iCellNew;
-            }
-        }
         // have the indices in cellProp match the re-numbering
         cellProp[iCell].index = iCellNew;
 
     } // (iCell = 0; iCell < nCells; iCell++)
 
-
-    // once you've re-numbered everything, flip the sign back and
-    // remove the offset of 100...
+    // replace the values in cellImage with newly calculated index values:
     for (iGlobal = 0; iGlobal < nGlobal; iGlobal++) {
-        if (cellImage[iGlobal] == -1) {
-            // do nothing
+
+        cellImageValue = cellImage[iGlobal];
+
+        if (cellImageValue == -1) {
+            continue;
         }
-        else {
-            cellImage[iGlobal] = (-1 * cellImage[iGlobal]) - 100;
+
+        if (cellImageValue > nCells - 1) {
+            vol2bird_err_printf( "You just asked for the properties of cell %d, which does not exist.\n", cellImageValue);
         }
-    }
-    // ...and make sure the indices in cellProp match that change
-    for (iCell = 0; iCell < nCells; iCell++) {
 
-        if (cellProp[iCell].index == -1) {
-            // do nothing
+        if (cellImageValue < 0 || cellImageValue > nCells - 1) {
+            cellImage[iGlobal] = -1 * cellImageValue - 100;
         }
         else {
-            cellProp[iCell].index = (-1 * cellProp[iCell].index) - 100;
+            cellImage[iGlobal] = cellImageNew[cellImageValue];
         }
-
-        #ifdef FPRINTFON
-        vol2bird_err_printf("after: cellProp[%d].index = %d.\n",iCell,cellProp[iCell].index);
-        vol2bird_err_printf("after: cellProp[%d].nGates = %d.\n",iCell,cellProp[iCell].nGates);
-        vol2bird_err_printf("\n");
-        #endif
     }
-    RAVE_OBJECT_RELEASE(cellParam);
+
+    free((void*) cellImageNew);
+
     return nCellsValid;
 } // updateMap
 
 
 
-void vol2birdCalcProfiles(vol2bird_t *alldata) {
-
-  int nPasses;
-  int iPoint;
-  int iLayer;
-  int iPass;
-  int iProfileType;
+static void calcProfileLayer(vol2bird_t *alldata, vol2birdScratch_t* scratch, const vol2birdLayerGates_t* gates,
+                             const int iProfileType, const int iLayer, const int nPasses, const int recycleDealias,
+                             float* profile) {
 
-  if (alldata->misc.initializationSuccessful == FALSE) {
-    vol2bird_err_printf( "You need to initialize vol2bird before you can use it. Aborting.\n");
-    return;
-  }
+  // ------------------------------------------------------------- //
+  // calculate the profile data of a single altitude layer for one //
+  // profile type from the gates selected by selectLayerGates(),   //
+  // writing the result to that layer's row of 'profile'           //
+  // ------------------------------------------------------------- //
 
-  // calculate the profiles in reverse order, because you need the result
-  // of iProfileType == 3 in order to check whether chi < stdDevMinBird
-  // when calculating iProfileType == 1
-  for (iProfileType = alldata->profiles.nProfileTypes; iProfileType > 0; iProfileType--) {
-    // ------------------------------------------------------------- //
-    //                        prepare the profile                    //
-    //                                                               //
-    // iProfileType == 1: birds                                      //
-    // iProfileType == 2: non-birds                                  //
-    // iProfileType == 3: birds+non-birds                            //
-    // ------------------------------------------------------------- //
+  int iPass;
 
-    // FIXME: we better get rid of ProfileType==2 altogether, instead of
-    // skipping it here.
-    if (iProfileType == 2)
-      continue;
+  // these variables are needed just outside of the iPass loop below
+  float chi = NAN;
+  int hasGap = TRUE;
+  float birdDensity = NAN;
 
-    alldata->profiles.iProfileTypeLast = iProfileType;
+  for (iPass = 0; iPass < nPasses; iPass++) {
 
-    // if the user does not require fitting a model to the observed
-    // vrad values, we don't need a second pass to remove dealiasing outliers
-    if (alldata->options.fitVrad == TRUE) {
-      nPasses = 2;
+    int iPointLayer;
+    int iPointIncluded;
+    int iGate;
+    int nPointsIncluded;
+    int nPointsIncludedZ;
+
+    float parameterVector[] = { NAN, NAN, NAN };
+    float avar[] = { NAN, NAN, NAN };
+
+    float *pointsSelection = scratch->pointsSelection;
+    float *yNyquist = scratch->yNyquist;
+    float *yDealias = scratch->yDealias;
+    float *yObs = scratch->yObs;
+    float *yFitted = scratch->yFitted;
+    int *includedIndex = scratch->includedIndex;
+
+    float *yObsSvdFit = yObs;
+    float undbzAvg = NAN;
+    float dbzAvg = NAN;
+    float reflectivity = NAN;
+    float chisq = NAN;
+    float hSpeed = NAN;
+    float hDir = NAN;
+
+    profile[iLayer * alldata->profiles.nColsProfile + 0] = (iLayer + 0.5) * alldata->options.layerThickness;
+    profile[iLayer * alldata->profiles.nColsProfile + 1] = alldata->options.layerThickness;
+    profile[iLayer * alldata->profiles.nColsProfile + 2] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 3] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 4] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 5] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 6] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 7] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 8] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 9] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 10] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 11] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 12] = NODATA;
+    profile[iLayer * alldata->profiles.nColsProfile + 13] = NODATA;
+
+    // the average reflectivity Z of the layer does not change between passes,
+    // its sum is calculated once by selectLayerGates()
+    nPointsIncludedZ = gates->nPointsIncludedZ;
+
+    // calculate bird densities from undbzSum
+    if (nPointsIncludedZ > alldata->constants.nPointsIncludedMin) {
+      // when there are enough valid points, convert undbzAvg back to dB-scale
+      undbzAvg = (float) (gates->undbzSum / nPointsIncludedZ);
+      dbzAvg = (10 * log(undbzAvg)) / log(10);
     } else {
-      nPasses = 1;
+      undbzAvg = UNDETECT;
+      dbzAvg = UNDETECT;
     }
 
-    // set a flag that indicates if we want to keep earlier dealiased values
-    int recycleDealias = FALSE;
-    if (iProfileType < 3 && alldata->options.dealiasRecycle) {
-      recycleDealias = TRUE;
-    }
+    // convert from Z (not dBZ) in units of mm^6/m^3 to
+    // reflectivity eta in units of cm^2/km^3
+    reflectivity = alldata->misc.dbzFactor * undbzAvg;
 
-    // reset the flagPositionVDifMax bit before calculating each profile
-    for (iPoint = 0; iPoint < alldata->points.nRowsPoints; iPoint++) {
-      unsigned int gateCode = (unsigned int) alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.gateCodeCol];
-      alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.gateCodeCol] = (float) (gateCode &= ~(1
-          << (alldata->flags.flagPositionVDifMax)));
-    }
+    if (iProfileType == 1) {
+      // calculate bird density in number of birds/km^3 by
+      // dividing the reflectivity by the (assumed) cross section
+      // of one bird
+      birdDensity = reflectivity / alldata->options.birdRadarCrossSection;
+    } else {
+      birdDensity = UNDETECT;
+    }
+
+    // birdDensity and reflectivity should also be UNDETECT when undbzAvg is
+    if (undbzAvg == UNDETECT) {
+      reflectivity = UNDETECT;
+      birdDensity = UNDETECT;
+    }
+
+    //Prepare the arguments of svdfit
+    iPointIncluded = 0;
+    for (iGate = 0; iGate < gates->nIndex; iGate++) {
+
+      iPointLayer = gates->index[iGate];
+
+      // the gates were selected without their flagPositionVDifMax bit, which
+      // after the first pass marks the outliers of the first svdfit
+      if ((alldata->points.gateCode[iPointLayer] & (1 << (alldata->flags.flagPositionVDifMax))) == 0) {
+
+        // copy azimuth angle from the 'points' array
+        pointsSelection[iPointIncluded * alldata->misc.nDims + 0] = alldata->points.azimAngle[iPointLayer];
+        // copy elevation angle from the 'points' array
+        pointsSelection[iPointIncluded * alldata->misc.nDims + 1] = alldata->points.elevAngle[iPointLayer];
+        // copy nyquist interval from the 'points' array
+        yNyquist[iPointIncluded] = alldata->points.nyquist[iPointLayer];
+        // copy the observed vrad value at this [azimuth, elevation]
+        yObs[iPointIncluded] = alldata->points.vradValue[iPointLayer];
+        // copy the dealiased vrad value at this [azimuth, elevation]
+        yDealias[iPointIncluded] = alldata->points.vraddValue[iPointLayer];
+        // pre-allocate the fitted vrad value at this [azimuth,elevation]
+        yFitted[iPointIncluded] = 0.0f;
+        // keep a record of which index was just included
+        includedIndex[iPointIncluded] = iPointLayer;
+        // raise the counter
+        iPointIncluded += 1;
 
-    // reset the dealiased vrad value before calculating each profile
-    if (!recycleDealias) {
-      for (iPoint = 0; iPoint < alldata->points.nRowsPoints; iPoint++) {
-        alldata->points.points[iPoint * alldata->points.nColsPoints + alldata->points.vraddValueCol] = alldata->points.points[iPoint
-            * alldata->points.nColsPoints + alldata->points.vradValueCol];
       }
-    }
+    } // endfor (iGate = 0; iGate < gates->nIndex; iGate++)
+    nPointsIncluded = iPointIncluded;
 
-    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+    // check if there are directions that have almost no observations
+    // (as this makes the svdfit result really uncertain)
+    hasGap = hasAzimuthGap(&pointsSelection[0], nPointsIncluded, alldata);
 
-      // these variables are needed just outside of the iPass loop below
-      float chi = NAN;
-      int hasGap = TRUE;
-      float birdDensity = NAN;
+    if (alldata->options.fitVrad == TRUE) {
 
-      for (iPass = 0; iPass < nPasses; iPass++) {
+      if (hasGap == FALSE) {
 
-        const int iPointFrom = alldata->points.indexFrom[iLayer];
-        const int nPointsLayer = alldata->points.nPointsWritten[iLayer];
+        // ------------------------------------------------------------- //
+        //                  dealias radial velocities                    //
+        // ------------------------------------------------------------- //
 
-        int iPointLayer;
-        int iPointIncluded;
-        int iPointIncludedZ;
-        int nPointsIncluded;
-        int nPointsIncludedZ;
+        // dealias velocities if requested by user
+        // only dealias in first pass (later passes for removing dual-PRF dealiasing errors,
+        // which show smaller offsets than (2*nyquist velocity) and therefore are not
+        // removed by dealiasing routine)
+        // The condition nyquistMinUsed<maxNyquistDealias enforces that if all scans
+        // have a higher Nyquist velocity than maxNyquistDealias, dealiasing is suppressed
+        if (alldata->options.dealiasVrad && iPass == 0 && !recycleDealias) {
+#ifdef FPRINTFON
+          vol2bird_err_printf("dealiasing %i points for profile %i, layer %i ...\n",nPointsIncluded,iProfileType,iLayer+1);
+#endif
+          // when requested, start from the wind of a neighbouring layer or an earlier volume,
+          // dealias_points searches all test fields when uvSeed is NAN
+          double uvSeed[2] = { NAN, NAN };
+          if (alldata->options.dealiasSeed == TRUE) {
+            getDealiasSeed(alldata, iLayer, &uvSeed[0]);
+          }
+          int result = dealias_points(&pointsSelection[0], alldata->misc.nDims, &yNyquist[0], alldata->misc.nyquistMin, &yObs[0], &yDealias[0],
+              nPointsIncluded, scratch->dealiasWork, &uvSeed[0], alldata->options.dealiasSeedCostMax);
+          // store dealiased velocities in points array (for re-use when iPass>0)
+          for (int i = 0; i < nPointsIncluded; i++) {
+            alldata->points.vraddValue[includedIndex[i]] = yDealias[i];
+          }
 
-        float parameterVector[] = { NAN, NAN, NAN };
-        float avar[] = { NAN, NAN, NAN };
+          if (result == 0) {
+            vol2bird_err_printf( "Warning, failed to dealias radial velocities");
+          }
+        }
 
-        float *pointsSelection = malloc(sizeof(float) * nPointsLayer * alldata->misc.nDims);
-        float *yNyquist = malloc(sizeof(float) * nPointsLayer);
-        float *yDealias = malloc(sizeof(float) * nPointsLayer);
-        float *yObs = malloc(sizeof(float) * nPointsLayer);
-        float *yFitted = malloc(sizeof(float) * nPointsLayer);
-        int *includedIndex = malloc(sizeof(int) * nPointsLayer);
+        //print the dealiased values to stderr
+        if (alldata->options.printDealias == TRUE) {
+          printDealias(&pointsSelection[0], alldata->misc.nDims, &yNyquist[0], &yObs[0], &yDealias[0], nPointsIncluded, iProfileType, iLayer + 1,
+              iPass + 1);
+        }
 
-        float *yObsSvdFit = yObs;
-        float dbzValue = NAN;
-        float undbzValue = NAN;
-        double undbzSum = 0.0;
-        float undbzAvg = NAN;
-        float dbzAvg = NAN;
-        float reflectivity = NAN;
-        float chisq = NAN;
-        float hSpeed = NAN;
-        float hDir = NAN;
+        // yDealias is initialized to yObs, so we can always run svdfit
+        // on yDealias, even when not running a dealiasing routine
+        yObsSvdFit = yDealias;
 
-        for (iPointLayer = 0; iPointLayer < nPointsLayer; iPointLayer++) {
+        // ------------------------------------------------------------- //
+        //                       do the svdfit                           //
+        // ------------------------------------------------------------- //
 
-          pointsSelection[iPointLayer * alldata->misc.nDims + 0] = 0.0f;
-          pointsSelection[iPointLayer * alldata->misc.nDims + 1] = 0.0f;
+        if (alldata->options.vvpClosedForm == TRUE) {
+          chisq = vvpfit(&pointsSelection[0], alldata->misc.nDims, &yObsSvdFit[0], &yFitted[0], nPointsIncluded, &parameterVector[0], &avar[0],
+              alldata->misc.nParsFitted, scratch->svdfitWork);
+        } else {
+          chisq = svdfit(&pointsSelection[0], alldata->misc.nDims, &yObsSvdFit[0], &yFitted[0], nPointsIncluded, &parameterVector[0], &avar[0],
+              alldata->misc.nParsFitted, scratch->svdfitWork);
+        }
 
-          yNyquist[iPointLayer] = 0.0f;
-          yDealias[iPointLayer] = 0.0f;
-          yObs[iPointLayer] = 0.0f;
-          yFitted[iPointLayer] = 0.0f;
+        if (chisq < alldata->constants.chisqMin) {
+          // the standard deviation of the fit is too low, as in the case of overfit
+          // reset parameter vector array elements to NAN and continue with the next layer
+          parameterVector[0] = NAN;
+          parameterVector[1] = NAN;
+          parameterVector[2] = NAN;
+          // FIXME: if this happens, profile fields are not updated from UNDETECT to NODATA
+        } else {
 
-          includedIndex[iPointLayer] = -1;
+          chi = sqrt(chisq);
+          hSpeed = sqrt(pow(parameterVector[0], 2) + pow(parameterVector[1], 2));
+          hDir = (atan2(parameterVector[0], parameterVector[1]) * RAD2DEG);
 
-        };
+          if (hDir < 0) {
+            hDir += 360.0f;
+          }
 
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 0] = (iLayer + 0.5) * alldata->options.layerThickness;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 1] = alldata->options.layerThickness;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 2] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 3] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 4] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 5] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 6] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 7] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 8] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 9] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 10] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 11] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 12] = NODATA;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 13] = NODATA;
-
-        //Calculate the average reflectivity Z of the layer
-        iPointIncludedZ = 0;
-        for (iPointLayer = iPointFrom; iPointLayer < iPointFrom + nPointsLayer; iPointLayer++) {
-
-          unsigned int gateCode = (unsigned int) alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.gateCodeCol];
-
-          if (includeGate(iProfileType, 0, gateCode, alldata) == TRUE) {
-
-            // get the dbz value at this [azimuth, elevation]
-            dbzValue = alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.dbzValueCol];
-            // convert from dB scale to linear scale
-            if (isnan(dbzValue) == TRUE) {
-              undbzValue = 0;
-            } else {
-              undbzValue = (float) exp(0.1 * log(10) * dbzValue);
-            }
-            // sum the undbz in this layer
-            undbzSum += undbzValue;
-            // raise the counter
-            iPointIncludedZ += 1;
+          // if the fitted vrad value is more than 'absVDifMax' away from the corresponding
+          // observed vrad value, set the gate's flagPositionVDifMax bit flag to 1, excluding the
+          // gate in the second svdfit iteration
+          updateFlagFieldsInPointsArray(&yObsSvdFit[0], &yFitted[0], &includedIndex[0], nPointsIncluded, &(alldata->points.gateCode[0]), alldata);
 
-          }
-        } // endfor (iPointLayer = 0; iPointLayer < nPointsLayer; iPointLayer++) {
-        nPointsIncludedZ = iPointIncludedZ;
-
-        // calculate bird densities from undbzSum
-        if (nPointsIncludedZ > alldata->constants.nPointsIncludedMin) {
-          // when there are enough valid points, convert undbzAvg back to dB-scale
-          undbzAvg = (float) (undbzSum / nPointsIncludedZ);
-          dbzAvg = (10 * log(undbzAvg)) / log(10);
-        } else {
-          undbzAvg = UNDETECT;
-          dbzAvg = UNDETECT;
         }
 
-        // convert from Z (not dBZ) in units of mm^6/m^3 to
-        // reflectivity eta in units of cm^2/km^3
-        reflectivity = alldata->misc.dbzFactor * undbzAvg;
+      } // endif (hasGap == FALSE)
+
+    }; // endif (fitVrad == TRUE)
+
+    //---------------------------------------------//
+    //         Fill the profile arrays             //
+    //---------------------------------------------//
+
+    // always fill below profile fields, these never have a NODATA or UNDETECT value.
+    profile[iLayer * alldata->profiles.nColsProfile + 0] = iLayer * alldata->options.layerThickness;
+    profile[iLayer * alldata->profiles.nColsProfile + 1] = (iLayer + 1) * alldata->options.layerThickness;
+    profile[iLayer * alldata->profiles.nColsProfile + 8] = (float) hasGap;
+    profile[iLayer * alldata->profiles.nColsProfile + 10] = (float) nPointsIncluded;
+    profile[iLayer * alldata->profiles.nColsProfile + 13] = (float) nPointsIncludedZ;
+
+    // fill below profile fields when (1) VVP fit was not performed because of azimuthal data gap
+    // and (2) layer contains range gates within the volume sampled by the radar.
+    if (hasGap && nPointsIncludedZ > alldata->constants.nPointsIncludedMin) {
+      profile[iLayer * alldata->profiles.nColsProfile + 2] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 3] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 4] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 5] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 6] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 7] = UNDETECT;
+      profile[iLayer * alldata->profiles.nColsProfile + 9] = dbzAvg;
+      profile[iLayer * alldata->profiles.nColsProfile + 11] = reflectivity;
+      profile[iLayer * alldata->profiles.nColsProfile + 12] = birdDensity;
+    }
+    // case of valid fit, fill profile fields with VVP fit parameters
+    if (!hasGap) {
+      profile[iLayer * alldata->profiles.nColsProfile + 2] = parameterVector[0];
+      profile[iLayer * alldata->profiles.nColsProfile + 3] = parameterVector[1];
+      profile[iLayer * alldata->profiles.nColsProfile + 4] = parameterVector[2];
+      profile[iLayer * alldata->profiles.nColsProfile + 5] = hSpeed;
+      profile[iLayer * alldata->profiles.nColsProfile + 6] = hDir;
+      profile[iLayer * alldata->profiles.nColsProfile + 7] = chi;
+      profile[iLayer * alldata->profiles.nColsProfile + 9] = dbzAvg;
+      profile[iLayer * alldata->profiles.nColsProfile + 11] = reflectivity;
+      profile[iLayer * alldata->profiles.nColsProfile + 12] = birdDensity;
+    }
+
+  } // endfor (iPass = 0; iPass < nPasses; iPass++)
+  // You need some of the results of iProfileType == 3 in order
+  // to calculate iProfileType == 1, therefore iProfileType == 3 is executed first
+  if (iProfileType == 3) {
+    // NOTE: chi can have NAN or numeric value at this point
+    // when NAN, below condition evaluates to FALSE, i.e. scatterersAreNotBirds is set to FALSE
+    if (chi < alldata->options.stdDevMinBird) {
+      alldata->misc.scatterersAreNotBirds[iLayer] = TRUE;
+    } else {
+      alldata->misc.scatterersAreNotBirds[iLayer] = FALSE;
+    }
+  }
+  if (iProfileType == 1) {
+    // set the bird density to zero if radial velocity stdev below threshold:
+    if (alldata->misc.scatterersAreNotBirds[iLayer] == TRUE) {
+      profile[iLayer * alldata->profiles.nColsProfile + 12] = 0.0;
+    }
+  }
+
+  // keep the fitted wind, from which the dealiasing of the layer above,
+  // of the next profile or of the next volume can start
+  if (alldata->options.dealiasSeed == TRUE && hasGap == FALSE) {
+    float u = profile[iLayer * alldata->profiles.nColsProfile + 2];
+    float v = profile[iLayer * alldata->profiles.nColsProfile + 3];
+    if (isnan(u) == FALSE && isnan(v) == FALSE) {
+      alldata->misc.dealiasSeed[2 * iLayer] = u;
+      alldata->misc.dealiasSeed[2 * iLayer + 1] = v;
+      alldata->misc.dealiasSeedVolume[iLayer] = alldata->misc.iVolume;
+    }
+  }
 
-        if (iProfileType == 1) {
-          // calculate bird density in number of birds/km^3 by
-          // dividing the reflectivity by the (assumed) cross section
-          // of one bird
-          birdDensity = reflectivity / alldata->options.birdRadarCrossSection;
-        } else {
-          birdDensity = UNDETECT;
-        }
-
-        // birdDensity and reflectivity should also be UNDETECT when undbzAvg is
-        if (undbzAvg == UNDETECT) {
-          reflectivity = UNDETECT;
-          birdDensity = UNDETECT;
-        }
-
-        //Prepare the arguments of svdfit
-        iPointIncluded = 0;
-        for (iPointLayer = iPointFrom; iPointLayer < iPointFrom + nPointsLayer; iPointLayer++) {
-
-          unsigned int gateCode = (unsigned int) alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.gateCodeCol];
-
-          if (includeGate(iProfileType, 1, gateCode, alldata) == TRUE) {
-
-            // copy azimuth angle from the 'points' array
-            pointsSelection[iPointIncluded * alldata->misc.nDims + 0] = alldata->points.points[iPointLayer * alldata->points.nColsPoints
-                + alldata->points.azimAngleCol];
-            // copy elevation angle from the 'points' array
-            pointsSelection[iPointIncluded * alldata->misc.nDims + 1] = alldata->points.points[iPointLayer * alldata->points.nColsPoints
-                + alldata->points.elevAngleCol];
-            // copy nyquist interval from the 'points' array
-            yNyquist[iPointIncluded] = alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.nyquistCol];
-            // copy the observed vrad value at this [azimuth, elevation]
-            yObs[iPointIncluded] = alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.vradValueCol];
-            // copy the dealiased vrad value at this [azimuth, elevation]
-            yDealias[iPointIncluded] = alldata->points.points[iPointLayer * alldata->points.nColsPoints + alldata->points.vraddValueCol];
-            // pre-allocate the fitted vrad value at this [azimuth,elevation]
-            yFitted[iPointIncluded] = 0.0f;
-            // keep a record of which index was just included
-            includedIndex[iPointIncluded] = iPointLayer;
-            // raise the counter
-            iPointIncluded += 1;
+} // calcProfileLayer
 
-          }
-        } // endfor (iPointLayer = 0; iPointLayer < nPointsLayer; iPointLayer++) {
-        nPointsIncluded = iPointIncluded;
 
-        // check if there are directions that have almost no observations
-        // (as this makes the svdfit result really uncertain)
-        hasGap = hasAzimuthGap(&pointsSelection[0], nPointsIncluded, alldata);
 
-        if (alldata->options.fitVrad == TRUE) {
+static void calcLayerProfiles(vol2bird_t *alldata, vol2birdScratch_t* scratch, const int iLayer, const int nPasses) {
 
-          if (hasGap == FALSE) {
+  // ------------------------------------------------------------- //
+  // calculate profile types 3 and 1 of a single altitude layer,   //
+  // selecting the gates of both in one pass over the layer. Type  //
+  // 3 goes first, as type 1 needs its scatterersAreNotBirds.      //
+  // Layers only touch their own rows of 'points' and of the       //
+  // profiles, such that different layers can be calculated in     //
+  // parallel, each with its own 'scratch' buffers                 //
+  // ------------------------------------------------------------- //
 
-            // ------------------------------------------------------------- //
-            //                  dealias radial velocities                    //
-            // ------------------------------------------------------------- //
+  int iGate;
 
-            // dealias velocities if requested by user
-            // only dealias in first pass (later passes for removing dual-PRF dealiasing errors,
-            // which show smaller offsets than (2*nyquist velocity) and therefore are not
-            // removed by dealiasing routine)
-            // The condition nyquistMinUsed<maxNyquistDealias enforces that if all scans
-            // have a higher Nyquist velocity than maxNyquistDealias, dealiasing is suppressed
-            if (alldata->options.dealiasVrad && iPass == 0 && !recycleDealias) {
-#ifdef FPRINTFON
-              vol2bird_err_printf("dealiasing %i points for profile %i, layer %i ...\n",nPointsIncluded,iProfileType,iLayer+1);
+  // the buffers are sized for the largest layer in vol2birdSetUp(),
+  // so this should not happen
+  if (alldata->points.nPointsWritten[iLayer] > scratch->nPointsMax) {
+    freeScratch(scratch);
+    int nAllocations = allocateScratch(scratch, alldata->points.nPointsWritten[iLayer], alldata);
+    if (nAllocations < 0) {
+      return;
+    }
+#ifdef _OPENMP
+    #pragma omp atomic
 #endif
-              int result = dealias_points(&pointsSelection[0], alldata->misc.nDims, &yNyquist[0], alldata->misc.nyquistMin, &yObs[0], &yDealias[0],
-                  nPointsIncluded);
-              // store dealiased velocities in points array (for re-use when iPass>0)
-              for (int i = 0; i < nPointsIncluded; i++) {
-                alldata->points.points[includedIndex[i] * alldata->points.nColsPoints + alldata->points.vraddValueCol] = yDealias[i];
-              }
-
-              if (result == 0) {
-                vol2bird_err_printf( "Warning, failed to dealias radial velocities");
-              }
-            }
-
-            //print the dealiased values to stderr
-            if (alldata->options.printDealias == TRUE) {
-              printDealias(&pointsSelection[0], alldata->misc.nDims, &yNyquist[0], &yObs[0], &yDealias[0], nPointsIncluded, iProfileType, iLayer + 1,
-                  iPass + 1);
-            }
-
-            // yDealias is initialized to yObs, so we can always run svdfit
-            // on yDealias, even when not running a dealiasing routine
-            yObsSvdFit = yDealias;
-
-            // ------------------------------------------------------------- //
-            //                       do the svdfit                           //
-            // ------------------------------------------------------------- //
-
-            chisq = svdfit(&pointsSelection[0], alldata->misc.nDims, &yObsSvdFit[0], &yFitted[0], nPointsIncluded, &parameterVector[0], &avar[0],
-                alldata->misc.nParsFitted);
-
-            if (chisq < alldata->constants.chisqMin) {
-              // the standard deviation of the fit is too low, as in the case of overfit
-              // reset parameter vector array elements to NAN and continue with the next layer
-              parameterVector[0] = NAN;
-              parameterVector[1] = NAN;
-              parameterVector[2] = NAN;
-              // FIXME: if this happens, profile fields are not updated from UNDETECT to NODATA
-            } else {
+    alldata->misc.nProfileAllocations += nAllocations;
+  }
 
-              chi = sqrt(chisq);
-              hSpeed = sqrt(pow(parameterVector[0], 2) + pow(parameterVector[1], 2));
-              hDir = (atan2(parameterVector[0], parameterVector[1]) * RAD2DEG);
-
-              if (hDir < 0) {
-                hDir += 360.0f;
-              }
-
-              // if the fitted vrad value is more than 'absVDifMax' away from the corresponding
-              // observed vrad value, set the gate's flagPositionVDifMax bit flag to 1, excluding the
-              // gate in the second svdfit iteration
-              updateFlagFieldsInPointsArray(&yObsSvdFit[0], &yFitted[0], &includedIndex[0], nPointsIncluded, &(alldata->points.points[0]), alldata);
-
-            }
-
-          } // endif (hasGap == FALSE)
-
-        }; // endif (fitVrad == TRUE)
-
-        //---------------------------------------------//
-        //         Fill the profile arrays             //
-        //---------------------------------------------//
-
-        // always fill below profile fields, these never have a NODATA or UNDETECT value.
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 0] = iLayer * alldata->options.layerThickness;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 1] = (iLayer + 1) * alldata->options.layerThickness;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 8] = (float) hasGap;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 10] = (float) nPointsIncluded;
-        alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 13] = (float) nPointsIncludedZ;
-
-        // fill below profile fields when (1) VVP fit was not performed because of azimuthal data gap
-        // and (2) layer contains range gates within the volume sampled by the radar.
-        if (hasGap && nPointsIncludedZ > alldata->constants.nPointsIncludedMin) {
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 2] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 3] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 4] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 5] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 6] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 7] = UNDETECT;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 9] = dbzAvg;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 11] = reflectivity;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 12] = birdDensity;
-        }
-        // case of valid fit, fill profile fields with VVP fit parameters
-        if (!hasGap) {
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 2] = parameterVector[0];
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 3] = parameterVector[1];
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 4] = parameterVector[2];
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 5] = hSpeed;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 6] = hDir;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 7] = chi;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 9] = dbzAvg;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 11] = reflectivity;
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 12] = birdDensity;
-        }
-
-        free((void*) yObs);
-        free((void*) yFitted);
-        free((void*) yNyquist);
-        free((void*) yDealias);
-        free((void*) pointsSelection);
-        free((void*) includedIndex);
-
-      } // endfor (iPass = 0; iPass < nPasses; iPass++)
-      // You need some of the results of iProfileType == 3 in order
-      // to calculate iProfileType == 1, therefore iProfileType == 3 is executed first
-      if (iProfileType == 3) {
-        // NOTE: chi can have NAN or numeric value at this point
-        // when NAN, below condition evaluates to FALSE, i.e. scatterersAreNotBirds is set to FALSE
-        if (chi < alldata->options.stdDevMinBird) {
-          alldata->misc.scatterersAreNotBirds[iLayer] = TRUE;
-        } else {
-          alldata->misc.scatterersAreNotBirds[iLayer] = FALSE;
-        }
-      }
-      if (iProfileType == 1) {
-        // set the bird density to zero if radial velocity stdev below threshold:
-        if (alldata->misc.scatterersAreNotBirds[iLayer] == TRUE) {
-          alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 12] = 0.0;
-        }
-      }
+  selectLayerGates(alldata, iLayer, &(scratch->gates1), &(scratch->gates3));
+
+  calcProfileLayer(alldata, scratch, &(scratch->gates3), 3, iLayer, nPasses, FALSE, alldata->profiles.profile3);
+
+  // set a flag that indicates if we want to keep the dealiased values of profile type 3
+  int recycleDealias = alldata->options.dealiasRecycle ? TRUE : FALSE;
+
+  // reset the flagPositionVDifMax bit and, unless recycled, the dealiased vrad
+  // value of the gates of profile type 3, the only ones it may have changed
+  for (iGate = 0; iGate < scratch->gates3.nIndex; iGate++) {
+    int iPoint = scratch->gates3.index[iGate];
+    alldata->points.gateCode[iPoint] &= ~(1 << (alldata->flags.flagPositionVDifMax));
+    if (!recycleDealias) {
+      alldata->points.vraddValue[iPoint] = alldata->points.vradValue[iPoint];
+    }
+  }
+
+  calcProfileLayer(alldata, scratch, &(scratch->gates1), 1, iLayer, nPasses, recycleDealias, alldata->profiles.profile1);
+
+} // calcLayerProfiles
+
+
+void vol2birdCalcProfiles(vol2bird_t *alldata) {
+
+  int nPasses;
+  int iLayer;
+  int iProfileType;
+
+  if (alldata->misc.initializationSuccessful == FALSE) {
+    vol2bird_err_printf( "You need to initialize vol2bird before you can use it. Aborting.\n");
+    return;
+  }
+
+  // count the volumes, to tell which fitted winds in 'dealiasSeed' belong to this volume
+  alldata->misc.iVolume += 1;
+
+  // ------------------------------------------------------------- //
+  //                        prepare the profiles                   //
+  //                                                               //
+  // iProfileType == 1: birds                                      //
+  // iProfileType == 2: non-birds                                  //
+  // iProfileType == 3: birds+non-birds                            //
+  //                                                               //
+  // profile types 3 and 1 are calculated together for each layer, //
+  // see calcLayerProfiles()                                       //
+  // ------------------------------------------------------------- //
+
+  // FIXME: we better get rid of ProfileType==2 altogether, it is
+  // never calculated
+
+  // if the user does not require fitting a model to the observed
+  // vrad values, we don't need a second pass to remove dealiasing outliers
+  if (alldata->options.fitVrad == TRUE) {
+    nPasses = 2;
+  } else {
+    nPasses = 1;
+  }
 
+  // layers are independent, so they may be calculated in parallel threads.
+  // Printing of dealiased values is kept sequential to keep the output ordered
+  int nThreads = alldata->options.printDealias ? 1 : alldata->options.nThreads;
+
+  if (alldata->options.dealiasSeed == TRUE) {
+    // calculate chunks of consecutive layers in parallel, and the layers
+    // of a chunk in order, such that they can start dealiasing from the
+    // layer below
+    int nChunks = (alldata->options.nLayers + DEALIAS_SEED_NLAYERS - 1) / DEALIAS_SEED_NLAYERS;
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic,1) num_threads(nThreads) if(nThreads > 1)
+#endif
+    for (int iChunk = 0; iChunk < nChunks; iChunk++) {
+      int iScratch = 0;
+#ifdef _OPENMP
+      iScratch = omp_get_thread_num();
+#endif
+      for (int iLayerChunk = iChunk * DEALIAS_SEED_NLAYERS;
+           iLayerChunk < (iChunk + 1) * DEALIAS_SEED_NLAYERS && iLayerChunk < alldata->options.nLayers; iLayerChunk++) {
+        calcLayerProfiles(alldata, &(alldata->misc.scratch[iScratch]), iLayerChunk, nPasses);
+      }
+    } // endfor (iChunk = 0; iChunk < nChunks; iChunk++)
+  } else {
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic,1) num_threads(nThreads) if(nThreads > 1)
+#endif
+    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+      int iScratch = 0;
+#ifdef _OPENMP
+      iScratch = omp_get_thread_num();
+#endif
+      calcLayerProfiles(alldata, &(alldata->misc.scratch[iScratch]), iLayer, nPasses);
     } // endfor (iLayer = 0; iLayer < nLayers; iLayer++)
+  }
+
+  // printProfile() and exportBirdProfileAsJSON() read 'profile', which is
+  // left holding profile type 1, as the last profile that was calculated
+  const size_t profileSize = sizeof(float) * alldata->profiles.nRowsProfile * alldata->profiles.nColsProfile;
+  for (iProfileType = 3; iProfileType > 0; iProfileType -= 2) {
+
+    alldata->profiles.iProfileTypeLast = iProfileType;
+    memcpy(alldata->profiles.profile, iProfileType == 3 ? alldata->profiles.profile3 : alldata->profiles.profile1, profileSize);
 
     if (alldata->options.printProfileVar == TRUE) {
       printProfile(alldata);
@@ -4381,34 +6208,12 @@ void vol2birdCalcProfiles(vol2bird_t *alldata) {
     if (iProfileType == 1 && alldata->options.exportBirdProfileAsJSONVar == TRUE) {
       exportBirdProfileAsJSON(alldata);
     }
+  }
 
-    // ---------------------------------------------------------------- //
-    //       this next section is a bit ugly but it does the job        //
-    // ---------------------------------------------------------------- //
-
-    int iCopied = 0;
-    int iColProfile;
-    int iRowProfile;
-    for (iRowProfile = 0; iRowProfile < alldata->profiles.nRowsProfile; iRowProfile++) {
-      for (iColProfile = 0; iColProfile < alldata->profiles.nColsProfile; iColProfile++) {
-        switch (iProfileType) {
-        case 1:
-          alldata->profiles.profile1[iCopied] = alldata->profiles.profile[iCopied];
-          break;
-        case 2:
-          alldata->profiles.profile2[iCopied] = alldata->profiles.profile[iCopied];
-          break;
-        case 3:
-          alldata->profiles.profile3[iCopied] = alldata->profiles.profile[iCopied];
-          break;
-        default:
-          vol2bird_err_printf( "Something is wrong this should not happen.\n");
-        }
-        iCopied += 1;
-      }
-    }
-
-  } // endfor (iProfileType = nProfileTypes; iProfileType > 0; iProfileType--)
+#ifdef FPRINTFON
+  vol2bird_err_printf("allocated %ld working buffers during set up, %ld while calculating the profiles\n",
+    alldata->misc.nScratchAllocations, alldata->misc.nProfileAllocations);
+#endif
 
 } // vol2birdCalcProfiles
 
@@ -4493,6 +6298,8 @@ void vol2birdPrintOptions(vol2bird_t* alldata) {
     vol2bird_err_printf("%-25s = %f\n","azimMax",alldata->options.azimMax);
     vol2bird_err_printf("%-25s = %f\n","azimMin",alldata->options.azimMin);
     vol2bird_err_printf("%-25s = %f\n","birdRadarCrossSection",alldata->options.birdRadarCrossSection);
+    vol2bird_err_printf("%-25s = %s\n","cacheDir",alldata->options.cacheDir);
+    vol2bird_err_printf("%-25s = %f\n","cacheSizeMax",alldata->options.cacheSizeMax);
     vol2bird_err_printf("%-25s = %f\n","cellClutterFractionMax",alldata->constants.cellClutterFractionMax);
     vol2bird_err_printf("%-25s = %f\n","cellEtaMin",alldata->options.cellEtaMin);
     vol2bird_err_printf("%-25s = %f\n","cellStdDevMax",alldata->options.cellStdDevMax);
@@ -4501,10 +6308,12 @@ void vol2birdPrintOptions(vol2bird_t* alldata) {
     vol2bird_err_printf("%-25s = %f\n","etaMax",alldata->options.etaMax);
     vol2bird_err_printf("%-25s = %f\n","dbzThresMin",alldata->options.dbzThresMin);
     vol2bird_err_printf("%-25s = %s\n","dbzType",alldata->options.dbzType);
+    vol2bird_err_printf("%-25s = %d\n","dealiasSeed",alldata->options.dealiasSeed);
+    vol2bird_err_printf("%-25s = %f\n","dealiasSeedCostMax",alldata->options.dealiasSeedCostMax);
     vol2bird_err_printf("%-25s = %f\n","elevMax",alldata->options.elevMax);
     vol2bird_err_printf("%-25s = %f\n","elevMin",alldata->options.elevMin);
     vol2bird_err_printf("%-25s = %d\n","fitVrad",alldata->options.fitVrad);
-    vol2bird_err_printf("%-25s = %f\n","fringeDist",alldata->constants.fringeDist);
+    vol2bird_err_printf("%-25s = %f\n","fringeDist",alldata->options.fringeDist);
     vol2bird_err_printf("%-25s = %f\n","layerThickness",alldata->options.layerThickness);
     vol2bird_err_printf("%-25s = %f\n","minNyquist",alldata->options.minNyquist);
     vol2bird_err_printf("%-25s = %f\n","areaCellMin",alldata->constants.areaCellMin);
@@ -4515,6 +6324,7 @@ void vol2birdPrintOptions(vol2bird_t* alldata) {
     vol2bird_err_printf("%-25s = %d\n","nObsGapMin",alldata->constants.nObsGapMin);
     vol2bird_err_printf("%-25s = %d\n","nPointsIncludedMin",alldata->constants.nPointsIncludedMin);
     vol2bird_err_printf("%-25s = %d\n","nRangNeighborhood",alldata->constants.nRangNeighborhood);
+    vol2bird_err_printf("%-25s = %d\n","nThreads",alldata->options.nThreads);
     vol2bird_err_printf("%-25s = %f\n","radarWavelength",alldata->options.radarWavelength);
     vol2bird_err_printf("%-25s = %f\n","rangeMax",alldata->options.rangeMax);
     vol2bird_err_printf("%-25s = %f\n","rangeMin",alldata->options.rangeMin);
@@ -4524,6 +6334,7 @@ void vol2birdPrintOptions(vol2bird_t* alldata) {
     vol2bird_err_printf("%-25s = %f\n","stdDevMinBird",alldata->options.stdDevMinBird);
     vol2bird_err_printf("%-25s = %c\n","useClutterMap",alldata->options.useClutterMap == TRUE ? 'T' : 'F');
     vol2bird_err_printf("%-25s = %f\n","vradMin",alldata->constants.vradMin);
+    vol2bird_err_printf("%-25s = %d\n","vvpClosedForm",alldata->options.vvpClosedForm);
     
     vol2bird_err_printf("\n\n");
 
@@ -4548,24 +6359,24 @@ void vol2birdPrintPointsArray(vol2bird_t* alldata) {
     
     vol2bird_err_printf( "iPoint    range     azim    elev         dbz        vrad    cell    gateCode   flags           nyquist     vradd        clut\n");
     
-    for (iPoint = 0; iPoint < alldata->points.nRowsPoints * alldata->points.nColsPoints; iPoint+=alldata->points.nColsPoints) {
+    for (iPoint = 0; iPoint < alldata->points.nRowsPoints; iPoint++) {
         
             char gateCodeStr[10];  // 9 bits plus 1 position for the null character '\0'
             
-            printGateCode(&gateCodeStr[0], (int) alldata->points.points[iPoint + alldata->points.gateCodeCol]);
+            printGateCode(&gateCodeStr[0], (int) alldata->points.gateCode[iPoint]);
         
-            vol2bird_err_printf( "  %6d",    iPoint/alldata->points.nColsPoints);
-            vol2bird_err_printf( "  %6.1f",  alldata->points.points[iPoint + alldata->points.rangeCol]);
-            vol2bird_err_printf( "  %6.2f",  alldata->points.points[iPoint + alldata->points.azimAngleCol]);
-            vol2bird_err_printf( "  %6.2f",  alldata->points.points[iPoint + alldata->points.elevAngleCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.dbzValueCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.vradValueCol]);
-            vol2bird_err_printf( "  %6.0f",  alldata->points.points[iPoint + alldata->points.cellValueCol]);
-            vol2bird_err_printf( "  %8.0f",  alldata->points.points[iPoint + alldata->points.gateCodeCol]);
+            vol2bird_err_printf( "  %6d",    iPoint);
+            vol2bird_err_printf( "  %6.1f",  alldata->points.range[iPoint]);
+            vol2bird_err_printf( "  %6.2f",  alldata->points.azimAngle[iPoint]);
+            vol2bird_err_printf( "  %6.2f",  alldata->points.elevAngle[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.dbzValue[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.vradValue[iPoint]);
+            vol2bird_err_printf( "  %6.0f",  alldata->points.cellValue[iPoint]);
+            vol2bird_err_printf( "  %8.0f",  (float) alldata->points.gateCode[iPoint]);
             vol2bird_err_printf( "  %12s",   gateCodeStr);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.nyquistCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.vraddValueCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.clutValueCol]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.nyquist[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.vraddValue[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.clutValue[iPoint]);
             vol2bird_err_printf( "\n");
     }    
 } // vol2birdPrintPointsArray
@@ -4583,17 +6394,17 @@ void vol2birdPrintPointsArraySimple(vol2bird_t* alldata) {
     
     vol2bird_err_printf( "iPoint  azim    elev    dbz         vrad        cell     flags     nyquist vradd\n");
     
-    for (iPoint = 0; iPoint < alldata->points.nRowsPoints * alldata->points.nColsPoints; iPoint+=alldata->points.nColsPoints) {
+    for (iPoint = 0; iPoint < alldata->points.nRowsPoints; iPoint++) {
                 
-            vol2bird_err_printf( "  %6d",    iPoint/alldata->points.nColsPoints);
-            vol2bird_err_printf( "  %6.2f",  alldata->points.points[iPoint + alldata->points.azimAngleCol]);
-            vol2bird_err_printf( "  %6.2f",  alldata->points.points[iPoint + alldata->points.elevAngleCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.dbzValueCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.vradValueCol]);
-            vol2bird_err_printf( "  %6.0f",  alldata->points.points[iPoint + alldata->points.cellValueCol]);
-            vol2bird_err_printf( "  %8.0f",  alldata->points.points[iPoint + alldata->points.gateCodeCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.nyquistCol]);
-            vol2bird_err_printf( "  %10.2f", alldata->points.points[iPoint + alldata->points.vraddValueCol]);
+            vol2bird_err_printf( "  %6d",    iPoint);
+            vol2bird_err_printf( "  %6.2f",  alldata->points.azimAngle[iPoint]);
+            vol2bird_err_printf( "  %6.2f",  alldata->points.elevAngle[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.dbzValue[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.vradValue[iPoint]);
+            vol2bird_err_printf( "  %6.0f",  alldata->points.cellValue[iPoint]);
+            vol2bird_err_printf( "  %8.0f",  (float) alldata->points.gateCode[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.nyquist[iPoint]);
+            vol2bird_err_printf( "  %10.2f", alldata->points.vraddValue[iPoint]);
             vol2bird_err_printf( "\n");
     }    
 } // vol2birdPrintPointsArray
@@ -4634,45 +6445,541 @@ void printProfile(vol2bird_t* alldata) {
         alldata->profiles.profile[iLayer * alldata->profiles.nColsProfile + 13]);
     }
 
-    
-} // printProfile()
+    
+} // printProfile()
+
+
+
+static void printScanImages(PolarScan_t* scan, vol2birdScanUse_t scanUse, vol2bird_t* alldata) {
+
+    // print the images of the scan that were selected in the options
+
+    if (alldata->options.printDbz == TRUE) {
+        vol2bird_err_printf("product = dbz\n");
+        printMeta(scan,scanUse.dbzName);
+        printImage(scan,scanUse.dbzName);
+    }
+    if (alldata->options.printVrad == TRUE) {
+        vol2bird_err_printf("product = vrad\n");
+        printMeta(scan,scanUse.vradName);
+        printImage(scan,scanUse.vradName);
+    }
+    if (alldata->options.printRhohv == TRUE) {
+        vol2bird_err_printf("product = rhohv\n");
+        printMeta(scan,scanUse.rhohvName);
+        printImage(scan,scanUse.rhohvName);
+    }
+    if (alldata->options.printTex == TRUE) {
+        vol2bird_err_printf("product = tex\n");
+        printMeta(scan,scanUse.texName);
+        printImage(scan,scanUse.texName);
+    }
+    if (alldata->options.printCell == TRUE) {
+        vol2bird_err_printf("product = cell\n");
+        printMeta(scan,scanUse.cellName);
+        printImage(scan,scanUse.cellName);
+    }
+    if (alldata->options.printClut == TRUE) { 
+        vol2bird_err_printf("product = clut\n");
+        printMeta(scan,scanUse.clutName);
+        printImage(scan,scanUse.clutName);
+    }
+
+} // printScanImages
+
+// returns TRUE when determineScanUse() is certain to drop the scan based on its metadata
+// alone: its elevation, range bin size or Nyquist interval attribute. Scans for which
+// this returns FALSE may still be dropped once their data is inspected.
+static int isScanUnused(PolarVolume_t* volume, PolarScan_t* scan, vol2bird_t* alldata) {
+
+    double elev = 360*PolarScan_getElangle(scan) / 2 / PI;
+    if (elev < alldata->options.elevMin || elev > alldata->options.elevMax) {
+        return TRUE;
+    }
+
+    double rscale = PolarScan_getRscale(scan);
+    if (rscale < RSCALEMIN || rscale == 0) {
+        return TRUE;
+    }
+
+    // Nyquist interval from the scan how group, or else from the top level how group
+    double nyquist = 0;
+    int result = 0;
+    RaveAttribute_t* attr = PolarScan_getAttribute(scan, "how/NI");
+    if (attr != (RaveAttribute_t *) NULL) result = RaveAttribute_getDouble(attr, &nyquist);
+    RAVE_OBJECT_RELEASE(attr);
+
+    if (result == 0 && volume != NULL) {
+        attr = PolarVolume_getAttribute(volume, "how/NI");
+        if (attr != (RaveAttribute_t *) NULL) result = RaveAttribute_getDouble(attr, &nyquist);
+        RAVE_OBJECT_RELEASE(attr);
+    }
+
+    if (result != 0 && nyquist < alldata->options.minNyquist) {
+        return TRUE;
+    }
+
+    return FALSE;
+
+} // isScanUnused
+
+
+
+// accesses the data of all parameters and quality fields of the scan, such that lazily read datasets are
+// decoded now instead of by whichever function first uses them
+static void loadScanData(PolarScan_t* scan) {
+
+    RaveList_t* paramNames = PolarScan_getParameterNames(scan);
+    int nParams = RaveList_size(paramNames);
+    int iParam;
+
+    int iField;
+
+    for (iParam = 0; iParam < nParams; iParam++) {
+        PolarScanParam_t* param = PolarScan_getParameter(scan, RaveList_get(paramNames, iParam));
+        PolarScanParam_getData(param);
+        for (iField = 0; iField < PolarScanParam_getNumberOfQualityFields(param); iField++) {
+            RaveField_t* field = PolarScanParam_getQualityField(param, iField);
+            RaveField_getData(field);
+            RAVE_OBJECT_RELEASE(field);
+        }
+        RAVE_OBJECT_RELEASE(param);
+    }
+
+    for (iField = 0; iField < PolarScan_getNumberOfQualityFields(scan); iField++) {
+        RaveField_t* field = PolarScan_getQualityField(scan, iField);
+        RaveField_getData(field);
+        RAVE_OBJECT_RELEASE(field);
+    }
+
+    RaveList_freeAndDestroy(&paramNames);
+
+} // loadScanData
+
+
+
+// removes the scan parameters that are not in the comma separated list 'quantities',
+// such that lazily loaded datasets that we do not use are never read
+static void removeUnlistedQuantities(PolarScan_t* scan, const char* quantities) {
+
+    if (quantities == NULL) {
+        return;
+    }
+
+    RaveList_t* paramNames = PolarScan_getParameterNames(scan);
+    int nParams = RaveList_size(paramNames);
+    int iParam;
+
+    for (iParam = 0; iParam < nParams; iParam++) {
+        const char* quantity = (const char*) RaveList_get(paramNames, iParam);
+        size_t len = strlen(quantity);
+        const char* listed = quantities;
+        int isListed = FALSE;
+
+        while (listed != NULL && *listed != '\0') {
+            if (strncmp(listed, quantity, len) == 0 && (listed[len] == ',' || listed[len] == '\0')) {
+                isListed = TRUE;
+                break;
+            }
+            listed = strchr(listed, ',');
+            if (listed != NULL) {
+                listed++;
+            }
+        }
+
+        if (!isListed) {
+            PolarScanParam_t* param = PolarScan_removeParameter(scan, quantity);
+            RAVE_OBJECT_RELEASE(param);
+        }
+    }
+
+    RaveList_freeAndDestroy(&paramNames);
+
+} // removeUnlistedQuantities
+
+
+
+// --------------------------------------------------------------------------------------- //
+// Copies the first nbinsKeep range bins of each of the nrays rays of a polar data array   //
+// into a newly allocated array. The returned array must be freed by the caller.           //
+// --------------------------------------------------------------------------------------- //
+static void* truncateRangeBins(void* data, const long nbins, const long nrays, const long nbinsKeep, const RaveDataType type) {
+
+    int elemSize = get_ravetype_size(type);
+
+    if (data == NULL || elemSize <= 0) {
+        return NULL;
+    }
+
+    char* dataKeep = malloc((size_t) nbinsKeep * nrays * elemSize);
+
+    if (dataKeep == NULL) {
+        return NULL;
+    }
+
+    long iRay;
+    for (iRay = 0; iRay < nrays; iRay++) {
+        memcpy(&dataKeep[iRay * nbinsKeep * elemSize], &((char*) data)[iRay * nbins * elemSize], nbinsKeep * elemSize);
+    }
+
+    return (void*) dataKeep;
+
+} // truncateRangeBins
+
+
+
+// quality fields of polar data are stored as x = range bins, y = rays
+static int truncateFieldRange(RaveField_t* field, const long nbins, const long nrays, const long nbinsKeep) {
+
+    if (RaveField_getXsize(field) != nbins || RaveField_getYsize(field) != nrays) {
+        return 0;
+    }
+
+    RaveDataType type = RaveField_getDataType(field);
+    void* fieldData = truncateRangeBins(RaveField_getData(field), nbins, nrays, nbinsKeep, type);
+    int result = 0;
+
+    if (fieldData == NULL || !RaveField_setData(field, nbinsKeep, nrays, fieldData, type)) {
+        vol2bird_err_printf("Error: failed to truncate quality field to %li range bins\n", nbinsKeep);
+        result = -1;
+    }
+    free(fieldData);
+
+    return result;
+
+} // truncateFieldRange
+
+
+
+// --------------------------------------------------------------------------------------- //
+// Drops the range bins beyond rangeMax from all parameters and quality fields of a scan,  //
+// so that we only hold (and process) the part of the scan used by the analysis. The      //
+// dimensions of the scan are left unchanged when any of the truncations fails.           //
+// --------------------------------------------------------------------------------------- //
+static int truncateScanRange(PolarScan_t* scan, const float rangeMax) {
+
+    double rscale = PolarScan_getRscale(scan);
+    long nbins = PolarScan_getNbins(scan);
+    long nrays = PolarScan_getNrays(scan);
+
+    if (rscale <= 0 || rangeMax <= 0) {
+        return 0;
+    }
+
+    // keep the last bin that is partly within range
+    long nbinsKeep = (long) ceil(rangeMax / rscale);
+
+    if (nbinsKeep >= nbins) {
+        return 0;
+    }
+
+    RaveList_t* paramNames = PolarScan_getParameterNames(scan);
+    int nParams = RaveList_size(paramNames);
+    int nFields = PolarScan_getNumberOfQualityFields(scan);
+    int iParam;
+    int iField;
+    int result = 0;
+
+    // truncate into new arrays first, such that nothing changes on failure
+    PolarScanParam_t* params[nParams];
+    void* paramData[nParams];
+
+    for (iParam = 0; iParam < nParams; iParam++) {
+        params[iParam] = PolarScan_getParameter(scan, RaveList_get(paramNames, iParam));
+        paramData[iParam] = truncateRangeBins(PolarScanParam_getData(params[iParam]), nbins, nrays, nbinsKeep,
+                                              PolarScanParam_getDataType(params[iParam]));
+        if (paramData[iParam] == NULL) {
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        PolarScan_removeAllParameters(scan);
+        for (iParam = 0; iParam < nParams; iParam++) {
+            if (!PolarScanParam_setData(params[iParam], nbinsKeep, nrays, paramData[iParam],
+                                        PolarScanParam_getDataType(params[iParam])) ||
+                !PolarScan_addParameter(scan, params[iParam])) {
+                vol2bird_err_printf("Error: failed to truncate scan parameter %s to %li range bins\n",
+                                    PolarScanParam_getQuantity(params[iParam]), nbinsKeep);
+                result = -1;
+                continue;
+            }
+            for (iField = 0; iField < PolarScanParam_getNumberOfQualityFields(params[iParam]); iField++) {
+                RaveField_t* field = PolarScanParam_getQualityField(params[iParam], iField);
+                if (truncateFieldRange(field, nbins, nrays, nbinsKeep) != 0) {
+                    result = -1;
+                }
+                RAVE_OBJECT_RELEASE(field);
+            }
+        }
+    }
+    else {
+        vol2bird_err_printf("Error: failed to allocate memory for truncating scan to %li range bins\n", nbinsKeep);
+    }
+
+    for (iParam = 0; iParam < nParams; iParam++) {
+        free(paramData[iParam]);
+        RAVE_OBJECT_RELEASE(params[iParam]);
+    }
+    RaveList_freeAndDestroy(&paramNames);
+
+    if (result != 0) {
+        return result;
+    }
+
+    for (iField = 0; iField < nFields; iField++) {
+        RaveField_t* field = PolarScan_getQualityField(scan, iField);
+        if (truncateFieldRange(field, nbins, nrays, nbinsKeep) != 0) {
+            result = -1;
+        }
+        RAVE_OBJECT_RELEASE(field);
+    }
+
+    return result;
+
+} // truncateScanRange
+
+
+
+static int truncateVolumeRange(PolarVolume_t* volume, const float rangeMax) {
+
+    int iScan;
+    int nScans = PolarVolume_getNumberOfScans(volume);
+
+    for (iScan = 0; iScan < nScans; iScan++) {
+        PolarScan_t* scan = PolarVolume_getScan(volume, iScan);
+        int result = truncateScanRange(scan, rangeMax);
+        RAVE_OBJECT_RELEASE(scan);
+        if (result != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+
+} // truncateVolumeRange
+
+
+
+// reads a polar volume from file and returns it as a RAVE polar volume object
+// remember to release the polar volume object when done with it
+PolarVolume_t* vol2birdGetVolume(char* filenames[], int nInputFiles, float rangeMax, int small){
+
+    return vol2birdGetVolumeSelected(filenames, nInputFiles, rangeMax, small, NULL);
+
+}
+
+// as vol2birdGetVolume, but only reads what vol2birdCalcProfiles needs from ODIM files:
+// the quantities in alldata->misc.quantities, and only the data of the scans that pass
+// the metadata checks of determineScanUse(). NULL alldata reads everything.
+PolarVolume_t* vol2birdGetVolumeSelected(char* filenames[], int nInputFiles, float rangeMax, int small, vol2bird_t* alldata){
+    
+    PolarVolume_t* volume = NULL;
+    
+    #ifdef IRIS
+    // test whether the file is in IRIS format
+    if (isIRIS(filenames[0])==0){
+        volume = vol2birdGetIRISVolume(filenames, nInputFiles, rangeMax);
+        goto done;
+    }
+    #endif
+
+    // not a rave complient file, attempt to read the file with the RSL library instead
+    #ifdef RSL
+    if(RSL_filetype(filenames[0]) != UNKNOWN){
+        if (nInputFiles > 1){
+            vol2bird_err_printf("Multiple input files detected in RSL format. Only single polar volume file import supported, using file %s only.\n", filenames[0]);
+        }
+        volume = vol2birdGetRSLVolume(filenames[0], rangeMax, small);
+        goto done;
+    }
+    #endif
+    
+    volume = vol2birdGetODIMVolume(filenames, nInputFiles, rangeMax, alldata);
+
+    if (volume != NULL) {
+      PolarVolume_sortByElevations(volume,1);
+    }
+done:
+    return volume;
+}
+
+
+// ---------------------------------------------------------------------------- //
+// Copies 'size' bytes from 'buffer' into an anonymous file that only lives in //
+// memory (memfd), and stores a path by which the readers of the radar data    //
+// formats can open it in 'path'. Where anonymous memory files are not         //
+// available, the buffer is written to a temporary file in $TMPDIR instead,    //
+// which is removed by closeMemoryFile once the data has been decoded.         //
+// Returns the file descriptor, or -1 on failure.                              //
+// ---------------------------------------------------------------------------- //
+static int openMemoryFile(const void* buffer, const size_t size, char* path, const size_t pathSize) {
+
+    int fd;
+    size_t nWritten = 0;
+
+#ifdef SYS_memfd_create
+    fd = syscall(SYS_memfd_create, "vol2bird", 0);
+    if (fd >= 0) {
+        snprintf(path, pathSize, "/proc/self/fd/%i", fd);
+    }
+#else
+    const char* tmpdir = getenv("TMPDIR");
+    snprintf(path, pathSize, "%s/vol2birdXXXXXX", tmpdir == NULL ? "/tmp" : tmpdir);
+    fd = mkstemp(path);
+#endif
+
+    if (fd < 0) {
+        vol2bird_err_printf("Error: failed to create a file in memory for the input buffer\n");
+        return -1;
+    }
+
+    while (nWritten < size) {
+        ssize_t n = write(fd, (const char*) buffer + nWritten, size - nWritten);
+        if (n <= 0) {
+            vol2bird_err_printf("Error: failed to copy the input buffer into a file in memory\n");
+            closeMemoryFile(fd, path);
+            return -1;
+        }
+        nWritten += n;
+    }
+
+    return fd;
+
+} // openMemoryFile
+
+
+
+static void closeMemoryFile(const int fd, const char* path) {
+
+#ifndef SYS_memfd_create
+    unlink(path);
+#endif
+    close(fd);
+
+} // closeMemoryFile
+
+
+
+#ifdef RSL
+// determines the radar call sign that RSL needs to read NEXRAD data: from the
+// name of the data as for files, or otherwise from the volume header of a
+// NEXRAD Level II file, which is decompressed first when the data is gzipped.
+// Returns -1 when it cannot be determined.
+static int getBufferCallid(const void* buffer, const size_t size, const char* name, char* callid) {
+
+    const unsigned char* bytes = (const unsigned char*) buffer;
+    unsigned char header[24];
+    size_t nHeader = 0;
+
+    if (name != NULL) {
+        const char* base = strrchr(name, '/');
+        base = base == NULL ? name : base + 1;
+        strncpy(callid, base, 4);
+        callid[4] = 0;
+        return 0;
+    }
+
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+        // only inflate as much as the volume header
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        stream.next_in = (Bytef*) bytes;
+        stream.avail_in = size > UINT_MAX ? UINT_MAX : (uInt) size;
+        stream.next_out = header;
+        stream.avail_out = sizeof(header);
+        // a window size of 16 + MAX_WBITS selects the gzip format
+        if (inflateInit2(&stream, 16 + MAX_WBITS) == Z_OK) {
+            int result = inflate(&stream, Z_SYNC_FLUSH);
+            if (result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR) {
+                nHeader = sizeof(header) - stream.avail_out;
+            }
+            inflateEnd(&stream);
+        }
+    }
+    else {
+        nHeader = size < sizeof(header) ? size : sizeof(header);
+        memcpy(header, bytes, nHeader);
+    }
+
+    // the volume header starts with AR2V and holds the ICAO at byte 20
+    if (nHeader == sizeof(header) && strncmp((const char*) header, "AR2V", 4) == 0) {
+        memcpy(callid, header + 20, 4);
+        callid[4] = 0;
+        return 0;
+    }
+
+    return -1;
+
+} // getBufferCallid
+#endif
+
+
 
-// reads a polar volume from file and returns it as a RAVE polar volume object
+// reads a polar volume (or scan) that is held in memory, e.g. an object fetched from
+// an object store, and returns it as a RAVE polar volume object. The data format is
+// detected as for files. 'name' is the optional file name of the data, which RSL uses
+// to determine the radar call sign of NEXRAD data. As vol2birdGetVolumeSelected, only
+// reads what vol2birdCalcProfiles needs from ODIM data, unless alldata is NULL.
 // remember to release the polar volume object when done with it
-PolarVolume_t* vol2birdGetVolume(char* filenames[], int nInputFiles, float rangeMax, int small){
-    
+PolarVolume_t* vol2birdGetVolumeFromBuffer(const void* buffer, size_t size, const char* name, float rangeMax, int small, vol2bird_t* alldata){
+
     PolarVolume_t* volume = NULL;
-    
-    #ifdef IRIS
-    // test whether the file is in IRIS format
-    if (isIRIS(filenames[0])==0){
-        volume = vol2birdGetIRISVolume(filenames, nInputFiles);
-        goto done;
+    char path[1000];
+    char* filenames[1] = {path};
+    int iScan;
+
+    if (buffer == NULL || size == 0) {
+        vol2bird_err_printf("Error: no data in input buffer\n");
+        return NULL;
+    }
+
+    // the RAVE, RSL and IRIS readers only open files by name, so we hand them
+    // the buffer as a file in memory rather than decoding it ourselves
+    int fd = openMemoryFile(buffer, size, path, sizeof(path));
+    if (fd < 0) {
+        return NULL;
     }
-    #endif
 
-    // not a rave complient file, attempt to read the file with the RSL library instead
     #ifdef RSL
-    if(RSL_filetype(filenames[0]) != UNKNOWN){
-        if (nInputFiles > 1){
-            vol2bird_err_printf("Multiple input files detected in RSL format. Only single polar volume file import supported, using file %s only.\n", filenames[0]);
+    enum File_type fileType = RSL_filetype(path);
+    int isRSL = fileType != UNKNOWN;
+    #ifdef IRIS
+    isRSL = isRSL && isIRIS(path) != 0;
+    #endif
+    char callid[5] = "";
+    if (isRSL) {
+        // RSL needs the call sign of NEXRAD data, which it would otherwise take from the name of the memory file
+        if (getBufferCallid(buffer, size, name, callid) != 0 && fileType == WSR88D_FILE) {
+            vol2bird_err_printf("Error: cannot determine the radar call sign of the NEXRAD data in the input buffer, "
+                                "pass the file name of the data\n");
+            goto done;
         }
-        volume = vol2birdGetRSLVolume(filenames[0], rangeMax, small);
+        volume = vol2birdGetRSLVolumeWithCallid(path, callid, rangeMax, small);
         goto done;
     }
     #endif
-    
-    volume = vol2birdGetODIMVolume(filenames, nInputFiles);
 
+    volume = vol2birdGetVolumeSelected(filenames, 1, rangeMax, small, alldata);
+
+    // decode what was read lazily now, the memory file is gone after this function.
+    // Unlike when reading files, this includes the scans that will not be used, such
+    // that no data of the returned volume refers to the memory file
     if (volume != NULL) {
-      PolarVolume_sortByElevations(volume,1);
+        for (iScan = 0; iScan < PolarVolume_getNumberOfScans(volume); iScan++) {
+            PolarScan_t* scan = PolarVolume_getScan(volume, iScan);
+            loadScanData(scan);
+            RAVE_OBJECT_RELEASE(scan);
+        }
     }
+
 done:
+    closeMemoryFile(fd, path);
     return volume;
 }
 
 #ifdef IRIS
-PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles) {
+PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles, float rangeMax) {
     // initialize a polar volume to return
     PolarVolume_t* output = NULL;
     // initialize helper volume and scan to store intermediate file reads
@@ -4728,6 +7035,12 @@ PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles) {
                 vol2bird_err_printf( "Error: could not populate IRIS data into a polar volume object\n");
                 goto done;
             }
+
+            // only keep the range bins we need before merging
+            if (truncateVolumeRange(volume, rangeMax) != 0) {
+                vol2bird_err_printf( "Error: could not truncate IRIS polar volume to a range of %.0f m\n", rangeMax);
+                goto done;
+            }
             
             if (!outputInitialised){
                 RAVE_OBJECT_RELEASE(output); //may have been initialized earlier above
@@ -4761,6 +7074,11 @@ PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles) {
                 vol2bird_err_printf( "Error: could not populate IRIS data into a polar scan object\n");
                 goto done;
             }
+
+            if (truncateScanRange(scan, rangeMax) != 0) {
+                vol2bird_err_printf( "Error: could not truncate IRIS polar scan to a range of %.0f m\n", rangeMax);
+                goto done;
+            }
             
             if (!outputInitialised){
                 // copy essential root metadata to volume
@@ -4793,7 +7111,7 @@ PolarVolume_t* vol2birdGetIRISVolume(char* filenames[], int nInputFiles) {
 }
 #endif
 
-PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles) {
+PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles, float rangeMax, vol2bird_t* alldata) {
     // initialize a polar volume to return
     PolarVolume_t* output = NULL;
     // initialize helper volume and scan to store intermediate file reads
@@ -4805,9 +7123,12 @@ PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles) {
     // initialize the rave object type of filename
     int rot = Rave_ObjectType_UNDEFINED;
 
+    const char* quantities = alldata == NULL ? NULL : alldata->misc.quantities;
+
     for (int i=0; i<nInputFiles; i++){
-        // read the file
-        RaveIO_t* raveio = RaveIO_open(filenames[i], 0, NULL);
+        // read the file, lazily if we only need some of the quantities such that
+        // the datasets of the other quantities are never read and decompressed
+        RaveIO_t* raveio = RaveIO_open(filenames[i], quantities != NULL, quantities);
 
         if(raveio == NULL){
             vol2bird_err_printf( "Warning: Failed to read file %s in ODIM format, ignoring.\n         "
@@ -4849,11 +7170,29 @@ PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles) {
                 RAVE_CRITICAL0("Error: could not populate ODIM data into a polarvolume object");
                 goto done;
             }
+
+            // only keep the range bins we need before merging. This is where the data
+            // of lazily read scans is decoded, which we skip for scans we will not use
+            for (int j=0; j<PolarVolume_getNumberOfScans(volume); j++){
+                int result = 0;
+                scan = PolarVolume_getScan(volume, j);
+                removeUnlistedQuantities(scan, quantities);
+                if (alldata == NULL || !isScanUnused(outputInitialised ? output : volume, scan, alldata)) {
+                    result = truncateScanRange(scan, rangeMax);
+                }
+                RAVE_OBJECT_RELEASE(scan);
+                if (result != 0) {
+                    vol2bird_err_printf( "Error: could not truncate ODIM polar volume to a range of %.0f m\n", rangeMax);
+                    RAVE_OBJECT_RELEASE(raveio);
+                    goto done;
+                }
+            }
             
             if (!outputInitialised){
                 RAVE_OBJECT_RELEASE(output); // Added by AHE. Otherwise will loose output
-                output = RAVE_OBJECT_CLONE(volume);
-                RAVE_OBJECT_RELEASE(volume);
+                // take over the volume rather than cloning it, a clone would decode all lazily read data
+                output = volume;
+                volume = NULL;
                 RAVE_OBJECT_RELEASE(raveio)
                 outputInitialised = TRUE;
                 continue;
@@ -4885,6 +7224,14 @@ PolarVolume_t* vol2birdGetODIMVolume(char* filenames[], int nInputFiles) {
                 RAVE_OBJECT_RELEASE(raveio)
                 goto done;
             }
+
+            removeUnlistedQuantities(scan, quantities);
+
+            if ((alldata == NULL || !isScanUnused(output, scan, alldata)) && truncateScanRange(scan, rangeMax) != 0) {
+                vol2bird_err_printf( "Error: could not truncate ODIM polar scan to a range of %.0f m\n", rangeMax);
+                RAVE_OBJECT_RELEASE(raveio);
+                goto done;
+            }
             
             if (!outputInitialised){
                 // copy essential root metadata to volume
@@ -4999,6 +7346,7 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     alldata->options.printProfileVar = cfg_getbool(*cfg,"PRINT_PROFILE");
     alldata->options.printPointsArray = cfg_getbool(*cfg,"PRINT_POINTS_ARRAY");
     alldata->options.fitVrad = cfg_getbool(*cfg,"FIT_VRAD");
+    alldata->options.vvpClosedForm = cfg_getbool(*cfg,"VVP_CLOSED_FORM");
     alldata->options.exportBirdProfileAsJSONVar = cfg_getbool(*cfg,"EXPORT_BIRD_PROFILE_AS_JSON"); 
     alldata->options.minNyquist = cfg_getfloat(*cfg,"MIN_NYQUIST_VELOCITY");
     alldata->options.maxNyquistDealias = cfg_getfloat(*cfg,"MAX_NYQUIST_DEALIAS");
@@ -5011,10 +7359,13 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     alldata->options.requireVrad = cfg_getbool(*cfg,"REQUIRE_VRAD");
     alldata->options.dealiasVrad = cfg_getbool(*cfg,"DEALIAS_VRAD");
     alldata->options.dealiasRecycle = cfg_getbool(*cfg,"DEALIAS_RECYCLE");
+    alldata->options.dealiasSeed = cfg_getbool(*cfg,"DEALIAS_SEED");
+    alldata->options.dealiasSeedCostMax = cfg_getfloat(*cfg,"DEALIAS_SEED_COSTMAX");
     alldata->options.dualPol = cfg_getbool(*cfg,"DUALPOL");
     alldata->options.singlePol = cfg_getbool(*cfg,"SINGLEPOL");
     alldata->options.dbzThresMin = cfg_getfloat(*cfg,"DBZMIN");
     alldata->options.rhohvThresMin = cfg_getfloat(*cfg,"RHOHVMIN");
+    alldata->options.fringeDist = cfg_getfloat(*cfg,"FRINGEDIST");
     alldata->options.resample = cfg_getbool(*cfg,"RESAMPLE");
     alldata->options.resampleRscale = cfg_getfloat(*cfg,"RESAMPLE_RSCALE");
     alldata->options.resampleNbins = cfg_getint(*cfg,"RESAMPLE_NBINS");
@@ -5026,6 +7377,14 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     alldata->options.mistNetElevsOnly = cfg_getbool(*cfg, "MISTNET_ELEVS_ONLY");
     alldata->options.useMistNet = cfg_getbool(*cfg, "USE_MISTNET");
     strcpy(alldata->options.mistNetPath,cfg_getstr(*cfg,"MISTNET_PATH"));
+    alldata->options.nThreads = cfg_getint(*cfg, "NTHREADS");
+    if (alldata->options.nThreads < 1) {
+        vol2bird_err_printf("Error: NTHREADS must be 1 or larger, got %i.\n", alldata->options.nThreads);
+        cfg_free(alldata->cfg);
+        return -1;
+    }
+    strcpy(alldata->options.cacheDir,cfg_getstr(*cfg,"CACHE_DIR"));
+    alldata->options.cacheSizeMax = cfg_getfloat(*cfg, "CACHE_SIZE_MAX");
 
 
     // ------------------------------------------------------------- //
@@ -5035,7 +7394,6 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     alldata->constants.areaCellMin = AREACELL;
     alldata->constants.cellClutterFractionMax = CLUTPERCCELL;
     alldata->constants.chisqMin = CHISQMIN;
-    alldata->constants.fringeDist = FRINGEDIST;
     alldata->constants.nBinsGap = NBINSGAP;
     alldata->constants.nPointsIncludedMin = NDBZMIN;
     alldata->constants.nNeighborsMin = NEIGHBORS;
@@ -5052,6 +7410,11 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     // ------------------------------------------------------------- //
 
     alldata->misc.rCellMax = alldata->options.rangeMax + RCELLMAX_OFFSET;
+
+    // the quantities determineScanUse() may select, which also covers MistNet's DBZ, VRAD and WRAD input
+    snprintf(alldata->misc.quantities, sizeof(alldata->misc.quantities),
+             "%s,DBZH,DBZV,VRAD,VRADH,VRADV,VRADDH,WRAD,WRADH,WRADV%s",
+             alldata->options.dbzType, alldata->options.dualPol ? ",RHOHV" : "");
     alldata->misc.nDims = 2;
     alldata->misc.nParsFitted = 3;
 
@@ -5060,6 +7423,35 @@ int vol2birdLoadConfig(vol2bird_t* alldata, const char* optionsFile) {
     alldata->misc.dbzMax = NAN;
     alldata->misc.cellDbzMin = NAN;
 
+    // the winds that seed the dealiasing are kept from one volume to the next
+    alldata->misc.iVolume = 0;
+    alldata->misc.dealiasSeed = (float*) malloc(sizeof(float) * 2 * alldata->options.nLayers);
+    alldata->misc.dealiasSeedVolume = (int*) malloc(sizeof(int) * alldata->options.nLayers);
+    if (alldata->misc.dealiasSeed == NULL || alldata->misc.dealiasSeedVolume == NULL) {
+        vol2bird_err_printf("Error pre-allocating array 'dealiasSeed'.\n");
+        free((void*) alldata->misc.dealiasSeed);
+        free((void*) alldata->misc.dealiasSeedVolume);
+        cfg_free(alldata->cfg);
+        return -1;
+    }
+    for (int iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+        alldata->misc.dealiasSeed[2 * iLayer] = NAN;
+        alldata->misc.dealiasSeed[2 * iLayer + 1] = NAN;
+        alldata->misc.dealiasSeedVolume[iLayer] = -1;
+    }
+
+    // with seeded dealiasing a profile also depends on the volumes processed before it,
+    // so it cannot be looked up by the content of its input
+    if (alldata->options.cacheDir[0] != '\0' && alldata->options.dealiasSeed) {
+        vol2bird_err_printf("Warning: DEALIAS_SEED is set, disabling the profile cache\n");
+        alldata->options.cacheDir[0] = '\0';
+    }
+    alldata->misc.cacheHits = 0;
+    alldata->misc.cacheMisses = 0;
+    alldata->misc.cacheStores = 0;
+    alldata->misc.cacheEvictions = 0;
+    alldata->misc.cacheBytes = -1;
+
     alldata->misc.loadConfigSuccessful = TRUE;
 
     return 0;
@@ -5098,6 +7490,86 @@ int get_radar_name(const char* source, char* radarName, size_t radarNameLength)
     return 0;
 }
 
+// formats all options and constants in the task_args format of the ODIM profile
+static void formatTaskArgs(char* taskArgs, const size_t taskArgsSize, vol2bird_t* alldata) {
+
+    //FIXME: add mistNetNElevs (mistnet elevations) to the task_args string
+    snprintf(taskArgs, taskArgsSize,
+        "azimMax=%f,azimMin=%f,layerThickness=%f,nLayers=%i,rangeMax=%f,"
+        "rangeMin=%f,elevMax=%f,elevMin=%f,radarWavelength=%f,"
+        "useClutterMap=%i,clutterMap=%s,fitVrad=%i,vvpClosedForm=%i,exportBirdProfileAsJSONVar=%i,"
+        "minNyquist=%f,maxNyquistDealias=%f,birdRadarCrossSection=%f,stdDevMinBird=%f,"
+        "cellEtaMin=%f,etaMax=%f,dbzType=%s,requireVrad=%i,"
+        "dealiasVrad=%i,dealiasRecycle=%i,dealiasSeed=%i,dealiasSeedCostMax=%f,dualPol=%i,singlePol=%i,rhohvThresMin=%f,"
+        "resample=%i,resampleRscale=%f,resampleNbins=%i,resampleNrays=%i,"
+        "mistNetNElevs=%i,mistNetElevsOnly=%i,useMistNet=%i,mistNetPath=%s,"
+    
+        "areaCellMin=%f,cellClutterFractionMax=%f,"
+        "chisqMin=%f,clutterValueMin=%f,dbzThresMin=%f,"
+        "fringeDist=%f,nBinsGap=%i,nPointsIncludedMin=%i,nNeighborsMin=%i,"
+        "nObsGapMin=%i,nAzimNeighborhood=%i,nRangNeighborhood=%i,nCountMin=%i,"
+        "refracIndex=%f,cellStdDevMax=%f,absVDifMax=%f,vradMin=%f",
+
+        alldata->options.azimMax,
+        alldata->options.azimMin,
+        alldata->options.layerThickness,
+        alldata->options.nLayers,
+        alldata->options.rangeMax,
+        alldata->options.rangeMin,
+        alldata->options.elevMax,
+        alldata->options.elevMin,
+        alldata->options.radarWavelength,
+        alldata->options.useClutterMap,
+        alldata->options.clutterMap,
+        alldata->options.fitVrad,
+        alldata->options.vvpClosedForm,
+        alldata->options.exportBirdProfileAsJSONVar,
+        alldata->options.minNyquist,
+        alldata->options.maxNyquistDealias,
+        alldata->options.birdRadarCrossSection,
+        alldata->options.stdDevMinBird,
+        alldata->options.cellEtaMin,
+        alldata->options.etaMax,
+        alldata->options.dbzType,
+        alldata->options.requireVrad,
+        alldata->options.dealiasVrad,
+        alldata->options.dealiasRecycle,
+        alldata->options.dealiasSeed,
+        alldata->options.dealiasSeedCostMax,
+        alldata->options.dualPol,
+	    alldata->options.singlePol,
+        alldata->options.rhohvThresMin,
+        alldata->options.resample,
+        alldata->options.resampleRscale,
+        alldata->options.resampleNbins,
+        alldata->options.resampleNrays,
+        alldata->options.mistNetNElevs,
+        alldata->options.mistNetElevsOnly,
+        alldata->options.useMistNet,
+        alldata->options.mistNetPath,
+
+        alldata->constants.areaCellMin,
+        alldata->constants.cellClutterFractionMax,
+        alldata->constants.chisqMin,
+        alldata->options.clutterValueMin,
+        alldata->options.dbzThresMin,
+        alldata->options.fringeDist,
+        alldata->constants.nBinsGap,
+        alldata->constants.nPointsIncludedMin,
+        alldata->constants.nNeighborsMin,
+        alldata->constants.nObsGapMin,
+        alldata->constants.nAzimNeighborhood,
+        alldata->constants.nRangNeighborhood,
+        alldata->constants.nCountMin,
+        alldata->constants.refracIndex,
+        alldata->options.cellStdDevMax,
+        alldata->constants.absVDifMax,
+        alldata->constants.vradMin
+    );
+
+} // formatTaskArgs
+
+
 //int vol2birdSetUp(PolarVolume_t* volume, cfg_t** cfg, vol2bird_t* alldata) {
 int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
     
@@ -5186,76 +7658,7 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
     // if a wavelength attribute is present. Therefore the task_args string is
     // set here and not in vol2birdLoadConfig(), which has no access to the volume    
     
-    //FIXME: add mistNetNElevs (mistnet elevations) to the task_args string
-    snprintf(alldata->misc.task_args,3000,
-        "azimMax=%f,azimMin=%f,layerThickness=%f,nLayers=%i,rangeMax=%f,"
-        "rangeMin=%f,elevMax=%f,elevMin=%f,radarWavelength=%f,"
-        "useClutterMap=%i,clutterMap=%s,fitVrad=%i,exportBirdProfileAsJSONVar=%i,"
-        "minNyquist=%f,maxNyquistDealias=%f,birdRadarCrossSection=%f,stdDevMinBird=%f,"
-        "cellEtaMin=%f,etaMax=%f,dbzType=%s,requireVrad=%i,"
-        "dealiasVrad=%i,dealiasRecycle=%i,dualPol=%i,singlePol=%i,rhohvThresMin=%f,"
-        "resample=%i,resampleRscale=%f,resampleNbins=%i,resampleNrays=%i,"
-        "mistNetNElevs=%i,mistNetElevsOnly=%i,useMistNet=%i,mistNetPath=%s,"
-    
-        "areaCellMin=%f,cellClutterFractionMax=%f,"
-        "chisqMin=%f,clutterValueMin=%f,dbzThresMin=%f,"
-        "fringeDist=%f,nBinsGap=%i,nPointsIncludedMin=%i,nNeighborsMin=%i,"
-        "nObsGapMin=%i,nAzimNeighborhood=%i,nRangNeighborhood=%i,nCountMin=%i,"
-        "refracIndex=%f,cellStdDevMax=%f,absVDifMax=%f,vradMin=%f",
-
-        alldata->options.azimMax,
-        alldata->options.azimMin,
-        alldata->options.layerThickness,
-        alldata->options.nLayers,
-        alldata->options.rangeMax,
-        alldata->options.rangeMin,
-        alldata->options.elevMax,
-        alldata->options.elevMin,
-        alldata->options.radarWavelength,
-        alldata->options.useClutterMap,
-        alldata->options.clutterMap,
-        alldata->options.fitVrad,
-        alldata->options.exportBirdProfileAsJSONVar,
-        alldata->options.minNyquist,
-        alldata->options.maxNyquistDealias,
-        alldata->options.birdRadarCrossSection,
-        alldata->options.stdDevMinBird,
-        alldata->options.cellEtaMin,
-        alldata->options.etaMax,
-        alldata->options.dbzType,
-        alldata->options.requireVrad,
-        alldata->options.dealiasVrad,
-        alldata->options.dealiasRecycle,
-        alldata->options.dualPol,
-	    alldata->options.singlePol,
-        alldata->options.rhohvThresMin,
-        alldata->options.resample,
-        alldata->options.resampleRscale,
-        alldata->options.resampleNbins,
-        alldata->options.resampleNrays,
-        alldata->options.mistNetNElevs,
-        alldata->options.mistNetElevsOnly,
-        alldata->options.useMistNet,
-        alldata->options.mistNetPath,
-
-        alldata->constants.areaCellMin,
-        alldata->constants.cellClutterFractionMax,
-        alldata->constants.chisqMin,
-        alldata->options.clutterValueMin,
-        alldata->options.dbzThresMin,
-        alldata->constants.fringeDist,
-        alldata->constants.nBinsGap,
-        alldata->constants.nPointsIncludedMin,
-        alldata->constants.nNeighborsMin,
-        alldata->constants.nObsGapMin,
-        alldata->constants.nAzimNeighborhood,
-        alldata->constants.nRangNeighborhood,
-        alldata->constants.nCountMin,
-        alldata->constants.refracIndex,
-        alldata->options.cellStdDevMax,
-        alldata->constants.absVDifMax,
-        alldata->constants.vradMin
-    );
+    formatTaskArgs(alldata->misc.task_args, sizeof(alldata->misc.task_args), alldata);
    
     if (scanUse == (vol2birdScanUse_t*) NULL){
         vol2bird_err_printf( "Error: no valid scans found in polar volume, aborting ...\n");
@@ -5362,37 +7765,39 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
     //               information about the 'points' array            //
     // ------------------------------------------------------------- //
 
-    alldata->points.nColsPoints = 10;
+    alldata->points.nColsPoints = 9;
     alldata->points.nRowsPoints = detSvdfitArraySize(volume, scanUse, alldata);
+    if (alldata->points.nRowsPoints < 0) {
+        vol2bird_err_printf("Error determining the size of array 'points'.\n");
+        return -1;
+    }
 
-    alldata->points.rangeCol = 0;
-    alldata->points.azimAngleCol = 1;
-    alldata->points.elevAngleCol = 2;
-    alldata->points.dbzValueCol = 3;
-    alldata->points.vradValueCol = 4;
-    alldata->points.cellValueCol = 5;
-    alldata->points.gateCodeCol = 6;
-    alldata->points.nyquistCol = 7;
-    alldata->points.vraddValueCol = 8;
-    alldata->points.clutValueCol = 9;
-
-    // pre-allocate the 'points' array (note it has 'nColsPoints'
-    // pseudo-columns)
+    // pre-allocate the 'points' array, which holds the 'nColsPoints'
+    // floating point columns one after the other, and the gate codes
     alldata->points.points = (float*) malloc(sizeof(float) * alldata->points.nRowsPoints * alldata->points.nColsPoints);
     if (alldata->points.points == NULL) {
         vol2bird_err_printf("Error pre-allocating array 'points'.\n");
         return -1;
     }
-
-    int iRowPoints;
-    int iColPoints;
-        
-    for (iRowPoints = 0; iRowPoints < alldata->points.nRowsPoints; iRowPoints++) {
-        for (iColPoints = 0; iColPoints < alldata->points.nColsPoints; iColPoints++) {
-            alldata->points.points[iRowPoints*alldata->points.nColsPoints + iColPoints] = NAN;
-        }
+    alldata->points.gateCode = (uint32_t*) malloc(sizeof(uint32_t) * alldata->points.nRowsPoints);
+    if (alldata->points.gateCode == NULL) {
+        vol2bird_err_printf("Error pre-allocating array 'gateCode'.\n");
+        free((void*) alldata->points.points);
+        return -1;
     }
 
+    alldata->points.range = &(alldata->points.points[0 * alldata->points.nRowsPoints]);
+    alldata->points.azimAngle = &(alldata->points.points[1 * alldata->points.nRowsPoints]);
+    alldata->points.elevAngle = &(alldata->points.points[2 * alldata->points.nRowsPoints]);
+    alldata->points.dbzValue = &(alldata->points.points[3 * alldata->points.nRowsPoints]);
+    alldata->points.vradValue = &(alldata->points.points[4 * alldata->points.nRowsPoints]);
+    alldata->points.cellValue = &(alldata->points.points[5 * alldata->points.nRowsPoints]);
+    alldata->points.nyquist = &(alldata->points.points[6 * alldata->points.nRowsPoints]);
+    alldata->points.vraddValue = &(alldata->points.points[7 * alldata->points.nRowsPoints]);
+    alldata->points.clutValue = &(alldata->points.points[8 * alldata->points.nRowsPoints]);
+
+    resetPointsRows(&(alldata->points), 0, alldata->points.nRowsPoints);
+
     // information about the flagfields of 'gateCode'
     
     alldata->flags.flagPositionStaticClutter = 0;
@@ -5404,6 +7809,26 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
     alldata->flags.flagPositionVDifMax = 6;
     alldata->flags.flagPositionAzimOutOfRange = 7;
 
+    // every flag that excludes a gate in includeGate() does so regardless of the
+    // other flags, so the rules come down to one mask of excluding bits for each
+    // profile type and quantity type: a gate is included when
+    // (gateCode & excludeMask[iProfileType][iQuantityType]) == 0
+    {
+        int iProfileType;
+        int iQuantityType;
+        int iBit;
+        memset(alldata->flags.excludeMask, 0, sizeof(alldata->flags.excludeMask));
+        for (iProfileType = 1; iProfileType <= 3; iProfileType++) {
+            for (iQuantityType = 0; iQuantityType < 2; iQuantityType++) {
+                for (iBit = 0; iBit < 32; iBit++) {
+                    if (includeGate(iProfileType, iQuantityType, 1u << iBit, alldata) == FALSE) {
+                        alldata->flags.excludeMask[iProfileType][iQuantityType] |= 1u << iBit;
+                    }
+                }
+            }
+        }
+    }
+
     // segment precipitation using Mistnet deep convolutional neural net
 #ifdef MISTNET
 #ifdef VOL2BIRD_R
@@ -5432,7 +7857,7 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
 
     alldata->profiles.nProfileTypes = 3;
     alldata->profiles.nRowsProfile = alldata->options.nLayers;
-    alldata->profiles.nColsProfile = 14; 
+    alldata->profiles.nColsProfile = NCOLS_PROFILE;
     
     // pre-allocate the array holding any profiled data (note it has 
     // 'nColsProfile' pseudocolumns):
@@ -5474,6 +7899,39 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
     alldata->profiles.iProfileTypeLast = -1;
 
 
+    // ------------------------------------------------------------- //
+    //      working buffers for the calculation of the profiles      //
+    // ------------------------------------------------------------- //
+
+    // one set of buffers for each thread, sized for the largest layer
+    int nPointsLayerMax = 0;
+    for (iLayer = 0; iLayer < alldata->options.nLayers; iLayer++) {
+        int nPointsLayer = alldata->points.indexTo[iLayer] - alldata->points.indexFrom[iLayer];
+        if (nPointsLayer > nPointsLayerMax) {
+            nPointsLayerMax = nPointsLayer;
+        }
+    }
+
+    alldata->misc.nScratch = alldata->options.nThreads > 1 ? alldata->options.nThreads : 1;
+    alldata->misc.nScratchAllocations = 0;
+    alldata->misc.nProfileAllocations = 0;
+    alldata->misc.scratch = (vol2birdScratch_t*) calloc(alldata->misc.nScratch, sizeof(vol2birdScratch_t));
+    if (alldata->misc.scratch == NULL) {
+        vol2bird_err_printf("Error pre-allocating array 'scratch'.\n");
+        return -1;
+    }
+    alldata->misc.nScratchAllocations += 1;
+
+    int iScratch;
+    for (iScratch = 0; iScratch < alldata->misc.nScratch; iScratch++) {
+        int nAllocations = allocateScratch(&(alldata->misc.scratch[iScratch]), nPointsLayerMax, alldata);
+        if (nAllocations < 0) {
+            return -1;
+        }
+        alldata->misc.nScratchAllocations += nAllocations;
+    }
+
+
  
     // ------------------------------------------------------------- //
     //              initialising rave profile fields                 //
@@ -5501,11 +7959,13 @@ int vol2birdSetUp(PolarVolume_t* volume, vol2bird_t* alldata) {
 } // vol2birdSetUp
 
 
-void vol2birdTearDown(vol2bird_t* alldata) {
+void vol2birdTearDownVolume(vol2bird_t* alldata) {
     
-    // ---------------------------------------------------------- //
-    // free the memory that was previously allocated for vol2bird //
-    // ---------------------------------------------------------- //
+    // ------------------------------------------------------------- //
+    // free the memory that was allocated by vol2birdSetUp for the   //
+    // current volume, but keep the user configuration, such that    //
+    // vol2birdSetUp can be called again for the next volume         //
+    // ------------------------------------------------------------- //
 
     if (alldata->misc.initializationSuccessful==FALSE) {
         vol2bird_err_printf("You need to initialize vol2bird before you can use it. Aborting.\n");
@@ -5515,6 +7975,7 @@ void vol2birdTearDown(vol2bird_t* alldata) {
     // free the points array, the indexes into it, the counters, as well
     // as the profile data array
     free((void*) alldata->points.points);
+    free((void*) alldata->points.gateCode);
     free((void*) alldata->profiles.profile);
     free((void*) alldata->profiles.profile1);
     free((void*) alldata->profiles.profile2);
@@ -5523,13 +7984,45 @@ void vol2birdTearDown(vol2bird_t* alldata) {
     free((void*) alldata->points.indexTo);
     free((void*) alldata->points.nPointsWritten);
     free((void*) alldata->misc.scatterersAreNotBirds);
+
+    int iScratch;
+    for (iScratch = 0; iScratch < alldata->misc.nScratch; iScratch++) {
+        freeScratch(&(alldata->misc.scratch[iScratch]));
+    }
+    free((void*) alldata->misc.scratch);
    
     // free all rave fields
     RAVE_OBJECT_RELEASE(alldata->vp);
+
+    // reset this variable to its initial value
+    alldata->misc.initializationSuccessful = FALSE;
+
+} // vol2birdTearDownVolume
+
+
+void vol2birdTearDown(vol2bird_t* alldata) {
+    
+    // ---------------------------------------------------------- //
+    // free the memory that was previously allocated for vol2bird //
+    // ---------------------------------------------------------- //
+
+    if (alldata->misc.initializationSuccessful==FALSE && alldata->misc.loadConfigSuccessful==FALSE) {
+        vol2bird_err_printf("You need to initialize vol2bird before you can use it. Aborting.\n");
+        return;
+    }
+
+    // the per-volume data may already have been freed by vol2birdTearDownVolume
+    if (alldata->misc.initializationSuccessful==TRUE) {
+        vol2birdTearDownVolume(alldata);
+    }
  
     // free the memory that holds the user configurable options
 #ifndef NOCONFUSE    
-    cfg_free(alldata->cfg);
+    if (alldata->misc.loadConfigSuccessful==TRUE) {
+        cfg_free(alldata->cfg);
+        free((void*) alldata->misc.dealiasSeed);
+        free((void*) alldata->misc.dealiasSeedVolume);
+    }
 #endif    
     // reset this variable to its initial value
     alldata->misc.initializationSuccessful = FALSE;
@@ -14,6 +14,7 @@
 #ifndef NOCONFUSE
 #include <confuse.h>
 #endif
+#include <stdint.h>
 #include <polarvolume.h>
 #include <vertical_profile.h>
 
@@ -116,6 +117,7 @@ struct vol2birdOptions {
     int printProfileVar;      /* print profile data to stderr */
     int printPointsArray;     /* whether or not to print the 'points' array */
     int fitVrad;              /* Whether or not to fit a model to the observed vrad */
+    int vvpClosedForm;        /* Whether to fit the VVP model in closed form instead of by svdfit */
     int exportBirdProfileAsJSONVar; /* whether you want to export the vertical bird profile as JSON */
     float minNyquist;               /* Minimum Nyquist velocity [m/s] to include a scan; */
     float maxNyquistDealias;        /* When all scans (except those excluded by minNyquist) have nyquist velocity */
@@ -131,10 +133,13 @@ struct vol2birdOptions {
     int requireVrad;                /* require range gates to have a valid radial velocity measurement */
     int dealiasVrad;                /* dealias radial velocities using torus mapping method by Haase et al. */
     int dealiasRecycle;             /* whether we should dealias once, or separately for each profile type */
+    int dealiasSeed;                /* whether to start dealiasing from the wind fitted in a neighbouring layer or earlier volume */
+    float dealiasSeedCostMax;       /* search all dealiasing test fields when the misfit of the seeded wind exceeds this value */
     int dualPol;                    /* whether to use dual-polarization moments for filtering meteorological echoes */
     int singlePol;                  /* whether to use single-polarization moments for filtering meteorological echoes */
     float dbzThresMin;              /* reflectivities above this threshold will be checked as potential precipitation */
     float rhohvThresMin;            /* correlation coefficients above this threshold will be removed as precipitation */
+    float fringeDist;               /* width [m] of the fringe grown around each weather cell */
     int resample;                   /* whether to resample the input polar volume */
     float resampleRscale;           /* resampled range gate length in m */
     int resampleNbins;              /* resampled number of range bins */
@@ -145,6 +150,9 @@ struct vol2birdOptions {
                                     /* otherwise, use all available elevation scans*/
     int useMistNet;                 /* whether to use MistNet segmentation model */
     char mistNetPath[1000];         /* path and filename of the MistNet segmentation model to use, expects libtorch format */
+    int nThreads;                   /* number of threads for parallel processing, requires compilation with OpenMP */
+    char cacheDir[1000];            /* directory of the on-disk profile cache, empty when the cache is disabled */
+    float cacheSizeMax;             /* maximum size of the profile cache in MB, unlimited when <= 0 */
 
 };
 typedef struct vol2birdOptions vol2birdOptions_t;
@@ -170,9 +178,6 @@ struct vol2birdConstants {
     float dbzMax;
     // minimum dbz for inclusion in a cell
     float dbzThresMin;
-    // each weather cell identified by findWeatherCells() is grown by a distance
-    // equal to 'fringeDist' using a region-growing approach
-    float fringeDist;
     // the refractive index of water
     float refracIndex;
     // When analyzing cells, radial velocities lower than VRADMIN are treated as clutter
@@ -209,42 +214,43 @@ typedef struct vol2birdConstants vol2birdConstants_t;
 // ------------------------------------------------------------- //
 
 // The data needed for calculating bird densities are collected
-// in one big array, 'points'. Although this array is one
-// variable, it is partitioned into 'nLayers' parts. The parts
-// are not equal in size, therefore we need to keep track of
-// where the data pertaining to a certain altitude bin can be
-// written. The valid range of indexes into 'points' are stored
-// in arrays 'indexFrom' and 'indexTo'.
+// in one big store, 'points'. Each attribute of a gate is kept in
+// its own contiguous array, such that row iPoint of every array
+// pertains to the same gate. The store is partitioned into
+// 'nLayers' parts. The parts are not equal in size, therefore we
+// need to keep track of where the data pertaining to a certain
+// altitude bin can be written. The valid range of row indexes
+// into 'points' are stored in arrays 'indexFrom' and 'indexTo'.
 
 struct vol2birdPoints {
-    // the 'points' array has this many pseudo-columns
+    // the 'points' store has this many floating point columns
     int nColsPoints;
-    // the 'points' array has this many rows
+    // the 'points' store has this many rows
     int nRowsPoints;
-    // the psuedo-column in 'points' that holds the azimuth angle
-    int rangeCol;
-    // the psuedo-column in 'points' that holds the range
-    int azimAngleCol;
-    // the psuedo-column in 'points' that holds the elevation angle
-    int elevAngleCol;
-    // the psuedo-column in 'points' that holds the dbz value
-    int dbzValueCol;
-    // the psuedo-column in 'points' that holds the vrad value
-    int vradValueCol;
-    // the psuedo-column in 'points' that holds the cell value
-    int cellValueCol;
-    // the psuedo-column in 'points' that holds the gate classification code
-    int gateCodeCol;
-    // the psuedo-column in 'points' that holds the nyquist velocity
-    int nyquistCol;
-    // the psuedo-column in 'points' that holds the dealiased vrad value
-    int vraddValueCol;
-    // the psuedo-column in 'points' that holds the static clutter map value
-    int clutValueCol;
-    // the 'points' array itself
+    // the floating point columns, one after the other
     float* points; // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
+    // the column in 'points' that holds the range
+    float* range;
+    // the column in 'points' that holds the azimuth angle
+    float* azimAngle;
+    // the column in 'points' that holds the elevation angle
+    float* elevAngle;
+    // the column in 'points' that holds the dbz value
+    float* dbzValue;
+    // the column in 'points' that holds the vrad value
+    float* vradValue;
+    // the column in 'points' that holds the cell value
+    float* cellValue;
+    // the column in 'points' that holds the nyquist velocity
+    float* nyquist;
+    // the column in 'points' that holds the dealiased vrad value
+    float* vraddValue;
+    // the column in 'points' that holds the static clutter map value
+    float* clutValue;
+    // the gate classification code of each row
+    uint32_t* gateCode; // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
     // for a given altitude layer in the profile, only part of the 'points'
-    // array is relevant. The 'indexFrom' and 'indexTo' arrays keep track
+    // store is relevant. The 'indexFrom' and 'indexTo' arrays keep track
     // which rows in 'points' pertains to a given layer
     int* indexFrom; // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
     int* indexTo;   // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
@@ -283,6 +289,9 @@ struct vol2birdFlags {
     int flagPositionVDifMax;
     // the bit in 'gateCode' that says whether the gate's azimuth angle was out of the selected range
     int flagPositionAzimOutOfRange;
+    // the bits in 'gateCode' that exclude a gate from profile type iProfileType (1 to 3),
+    // indexed as [iProfileType][iQuantityType], compiled from includeGate() in vol2birdSetUp()
+    uint32_t excludeMask[4][2];
 };
 typedef struct vol2birdFlags vol2birdFlags_t;
 
@@ -310,6 +319,50 @@ struct vol2birdProfiles {
 };
 typedef struct vol2birdProfiles vol2birdProfiles_t;
 
+// ------------------------------------------------------------- //
+//        working buffers for the calculation of profiles        //
+// ------------------------------------------------------------- //
+
+// Each thread that calculates profile layers has its own set of
+// buffers. They are sized in vol2birdSetUp() for the largest layer
+// in 'points', such that vol2birdCalcProfiles() does not need to
+// allocate memory for any layer, pass or profile type.
+
+struct dealiasWork;
+
+// the gates of one altitude layer that contribute to one type of profile
+struct vol2birdLayerGates {
+    // the rows in 'points' of the gates that may be included in the VVP fit
+    int* index;
+    int nIndex;
+    // the sum of the linear reflectivity of the gates that are included
+    // in the reflectivity, and their number
+    double undbzSum;
+    int nPointsIncludedZ;
+};
+typedef struct vol2birdLayerGates vol2birdLayerGates_t;
+
+struct vol2birdScratch {
+    // the buffers have room for this many points
+    int nPointsMax;
+    // the selected points and velocities that are passed to svdfit and dealias_points
+    float* pointsSelection;
+    float* yNyquist;
+    float* yDealias;
+    float* yObs;
+    float* yFitted;
+    // the rows in 'points' of the selected points
+    int* includedIndex;
+    // the gates of the layer for profile types 1 and 3
+    vol2birdLayerGates_t gates1;
+    vol2birdLayerGates_t gates3;
+    // the design matrix of svdfit
+    float* svdfitWork;
+    // the work arrays of dealias_points
+    struct dealiasWork* dealiasWork;
+};
+typedef struct vol2birdScratch vol2birdScratch_t;
+
 // ------------------------------------------------------------- //
 //                       some other variables                    //
 // ------------------------------------------------------------- //
@@ -350,6 +403,8 @@ struct vol2birdMisc {
     int* scatterersAreNotBirds; // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
     // this string contains all the user options and constants, for storage in ODIM task_args attribute
     char task_args[3000];
+    // comma separated list of the quantities read from ODIM input files, all others are never loaded
+    char quantities[200];
     // the polar volume input file name
     char filename_pvol[1000]; 
     // the vertical profile output file name
@@ -358,6 +413,27 @@ struct vol2birdMisc {
     int vcp;
     // the radar name extracted from the source string
     char radarName[100];
+    // the working buffers of vol2birdCalcProfiles(), one set for each thread
+    vol2birdScratch_t* scratch; // Is allocated in vol2birdSetUp() and freed in vol2birdTearDown()
+    int nScratch;
+    // the number of buffers allocated for 'scratch' by vol2birdSetUp()
+    long nScratchAllocations;
+    // the number of buffers allocated while calculating the profiles,
+    // this remains zero when 'scratch' was sized correctly
+    long nProfileAllocations;
+    // the number of volumes for which profiles were calculated
+    int iVolume;
+    // the last fitted u and v of each layer, from which dealiasing starts when dealiasSeed is set
+    float* dealiasSeed; // Is allocated in vol2birdLoadConfig() and freed in vol2birdTearDown()
+    // the value of iVolume when each layer of 'dealiasSeed' was fitted, -1 if never
+    int* dealiasSeedVolume; // Is allocated in vol2birdLoadConfig() and freed in vol2birdTearDown()
+    // profile cache statistics of this run
+    long cacheHits;
+    long cacheMisses;
+    long cacheStores;
+    long cacheEvictions;
+    // the total size of the profile cache in bytes, -1 until the cache directory has been scanned
+    long long cacheBytes;
 };
 typedef struct vol2birdMisc vol2birdMisc_t;
 
@@ -454,6 +530,10 @@ float* vol2birdGetProfile(int iProfileType, vol2bird_t* alldata);
 
 PolarVolume_t* vol2birdGetVolume(char* filenames[], int nInputFiles, float rangeMax, int small);
 
+PolarVolume_t* vol2birdGetVolumeSelected(char* filenames[], int nInputFiles, float rangeMax, int small, vol2bird_t* alldata);
+
+PolarVolume_t* vol2birdGetVolumeFromBuffer(const void* buffer, size_t size, const char* name, float rangeMax, int small, vol2bird_t* alldata);
+
 PolarVolume_t* PolarVolume_resample(PolarVolume_t* volume, double rscale_proj, long nbins_proj, long nrays_proj);
 
 PolarScanParam_t* PolarScanParam_project_on_scan(PolarScanParam_t* param, PolarScan_t* scan, double rscale);
@@ -482,6 +562,8 @@ int get_radar_name(const char* source, char* radarName, size_t radarNameLength);
 
 void vol2birdTearDown(vol2bird_t* alldata);
 
+void vol2birdTearDownVolume(vol2bird_t* alldata);
+
 int mapDataToRave(PolarVolume_t* volume, vol2bird_t* alldata);
 
 double nanify(double value);
@@ -507,6 +589,34 @@ int saveToCSV(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol);
 
 int isCSV(const char *filename);
 
+int saveToVPB(const char *filename, vol2bird_t* alldata, PolarVolume_t* pvol);
+
+int isVPB(const char *filename);
+
+// writes the profiles of many volumes to VPTS CSV files, see vol2birdVptsWriterAdd
+struct vol2birdVptsWriter;
+typedef struct vol2birdVptsWriter vol2birdVptsWriter_t;
+
+vol2birdVptsWriter_t* vol2birdVptsWriterNew(void);
+
+int vol2birdVptsWriterAdd(vol2birdVptsWriter_t* writer, const char* pattern, const int merge,
+                          vol2bird_t* alldata, PolarVolume_t* pvol);
+
+int vol2birdVptsWriterClose(vol2birdVptsWriter_t* writer);
+
+// on-disk cache of profiles, see vol2birdCacheKey
+#define VOL2BIRD_CACHE_KEY_LENGTH 17
+
+int vol2birdCacheKey(char* filenames[], int nInputFiles, vol2bird_t* alldata, char* key);
+
+int vol2birdCacheKeyFromBuffer(const void* buffer, size_t size, vol2bird_t* alldata, char* key);
+
+int vol2birdCacheLoad(const char* key, vol2bird_t* alldata, PolarVolume_t** volume);
+
+int vol2birdCacheStore(const char* key, PolarVolume_t* volume, vol2bird_t* alldata);
+
+void vol2birdCachePrintStats(vol2bird_t* alldata);
+
 const char* libvol2bird_version(void);
 
 const char *get_filename(const char *path);
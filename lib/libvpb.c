@@ -0,0 +1,489 @@
+/** Writing and memory-mapped reading of vpb profile time series
+ * @file libvpb.c
+ *
+ * See libvpb.h for a description of the file format.
+ */
+
+#include "libvpb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void vol2bird_err_printf(const char* fmt, ...);
+
+// non-public function prototypes (local to this file/translation unit)
+
+static int compareIndexEntries(const void* a, const void* b);
+
+static float getFloat32(const unsigned char* p);
+
+static double getFloat64(const unsigned char* p);
+
+static uint32_t getUint32(const unsigned char* p);
+
+static uint64_t getUint64(const unsigned char* p);
+
+static void putFloat32(unsigned char* p, const float value);
+
+static void putFloat64(unsigned char* p, const double value);
+
+static void putUint32(unsigned char* p, const uint32_t value);
+
+static void putUint64(unsigned char* p, const uint64_t value);
+
+static const unsigned char* recordPointer(const vpbReader_t* reader, const long iRecord);
+
+
+
+// ------------------------------------------------------------- //
+//              little-endian encoding and decoding              //
+// ------------------------------------------------------------- //
+
+static void putUint32(unsigned char* p, const uint32_t value) {
+
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char) (value >> (8 * i));
+    }
+
+} // putUint32
+
+
+static void putUint64(unsigned char* p, const uint64_t value) {
+
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char) (value >> (8 * i));
+    }
+
+} // putUint64
+
+
+static void putFloat32(unsigned char* p, const float value) {
+
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    putUint32(p, bits);
+
+} // putFloat32
+
+
+static void putFloat64(unsigned char* p, const double value) {
+
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    putUint64(p, bits);
+
+} // putFloat64
+
+
+static uint32_t getUint32(const unsigned char* p) {
+
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+
+} // getUint32
+
+
+static uint64_t getUint64(const unsigned char* p) {
+
+    return (uint64_t) getUint32(p) | (uint64_t) getUint32(p + 4) << 32;
+
+} // getUint64
+
+
+static float getFloat32(const unsigned char* p) {
+
+    uint32_t bits = getUint32(p);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+
+} // getFloat32
+
+
+static double getFloat64(const unsigned char* p) {
+
+    uint64_t bits = getUint64(p);
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+
+} // getFloat64
+
+
+
+// converts a date (YYYYMMDD) and time (HHMMSS) in UTC to seconds since 1970-01-01
+int64_t vpbTime(const char* date, const char* time) {
+
+    int year, month, day;
+    int hour = 0, minute = 0, second = 0;
+
+    if (date == NULL || sscanf(date, "%4d%2d%2d", &year, &month, &day) != 3) {
+        return 0;
+    }
+    if (time != NULL) {
+        sscanf(time, "%2d%2d%2d", &hour, &minute, &second);
+    }
+
+    // days since 1970-01-01 of the proleptic Gregorian calendar,
+    // counting years from March such that leap days come last
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+
+} // vpbTime
+
+
+
+// ------------------------------------------------------------- //
+//                            writing                            //
+// ------------------------------------------------------------- //
+
+// appends the profiles of a volume to a vpb file, creating the file if it does not exist.
+// The profiles are row-major arrays of nLayers rows and nCols columns, as returned by
+// vol2birdGetProfile. Returns 0 on success and -1 on failure.
+int vpbAppend(const char* filename, const vpbMeta_t* meta, const int nLayers, const int nCols,
+              const float* profileBio, const float* profileAll) {
+
+    unsigned char header[VPB_HEADER_SIZE];
+    const size_t recordSize = VPB_META_SIZE + (size_t) VPB_NPROFILES * nCols * nLayers * 4;
+    const float* profiles[VPB_NPROFILES] = {profileBio, profileAll};
+    unsigned char* record = NULL;
+    int result = -1;
+    FILE* fp;
+
+    fp = fopen(filename, "r+b");
+    if (fp == NULL) {
+        // start a new file
+        fp = fopen(filename, "w+b");
+        if (fp == NULL) {
+            vol2bird_err_printf("Failed to open file %s for writing.\n", filename);
+            return -1;
+        }
+        memset(header, 0, sizeof(header));
+        memcpy(header, VPB_MAGIC, 8);
+        putUint32(header + 8, VPB_VERSION);
+        putUint32(header + 12, VPB_HEADER_SIZE);
+        putUint32(header + 16, nLayers);
+        putUint32(header + 20, nCols);
+        putUint32(header + 24, VPB_NPROFILES);
+        putUint32(header + 28, recordSize);
+        if (fwrite(header, sizeof(header), 1, fp) != 1) {
+            vol2bird_err_printf("Failed to write header of file %s.\n", filename);
+            goto done;
+        }
+    }
+    else {
+        // the schema is fixed per file, the profiles have to match it
+        if (fread(header, sizeof(header), 1, fp) != 1 || memcmp(header, VPB_MAGIC, 8) != 0 ||
+            getUint32(header + 8) != VPB_VERSION) {
+            vol2bird_err_printf("Error: %s is not a vpb file of version %i.\n", filename, VPB_VERSION);
+            goto done;
+        }
+        if (getUint32(header + 16) != (uint32_t) nLayers || getUint32(header + 20) != (uint32_t) nCols ||
+            getUint32(header + 24) != VPB_NPROFILES || getUint32(header + 28) != recordSize) {
+            vol2bird_err_printf("Error: profiles of %i layers and %i columns cannot be added to %s, which holds profiles of %u layers and %u columns.\n",
+                                nLayers, nCols, filename, getUint32(header + 16), getUint32(header + 20));
+            goto done;
+        }
+        if (fseek(fp, 0, SEEK_END) != 0) {
+            goto done;
+        }
+        // do not add behind a partially written record
+        long fileSize = ftell(fp);
+        if (fileSize < VPB_HEADER_SIZE || (fileSize - VPB_HEADER_SIZE) % recordSize != 0) {
+            vol2bird_err_printf("Error: %s ends in an incomplete record.\n", filename);
+            goto done;
+        }
+    }
+
+    record = (unsigned char*) calloc(recordSize, 1);
+    if (record == NULL) {
+        vol2bird_err_printf("Error allocating memory for vpb record\n");
+        goto done;
+    }
+
+    strncpy((char*) record, meta->radar, 16);
+    putUint64(record + 16, (uint64_t) meta->time);
+    putFloat64(record + 24, meta->latitude);
+    putFloat64(record + 32, meta->longitude);
+    putFloat32(record + 40, meta->height);
+    putFloat32(record + 44, meta->wavelength);
+    putFloat32(record + 48, meta->rcs);
+    putFloat32(record + 52, meta->sdVvpThresh);
+    putUint32(record + 56, (uint32_t) meta->vcp);
+
+    // store the profiles column by column
+    unsigned char* p = record + VPB_META_SIZE;
+    for (int iProfile = 0; iProfile < VPB_NPROFILES; iProfile++) {
+        for (int iCol = 0; iCol < nCols; iCol++) {
+            for (int iLayer = 0; iLayer < nLayers; iLayer++) {
+                putFloat32(p, profiles[iProfile][iLayer * nCols + iCol]);
+                p += 4;
+            }
+        }
+    }
+
+    if (fwrite(record, recordSize, 1, fp) != 1) {
+        vol2bird_err_printf("Failed to write to file %s.\n", filename);
+        goto done;
+    }
+
+    result = 0;
+
+done:
+    free(record);
+    if (fclose(fp) != 0) {
+        vol2bird_err_printf("Failed to close file %s.\n", filename);
+        result = -1;
+    }
+
+    return result;
+
+} // vpbAppend
+
+
+
+// ------------------------------------------------------------- //
+//                            reading                            //
+// ------------------------------------------------------------- //
+
+static int compareIndexEntries(const void* a, const void* b) {
+
+    const struct vpbIndexEntry* entryA = (const struct vpbIndexEntry*) a;
+    const struct vpbIndexEntry* entryB = (const struct vpbIndexEntry*) b;
+
+    int result = strncmp(entryA->radar, entryB->radar, 16);
+    if (result == 0 && entryA->time != entryB->time) {
+        result = entryA->time < entryB->time ? -1 : 1;
+    }
+    if (result == 0 && entryA->iRecord != entryB->iRecord) {
+        result = entryA->iRecord < entryB->iRecord ? -1 : 1;
+    }
+
+    return result;
+
+} // compareIndexEntries
+
+
+
+// memory-maps a vpb file and indexes its records by radar and time,
+// returns NULL on failure. Close the reader with vpbClose.
+vpbReader_t* vpbOpen(const char* filename) {
+
+    struct stat st;
+    vpbReader_t* reader = (vpbReader_t*) calloc(1, sizeof(vpbReader_t));
+
+    if (reader == NULL) {
+        vol2bird_err_printf("Error allocating memory for vpb reader\n");
+        return NULL;
+    }
+    reader->fd = -1;
+    reader->map = MAP_FAILED;
+
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0 || fstat(reader->fd, &st) != 0) {
+        vol2bird_err_printf("Failed to open file %s for reading.\n", filename);
+        goto error;
+    }
+
+    reader->mapSize = st.st_size;
+    if (reader->mapSize < VPB_HEADER_SIZE) {
+        vol2bird_err_printf("Error: %s is not a vpb file.\n", filename);
+        goto error;
+    }
+
+    reader->map = mmap(NULL, reader->mapSize, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        vol2bird_err_printf("Failed to memory-map file %s.\n", filename);
+        goto error;
+    }
+
+    if (memcmp(reader->map, VPB_MAGIC, 8) != 0 || getUint32(reader->map + 8) != VPB_VERSION) {
+        vol2bird_err_printf("Error: %s is not a vpb file of version %i.\n", filename, VPB_VERSION);
+        goto error;
+    }
+
+    uint32_t headerSize = getUint32(reader->map + 12);
+    uint32_t nLayers = getUint32(reader->map + 16);
+    uint32_t nCols = getUint32(reader->map + 20);
+    uint32_t nProfiles = getUint32(reader->map + 24);
+    uint32_t recordSize = getUint32(reader->map + 28);
+
+    // the bounds keep the product below in range, such that the record
+    // size check cannot be passed by a wrapped around product
+    if (headerSize != VPB_HEADER_SIZE ||
+        nLayers < 1 || nLayers > VPB_NLAYERS_MAX ||
+        nCols < 1 || nCols > VPB_NCOLS_MAX ||
+        nProfiles < 1 || nProfiles > VPB_NPROFILES_MAX ||
+        (uint64_t) recordSize != VPB_META_SIZE + (uint64_t) nProfiles * nCols * nLayers * 4) {
+        vol2bird_err_printf("Error: inconsistent header in vpb file %s.\n", filename);
+        goto error;
+    }
+
+    reader->nLayers = (int) nLayers;
+    reader->nCols = (int) nCols;
+    reader->nProfiles = (int) nProfiles;
+    reader->recordSize = recordSize;
+
+    // ignore an incomplete record at the end, e.g. one that is being written
+    reader->nRecords = (reader->mapSize - VPB_HEADER_SIZE) / reader->recordSize;
+
+    reader->index = (struct vpbIndexEntry*) malloc((reader->nRecords > 0 ? reader->nRecords : 1) * sizeof(struct vpbIndexEntry));
+    if (reader->index == NULL) {
+        vol2bird_err_printf("Error allocating memory for the index of vpb file %s\n", filename);
+        goto error;
+    }
+    for (long iRecord = 0; iRecord < reader->nRecords; iRecord++) {
+        const unsigned char* record = recordPointer(reader, iRecord);
+        memcpy(reader->index[iRecord].radar, record, 16);
+        reader->index[iRecord].time = (int64_t) getUint64(record + 16);
+        reader->index[iRecord].iRecord = iRecord;
+    }
+    qsort(reader->index, reader->nRecords, sizeof(struct vpbIndexEntry), compareIndexEntries);
+
+    return reader;
+
+error:
+    vpbClose(reader);
+    return NULL;
+
+} // vpbOpen
+
+
+
+void vpbClose(vpbReader_t* reader) {
+
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->map != MAP_FAILED) {
+        munmap((void*) reader->map, reader->mapSize);
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    free(reader->index);
+    free(reader);
+
+} // vpbClose
+
+
+
+static const unsigned char* recordPointer(const vpbReader_t* reader, const long iRecord) {
+
+    return reader->map + VPB_HEADER_SIZE + iRecord * reader->recordSize;
+
+} // recordPointer
+
+
+
+// finds the record of the latest profile of 'radar' at or before 'time', as returned by
+// vpbTime. Returns the record number, or -1 when there is no such record.
+long vpbFind(const vpbReader_t* reader, const char* radar, const int64_t time) {
+
+    long iLow = 0;
+    long iHigh = reader->nRecords;
+    struct vpbIndexEntry key;
+
+    memset(key.radar, 0, sizeof(key.radar));
+    strncpy(key.radar, radar, sizeof(key.radar));
+    key.time = time;
+    key.iRecord = reader->nRecords;
+
+    // the first entry after the key
+    while (iLow < iHigh) {
+        long iMid = iLow + (iHigh - iLow) / 2;
+        if (compareIndexEntries(&reader->index[iMid], &key) <= 0) {
+            iLow = iMid + 1;
+        }
+        else {
+            iHigh = iMid;
+        }
+    }
+
+    if (iLow == 0 || strncmp(reader->index[iLow - 1].radar, key.radar, 16) != 0) {
+        return -1;
+    }
+
+    return reader->index[iLow - 1].iRecord;
+
+} // vpbFind
+
+
+
+int vpbGetMeta(const vpbReader_t* reader, const long iRecord, vpbMeta_t* meta) {
+
+    if (iRecord < 0 || iRecord >= reader->nRecords) {
+        return -1;
+    }
+
+    const unsigned char* record = recordPointer(reader, iRecord);
+
+    memcpy(meta->radar, record, 16);
+    meta->radar[15] = '\0';
+    meta->time = (int64_t) getUint64(record + 16);
+    meta->latitude = getFloat64(record + 24);
+    meta->longitude = getFloat64(record + 32);
+    meta->height = getFloat32(record + 40);
+    meta->wavelength = getFloat32(record + 44);
+    meta->rcs = getFloat32(record + 48);
+    meta->sdVvpThresh = getFloat32(record + 52);
+    meta->vcp = (int32_t) getUint32(record + 56);
+
+    return 0;
+
+} // vpbGetMeta
+
+
+
+// copies column iCol of profile iProfile (0 for birds, 1 for all scatterers)
+// of a record into 'values', which has room for nLayers values
+int vpbGetColumn(const vpbReader_t* reader, const long iRecord, const int iProfile, const int iCol, float* values) {
+
+    if (iRecord < 0 || iRecord >= reader->nRecords || iProfile < 0 || iProfile >= reader->nProfiles ||
+        iCol < 0 || iCol >= reader->nCols) {
+        return -1;
+    }
+
+    const unsigned char* p = recordPointer(reader, iRecord) + VPB_META_SIZE +
+                             ((size_t) iProfile * reader->nCols + iCol) * reader->nLayers * 4;
+
+    for (int iLayer = 0; iLayer < reader->nLayers; iLayer++) {
+        values[iLayer] = getFloat32(p + 4 * iLayer);
+    }
+
+    return 0;
+
+} // vpbGetColumn
+
+
+
+// copies profile iProfile (0 for birds, 1 for all scatterers) of a record into 'profile',
+// a row-major array of nLayers rows and nCols columns as returned by vol2birdGetProfile
+int vpbGetProfile(const vpbReader_t* reader, const long iRecord, const int iProfile, float* profile) {
+
+    if (iRecord < 0 || iRecord >= reader->nRecords || iProfile < 0 || iProfile >= reader->nProfiles) {
+        return -1;
+    }
+
+    const unsigned char* p = recordPointer(reader, iRecord) + VPB_META_SIZE +
+                             (size_t) iProfile * reader->nCols * reader->nLayers * 4;
+
+    for (int iCol = 0; iCol < reader->nCols; iCol++) {
+        for (int iLayer = 0; iLayer < reader->nLayers; iLayer++) {
+            profile[iLayer * reader->nCols + iCol] = getFloat32(p);
+            p += 4;
+        }
+    }
+
+    return 0;
+
+} // vpbGetProfile
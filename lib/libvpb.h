@@ -0,0 +1,109 @@
+/** Compact binary format for time series of vertical profiles
+ * @file libvpb.h
+ *
+ * A vpb file holds the profiles of many volumes, e.g. a year of profiles of
+ * a network of radars, such that they can be loaded without parsing CSV or
+ * opening an ODIM file per profile. It is little-endian throughout and has a
+ * fixed schema:
+ *
+ * header, VPB_HEADER_SIZE bytes:
+ *   0  char[8]  magic "VOL2BVPB"
+ *   8  uint32   version (VPB_VERSION)
+ *  12  uint32   header size in bytes
+ *  16  uint32   nLayers, number of altitude layers (rows) of the profiles
+ *  20  uint32   nCols, number of columns of the profiles
+ *  24  uint32   nProfiles, number of profiles per record (VPB_NPROFILES)
+ *  28  uint32   record size in bytes
+ *  32  reserved, zero
+ *
+ * followed by one record per volume, each of the record size:
+ *   0  char[16] radar name, zero padded
+ *  16  int64    nominal time of the volume, seconds since 1970-01-01 UTC
+ *  24  float64  radar latitude [deg]
+ *  32  float64  radar longitude [deg]
+ *  40  float32  radar height [m]
+ *  44  float32  radar wavelength [cm]
+ *  48  float32  radar cross section of a bird [cm^2]
+ *  52  float32  sd_vvp threshold [m/s]
+ *  56  int32    volume coverage pattern
+ *  60  reserved, zero
+ *  64  float32  data[nProfiles][nCols][nLayers]
+ *
+ * The profiles are those of vol2birdGetProfile, i.e. the bird profile (type 1)
+ * followed by the profile of all scatterers (type 3), with the columns of
+ * mapDataToRave (HGHT, altmax, u, v, w, ff, dd, sd_vvp, gap, dbz, n, eta, dens,
+ * n_dbz). They are stored column by column, so that a quantity of a profile is
+ * contiguous. Records are appended in the order in which volumes are processed.
+ */
+
+#ifndef LIBVPB_H
+#define LIBVPB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VPB_MAGIC "VOL2BVPB"
+#define VPB_VERSION 1
+#define VPB_HEADER_SIZE 64
+#define VPB_META_SIZE 64
+// the bird profile and the profile of all scatterers
+#define VPB_NPROFILES 2
+// upper limits of the header fields accepted by vpbOpen
+#define VPB_NLAYERS_MAX 65536
+#define VPB_NCOLS_MAX 1024
+#define VPB_NPROFILES_MAX 64
+
+// the metadata of a record
+struct vpbMeta {
+    char radar[16];
+    int64_t time;
+    double latitude;
+    double longitude;
+    float height;
+    float wavelength;
+    float rcs;
+    float sdVvpThresh;
+    int32_t vcp;
+};
+typedef struct vpbMeta vpbMeta_t;
+
+// the position of a record in the radar and time ordered index of a reader
+struct vpbIndexEntry {
+    char radar[16];
+    int64_t time;
+    long iRecord;
+};
+
+// a vpb file opened for reading, memory-mapped
+struct vpbReader {
+    int fd;
+    const unsigned char* map;
+    size_t mapSize;
+    int nLayers;
+    int nCols;
+    int nProfiles;
+    size_t recordSize;
+    long nRecords;
+    // the records sorted by radar and time
+    struct vpbIndexEntry* index;
+};
+typedef struct vpbReader vpbReader_t;
+
+int64_t vpbTime(const char* date, const char* time);
+
+int vpbAppend(const char* filename, const vpbMeta_t* meta, const int nLayers, const int nCols,
+              const float* profileBio, const float* profileAll);
+
+vpbReader_t* vpbOpen(const char* filename);
+
+void vpbClose(vpbReader_t* reader);
+
+long vpbFind(const vpbReader_t* reader, const char* radar, const int64_t time);
+
+int vpbGetMeta(const vpbReader_t* reader, const long iRecord, vpbMeta_t* meta);
+
+int vpbGetColumn(const vpbReader_t* reader, const long iRecord, const int iProfile, const int iCol, float* values);
+
+int vpbGetProfile(const vpbReader_t* reader, const long iRecord, const int iProfile, float* profile);
+
+#endif
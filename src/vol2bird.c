@@ -28,6 +28,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <getopt.h>
 #include <string.h>
@@ -44,7 +45,9 @@ void usage(char *programName, int verbose)
 {
     fprintf(stderr, "vol2bird version %s (%s)\n", VERSION, VERSIONDATE);
     fprintf(stderr, "   usage: %s <polar volume> [<ODIM hdf5 profile output> [<ODIM hdf5 volume output>]]\n", programName);
-    fprintf(stderr, "   usage: %s -i <polar volume or scan> [-i <polar scan> [-i <polar scan>] ...] [-o <ODIM hdf5 profile output>] [-p <ODIM hdf5 volume output>] [-c <vol2bird configuration file>]\n", programName);
+    fprintf(stderr, "   usage: %s -i <polar volume or scan> [-i <polar scan> [-i <polar scan>] ...] [-o <ODIM hdf5 profile output>] [-p <ODIM hdf5 volume output>] [-t <VPTS CSV time series output>] [-c <vol2bird configuration file>]\n", programName);
+    fprintf(stderr, "   usage: %s -b <batch file, or - for stdin> [-t <VPTS CSV time series output>] [-c <vol2bird configuration file>]\n", programName);
+    fprintf(stderr, "   a polar volume input of - reads the polar volume from stdin\n");
     fprintf(stderr, "   usage: %s --help\n", programName);
 
     if (verbose)
@@ -75,6 +78,24 @@ void usage(char *programName, int verbose)
         fprintf(stderr, " [disabled]\n\n");
 #endif
 
+        fprintf(stderr, "   Batch mode:\n");
+        fprintf(stderr, "   Each line of the batch file lists one polar volume to process, as\n");
+        fprintf(stderr, "   <polar volume> [<profile output> [<ODIM hdf5 volume output>]]\n");
+        fprintf(stderr, "   where a profile output of '-' writes no profile file. Empty lines and lines\n");
+        fprintf(stderr, "   starting with '#' are ignored. The configuration is loaded once for all volumes.\n");
+        fprintf(stderr, "   Profile outputs in VPTS CSV format that are listed on several lines receive the\n");
+        fprintf(stderr, "   profiles of all those volumes, with a single header.\n\n");
+
+        fprintf(stderr, "   VPTS CSV time series output:\n");
+        fprintf(stderr, "   The profiles of all volumes are added to the VPTS CSV file given by -t, in which\n");
+        fprintf(stderr, "   {radar} and {date} are replaced by the radar name and date (YYYYMMDD) of each volume,\n");
+        fprintf(stderr, "   e.g. -t {radar}_vpts_{date}.csv writes one file per radar per day. Rows are merged\n");
+        fprintf(stderr, "   with those of an existing file, sorted by time.\n\n");
+
+        fprintf(stderr, "   Binary profile time series output:\n");
+        fprintf(stderr, "   A profile output with extension .vpb is appended to a compact binary time series,\n");
+        fprintf(stderr, "   see lib/libvpb.h for the format and a memory-mapped reader.\n\n");
+
         fprintf(stderr, "   Output fields to stdout:\n");
         fprintf(stderr, "   date      - date [UTC]\n");
         fprintf(stderr, "   time      - time [UTC]\n");
@@ -99,6 +120,414 @@ void usage(char *programName, int verbose)
     }
 }
 
+// reads all of stdin into a newly allocated buffer, returns NULL on failure
+static void *readStdin(size_t *size)
+{
+    size_t capacity = 1 << 20;
+    char *buffer = malloc(capacity);
+    size_t n;
+
+    *size = 0;
+
+    while (buffer != NULL && (n = fread(buffer + *size, 1, capacity - *size, stdin)) > 0)
+    {
+        *size += n;
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            char *bufferNew = realloc(buffer, capacity);
+            if (bufferNew == NULL)
+            {
+                free(buffer);
+            }
+            buffer = bufferNew;
+        }
+    }
+
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Error: failed to allocate memory for reading stdin\n");
+        return NULL;
+    }
+    if (ferror(stdin))
+    {
+        fprintf(stderr, "Error: failed to read from stdin\n");
+        free(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+
+// read a polar volume from fileIn, or from the stdin contents in buffer, and calculate its
+// profiles. The volume is returned in 'volume', also on failure, for the caller to release.
+static int calculateProfiles(vol2bird_t *alldata, char *fileIn[], int nInputFiles,
+                             const void *buffer, size_t size, const char *fileVolOut,
+                             PolarVolume_t **volume)
+{
+    // read in data up to a distance of alldata->misc.rCellMax
+    // we do not read in the full volume for speed/memory
+    float rangeRead = alldata->misc.rCellMax;
+
+    // MistNet segments a Cartesian image that extends beyond rCellMax
+    if (alldata->options.useMistNet && rangeRead < 0.5f * MISTNET_DIMENSION * MISTNET_RESOLUTION)
+    {
+        rangeRead = 0.5f * MISTNET_DIMENSION * MISTNET_RESOLUTION;
+    }
+
+    // the polar volume output keeps the full range of the input
+    if (fileVolOut != NULL)
+    {
+        rangeRead = 1000000;
+    }
+
+    // only read the quantities and scans we use, unless the full volume is written out again
+    if (buffer != NULL)
+    {
+        // decode the polar volume from stdin in memory, without a temporary file
+        *volume = vol2birdGetVolumeFromBuffer(buffer, size, NULL, rangeRead, 1,
+                                              fileVolOut == NULL ? alldata : NULL);
+    }
+    else
+    {
+        *volume = vol2birdGetVolumeSelected(fileIn, nInputFiles, rangeRead, 1,
+                                            fileVolOut == NULL ? alldata : NULL);
+    }
+
+    if (*volume == NULL)
+    {
+        fprintf(stderr, "Error: failed to read radar volume\n");
+        return -1;
+    }
+
+    // loading static clutter map upon request
+    if (alldata->options.useClutterMap)
+    {
+        int clutterSuccessful = vol2birdLoadClutterMap(*volume, alldata->options.clutterMap, alldata->misc.rCellMax) == 0;
+
+        if (clutterSuccessful == FALSE)
+        {
+            fprintf(stderr, "Error: failed to load static clutter map '%s', aborting\n", alldata->options.clutterMap);
+            return -1;
+        }
+    }
+
+    // resample the volume upon request
+    if (alldata->options.resample)
+    {
+        PolarVolume_t *volume_orig = *volume;
+        *volume = PolarVolume_resample(*volume, alldata->options.resampleRscale,
+                                       alldata->options.resampleNbins, alldata->options.resampleNrays);
+        RAVE_OBJECT_RELEASE(volume_orig);
+        if (*volume == NULL)
+        {
+            fprintf(stderr, "Error: volume resampling failed\n");
+            return -1;
+        }
+    }
+
+    // initialize volbird library
+    int initSuccessful = vol2birdSetUp(*volume, alldata) == 0;
+
+    if (initSuccessful == FALSE)
+    {
+        fprintf(stderr, "Error: failed to initialize vol2bird\n");
+        return -1;
+    }
+
+    // output (optionally de-aliased) volume
+    if (fileVolOut != NULL)
+    {
+        saveToODIM((RaveCoreObject *)*volume, fileVolOut);
+    }
+
+    // call vol2bird's main routine
+    vol2birdCalcProfiles(alldata);
+
+    return 0;
+}
+
+
+// process a single polar volume with an already loaded vol2bird configuration,
+// returns 0 on success and -1 on failure
+static int processVolume(vol2bird_t *alldata, char *fileIn[], int nInputFiles,
+                         const char *fileVpOut, const char *fileVolOut,
+                         vol2birdVptsWriter_t *vptsWriter, const char *fileVptsOut)
+{
+    int status = -1;
+    PolarVolume_t *volume = NULL;
+    void *buffer = NULL;
+    size_t size = 0;
+    char cacheKey[VOL2BIRD_CACHE_KEY_LENGTH];
+    int useCache = FALSE;
+    int cacheHit = FALSE;
+
+    // store the input filename TODO: add other input files
+    if (strlen(fileIn[0]) >= sizeof(alldata->misc.filename_pvol) ||
+        (fileVpOut != NULL && strlen(fileVpOut) >= sizeof(alldata->misc.filename_vp)))
+    {
+        fprintf(stderr, "Error: file name too long, at most %i characters are supported\n",
+                (int) sizeof(alldata->misc.filename_pvol) - 1);
+        goto done;
+    }
+    snprintf(alldata->misc.filename_pvol, sizeof(alldata->misc.filename_pvol), "%s", fileIn[0]);
+    snprintf(alldata->misc.filename_vp, sizeof(alldata->misc.filename_vp), "%s", fileVpOut != NULL ? fileVpOut : "");
+
+    if (strcmp(fileIn[0], "-") == 0)
+    {
+        buffer = readStdin(&size);
+        if (buffer == NULL)
+        {
+            fprintf(stderr, "Error: failed to read radar volume\n");
+            goto done;
+        }
+    }
+
+    // look up the profile in the cache, unless the polar volume itself is written out
+    if (fileVolOut == NULL && alldata->options.cacheDir[0] != '\0')
+    {
+        if (buffer != NULL)
+        {
+            useCache = vol2birdCacheKeyFromBuffer(buffer, size, alldata, cacheKey) == 0;
+        }
+        else
+        {
+            useCache = vol2birdCacheKey(fileIn, nInputFiles, alldata, cacheKey) == 0;
+        }
+        cacheHit = useCache && vol2birdCacheLoad(cacheKey, alldata, &volume) == 0;
+    }
+
+    if (cacheHit == FALSE && calculateProfiles(alldata, fileIn, nInputFiles, buffer, size, fileVolOut, &volume) != 0)
+    {
+        goto done;
+    }
+
+    // ------------------------------------------------------------------- //
+    //  using getter functions to access at the profile data               //
+    // ------------------------------------------------------------------- //
+    const char *date;
+    const char *time;
+    const char *source;
+
+    date = PolarVolume_getDate(volume);
+    time = PolarVolume_getTime(volume);
+    source = PolarVolume_getSource(volume);
+    
+    { // getter example scope begin
+
+        int nRowsProfile = vol2birdGetNRowsProfile(alldata);
+        int nColsProfile = vol2birdGetNColsProfile(alldata);
+
+        fprintf(stdout, "# vol2bird Vertical Profile of Birds (VPB)\n");
+        fprintf(stdout, "# source: %s\n", source);
+        fprintf(stdout, "# polar volume input: %s\n", fileIn[0]);
+        if (alldata->misc.vcp > 0)
+            fprintf(stdout, "# volume coverage pattern (VCP): %i\n", alldata->misc.vcp);
+        printf("# date   time HGHT u v w ff dd sd_vvp gap dbz     eta   dens   DBZH   n   n_dbz n_all n_dbz_all\n");
+
+        float *profileBio;
+        float *profileAll;
+
+        profileBio = vol2birdGetProfile(1, alldata);
+        profileAll = vol2birdGetProfile(3, alldata);
+
+        printf("alldata.misc.vcp = %d\n", alldata->misc.vcp);
+
+        int iRowProfile;
+        int iCopied = 0;
+
+        for (iRowProfile = 0; iRowProfile < nRowsProfile; iRowProfile++)
+        {
+            iCopied = iRowProfile * nColsProfile;
+            printf("%8s %.4s ", date, time);
+            printf("%4.f %6.2f %6.2f %7.2f %5.2f %5.1f %6.2f %s %6.2f %6.1f %6.2f %6.2f %5.f %5.f %5.f %5.f\n",
+                   profileBio[0 + iCopied],                                           // hght
+                   nanify(profileBio[2 + iCopied]), nanify(profileBio[3 + iCopied]),  // u,v
+                   nanify(profileBio[4 + iCopied]), nanify(profileBio[5 + iCopied]),  // w,ff
+                   nanify(profileBio[6 + iCopied]), nanify(profileAll[7 + iCopied]),  // dd,sd_vvp
+                   profileBio[8 + iCopied] == TRUE ? "TRUE" : "FALSE",                       // gap
+                   nanify(profileBio[9 + iCopied]), nanify(profileBio[11 + iCopied]), //  dbz,eta
+                   nanify(profileBio[12 + iCopied]), nanify(profileAll[9 + iCopied]), //  dens, dbz_all (dbzh)
+                   nanify(profileBio[10 + iCopied]), nanify(profileBio[13 + iCopied]),
+                   nanify(profileAll[10 + iCopied]), nanify(profileAll[13 + iCopied]));
+        }
+        profileAll = NULL;
+        profileBio = NULL;
+
+    } // getter scope end
+
+
+    // ------------------------------------------------------------------- //
+    //                 end of the getter example section                   //
+    // ------------------------------------------------------------------- //
+
+    // map vol2bird profile data to Rave profile object, a cached profile already is
+    if (cacheHit == FALSE)
+    {
+        mapDataToRave(volume, alldata);
+
+        if (useCache)
+        {
+            vol2birdCacheStore(cacheKey, volume, alldata);
+        }
+    }
+
+    // save rave profile to ODIM hdf5, or generate VPTS csv or vpb based on a .csv or .vpb extension
+    if (fileVpOut != NULL)
+    {
+        int result;
+        if(isCSV(fileVpOut) && vptsWriter != NULL){
+            // append to a file that was started for an earlier volume of this run
+            result = vol2birdVptsWriterAdd(vptsWriter, fileVpOut, FALSE, alldata, volume);
+        }
+        else if(isCSV(fileVpOut)){
+            result = saveToCSV(fileVpOut, alldata, volume);
+        }
+        else if(isVPB(fileVpOut)){
+            // binary profile time series, appended to
+            result = saveToVPB(fileVpOut, alldata, volume);
+        }
+        else{
+            result = saveToODIM((RaveCoreObject *)alldata->vp, fileVpOut);
+        }
+        
+        if (result == FALSE){
+            fprintf(stderr, "critical error, cannot write file %s\n", fileVpOut);
+            goto done;
+        }
+    }
+
+    // add the profile to the VPTS CSV time series
+    if (fileVptsOut != NULL)
+    {
+        if (vol2birdVptsWriterAdd(vptsWriter, fileVptsOut, TRUE, alldata, volume) == FALSE)
+        {
+            fprintf(stderr, "critical error, cannot write VPTS CSV time series %s\n", fileVptsOut);
+            goto done;
+        }
+    }
+
+    status = 0;
+
+done:
+    // give the memory of this volume back, but keep the configuration
+    if (alldata->misc.initializationSuccessful == TRUE)
+    {
+        vol2birdTearDownVolume(alldata);
+    }
+    RAVE_OBJECT_RELEASE(volume);
+    free(buffer);
+
+    return status;
+}
+
+
+// process all polar volumes listed in a batch file (or stdin when batchFile is "-"),
+// reusing the configuration that is loaded in alldata. VPTS CSV output is written
+// through vptsWriter. Returns the number of volumes that failed, or -1 when the
+// batch file cannot be opened.
+static int processBatch(vol2bird_t *alldata, const char *batchFile,
+                        vol2birdVptsWriter_t *vptsWriter, const char *fileVptsOut)
+{
+    FILE *fp;
+    char line[3 * 1000 + 10];
+    int iLine = 0;
+    int nSucceeded = 0;
+    int nFailed = 0;
+
+    if (strcmp(batchFile, "-") == 0)
+    {
+        fp = stdin;
+    }
+    else
+    {
+        fp = fopen(batchFile, "r");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "Error: cannot open batch file '%s'\n", batchFile);
+            return -1;
+        }
+    }
+
+    // vol2birdSetUp adapts some options to the volume at hand (wavelength,
+    // dealiasing, polarization mode), so we restore the configured options
+    // before processing each volume
+    vol2birdOptions_t optionsConfigured = alldata->options;
+
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        iLine++;
+
+        // a line that does not fit in the buffer is not split into several entries
+        if (strchr(line, '\n') == NULL && !feof(fp))
+        {
+            int c;
+            while ((c = fgetc(fp)) != EOF && c != '\n')
+                ;
+            nFailed++;
+            fprintf(stderr, "batch line %i: line too long, at most %i characters are supported\n",
+                    iLine, (int) sizeof(line) - 2);
+            continue;
+        }
+
+        char *fileIn[1];
+        char *fileVpOut = NULL;
+        char *fileVolOut = NULL;
+
+        fileIn[0] = strtok(line, " \t\r\n");
+        if (fileIn[0] == NULL || fileIn[0][0] == '#')
+        {
+            continue;
+        }
+        fileVpOut = strtok(NULL, " \t\r\n");
+        if (fileVpOut != NULL)
+        {
+            fileVolOut = strtok(NULL, " \t\r\n");
+        }
+        if (fileVpOut != NULL && strcmp(fileVpOut, "-") == 0)
+        {
+            fileVpOut = NULL;
+        }
+
+        int status = -1;
+
+        if (!isRegularFile(fileIn[0]))
+        {
+            fprintf(stderr, "Error: input file '%s' does not exist.\n", fileIn[0]);
+        }
+        else
+        {
+            alldata->options = optionsConfigured;
+            status = processVolume(alldata, fileIn, 1, fileVpOut, fileVolOut, vptsWriter, fileVptsOut);
+        }
+
+        if (status == 0)
+        {
+            nSucceeded++;
+            fprintf(stderr, "batch line %i: %s OK\n", iLine, fileIn[0]);
+        }
+        else
+        {
+            nFailed++;
+            fprintf(stderr, "batch line %i: %s FAILED\n", iLine, fileIn[0]);
+        }
+        fflush(stdout);
+    }
+
+    if (fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    alldata->options = optionsConfigured;
+
+    fprintf(stderr, "batch done: %i volumes processed, %i succeeded, %i failed\n", nSucceeded + nFailed, nSucceeded, nFailed);
+
+    return nFailed;
+}
+
+
 int main(int argc, char **argv)
 {
     //    cfg_t* cfg;
@@ -126,6 +555,10 @@ int main(int argc, char **argv)
     const char *fileVolOut = NULL;
     // the (optional) options.conf file path that the user specified as input
     const char *optionsFile = NULL;
+    // the (optional) batch file listing the volumes to process, "-" for stdin
+    const char *batchFile = NULL;
+    // the (optional) VPTS CSV file that the profiles of all volumes are added to
+    const char *fileVptsOut = NULL;
     // the optional flag to output vpts in CSV format
     int formatCSV = 0;
 
@@ -137,13 +570,14 @@ int main(int argc, char **argv)
             strcmp("-o", argv[i]) == 0 || strcmp("--output", argv[i]) == 0 ||
             strcmp("-p", argv[i]) == 0 || strcmp("--pvol", argv[i]) == 0 ||
             strcmp("-c", argv[i]) == 0 || strcmp("--config", argv[i]) == 0 ||
+            strcmp("-b", argv[i]) == 0 || strcmp("--batch", argv[i]) == 0 ||
+            strcmp("-t", argv[i]) == 0 || strcmp("--vpts", argv[i]) == 0 ||
             strcmp("-h", argv[i]) == 0 || strcmp("--help", argv[i]) == 0 ||
             strcmp("-v", argv[i]) == 0 || strcmp("--version", argv[i]) == 0)
         {
             commandLineFormat = 1;
         }
     }
-
     // interpret legacy command line input
     if (commandLineFormat == 0){
         // check to see if we have the right number of input arguments
@@ -192,12 +626,14 @@ int main(int argc, char **argv)
                     {"output", required_argument, 0, 'o'},
                     {"pvol", required_argument, 0, 'p'},
                     {"config", required_argument, 0, 'c'},
+                    {"batch", required_argument, 0, 'b'},
+                    {"vpts", required_argument, 0, 't'},
                     {0, 0, 0, 0}};
 
             /* getopt_long stores the option index here. */
             int option_index = 0;
 
-            c = getopt_long(argc, argv, "hvi:o:p:c:",
+            c = getopt_long(argc, argv, "hvi:o:p:c:b:t:",
                             long_options, &option_index);
 
             /* Detect the end of the options. */
@@ -250,6 +686,14 @@ int main(int argc, char **argv)
                 optionsFile = optarg;
                 break;
 
+            case 'b':
+                batchFile = optarg;
+                break;
+
+            case 't':
+                fileVptsOut = optarg;
+                break;
+
             case '?':
                 /* getopt_long already printed an error message. */
                 break;
@@ -269,10 +713,38 @@ int main(int argc, char **argv)
         }
     }
 
+    // batch mode reads its input and output files from the batch file
+    if (batchFile != NULL && (nInputFiles > 0 || fileVpOut != NULL || fileVolOut != NULL))
+    {
+        fprintf(stderr, "Error: options --input, --output and --pvol cannot be combined with --batch\n");
+        return -1;
+    }
+    if (batchFile == NULL && nInputFiles == 0)
+    {
+        fprintf(stderr, "Error: no input file specified\n");
+        usage(argv[0], 0);
+        return -1;
+    }
+    if (batchFile != NULL && strcmp(batchFile, "-") != 0 && !isRegularFile(batchFile))
+    {
+        fprintf(stderr, "Error: batch file '%s' does not exist.\n", batchFile);
+        return -1;
+    }
+
+    // stdin holds a single polar volume
+    for (int i = 0; i < nInputFiles; i++)
+    {
+        if (strcmp(fileIn[i], "-") == 0 && nInputFiles > 1)
+        {
+            fprintf(stderr, "Error: input from stdin cannot be combined with other input files\n");
+            return -1;
+        }
+    }
+
     // check that input files exist
     for (int i = 0; i < nInputFiles; i++)
     {
-        if (!isRegularFile(fileIn[i]))
+        if (strcmp(fileIn[i], "-") != 0 && !isRegularFile(fileIn[i]))
         {
             fprintf(stderr, "Error: input file '%s' does not exist.\n", fileIn[i]);
             return -1;
@@ -300,16 +772,8 @@ int main(int argc, char **argv)
     // Rave_setDebugLevel(RAVE_WARNING);
     // Rave_setDebugLevel(RAVE_INFO);
 
-    // store the input filename TODO: add other input files
-    strcpy(alldata.misc.filename_pvol, fileIn[0]);
-    if (fileVpOut != NULL)
-    {
-        strcpy(alldata.misc.filename_vp, fileVpOut);
-    }
-    else
-    {
-        strcpy(alldata.misc.filename_vp, "");
-    }
+    // no volume has been set up yet
+    alldata.misc.initializationSuccessful = FALSE;
 
     // read configuration options
     int configSuccessful = vol2birdLoadConfig(&alldata, optionsFile) == 0;
@@ -320,163 +784,45 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    // read in data up to a distance of alldata.misc.rCellMax
-    // we do not read in the full volume for speed/memory
-    PolarVolume_t *volume = NULL;
-
-    // FIXME maximum range specification not implemented for RSL / NEXRAD
-    volume = vol2birdGetVolume(fileIn, nInputFiles, 1000000, 1);
-    // volume = vol2birdGetVolume(fileIn, nInputFiles, alldata.misc.rCellMax,1);
+    int result;
 
-    if (volume == NULL)
-    {
-        fprintf(stderr, "Error: failed to read radar volume\n");
-        return -1;
-    }
-
-    // loading static clutter map upon request
-    if (alldata.options.useClutterMap)
+    // keeps VPTS CSV files open across volumes
+    vol2birdVptsWriter_t *vptsWriter = NULL;
+    if (batchFile != NULL || fileVptsOut != NULL)
     {
-        int clutterSuccessful = vol2birdLoadClutterMap(volume, alldata.options.clutterMap, alldata.misc.rCellMax) == 0;
-
-        if (clutterSuccessful == FALSE)
+        vptsWriter = vol2birdVptsWriterNew();
+        if (vptsWriter == NULL)
         {
-            fprintf(stderr, "Error: failed to load static clutter map '%s', aborting\n", alldata.options.clutterMap);
+            vol2birdTearDown(&alldata);
             return -1;
         }
     }
 
-    // resample the volume upon request
-    if (alldata.options.resample)
+    if (batchFile != NULL)
     {
-        PolarVolume_t *volume_orig = volume;
-        volume = PolarVolume_resample(volume, alldata.options.resampleRscale,
-                                      alldata.options.resampleNbins, alldata.options.resampleNrays);
-        if (volume == NULL)
-        {
-            fprintf(stderr, "Error: volume resampling failed\n");
-            return -1;
-        }
-        RAVE_OBJECT_RELEASE(volume_orig);
+        // process all volumes listed in the batch file with a single configuration
+        result = processBatch(&alldata, batchFile, vptsWriter, fileVptsOut) == 0 ? 0 : -1;
     }
-
-    // initialize volbird library
-    int initSuccessful = vol2birdSetUp(volume, &alldata) == 0;
-
-    if (initSuccessful == FALSE)
+    else
     {
-        fprintf(stderr, "Error: failed to initialize vol2bird\n");
-        return -1;
+        result = processVolume(&alldata, fileIn, nInputFiles, fileVpOut, fileVolOut, vptsWriter, fileVptsOut);
     }
 
-    // output (optionally de-aliased) volume
-    if (fileVolOut != NULL)
+    // write out the VPTS CSV files, sorted by time
+    if (vol2birdVptsWriterClose(vptsWriter) == FALSE)
     {
-        saveToODIM((RaveCoreObject *)volume, fileVolOut);
+        fprintf(stderr, "critical error, cannot write VPTS CSV output\n");
+        result = -1;
     }
 
-    // call vol2bird's main routine
-    vol2birdCalcProfiles(&alldata);
-
-    // ------------------------------------------------------------------- //
-    //  using getter functions to access at the profile data               //
-    // ------------------------------------------------------------------- //
-    const char *date;
-    const char *time;
-    const char *source;
-    double longitude, latitude, height, wavelength;
-
-    date = PolarVolume_getDate(volume);
-    time = PolarVolume_getTime(volume);
-    source = PolarVolume_getSource(volume);
-    
-    { // getter example scope begin
-
-        int nRowsProfile = vol2birdGetNRowsProfile(&alldata);
-        int nColsProfile = vol2birdGetNColsProfile(&alldata);
-
-        fprintf(stdout, "# vol2bird Vertical Profile of Birds (VPB)\n");
-        fprintf(stdout, "# source: %s\n", source);
-        fprintf(stdout, "# polar volume input: %s\n", fileIn[0]);
-        if (alldata.misc.vcp > 0)
-            fprintf(stdout, "# volume coverage pattern (VCP): %i\n", alldata.misc.vcp);
-        printf("# date   time HGHT u v w ff dd sd_vvp gap dbz     eta   dens   DBZH   n   n_dbz n_all n_dbz_all\n");
-
-        float *profileBio;
-        float *profileAll;
-
-        profileBio = vol2birdGetProfile(1, &alldata);
-        profileAll = vol2birdGetProfile(3, &alldata);
-
-        float *rcs, *sd_vvp_thresh, *wavelength;
-        int *vcp;
-
-        printf("alldata.misc.vcp = %d\n", alldata.misc.vcp);
-
-        rcs = &alldata.options.birdRadarCrossSection;
-        sd_vvp_thresh = &alldata.options.stdDevMinBird;
-        vcp = &alldata.misc.vcp;
-        wavelength = &alldata.options.radarWavelength;
-
-        int iRowProfile;
-        int iCopied = 0;
-
-        for (iRowProfile = 0; iRowProfile < nRowsProfile; iRowProfile++)
-        {
-            iCopied = iRowProfile * nColsProfile;
-            printf("%8s %.4s ", date, time);
-            printf("%4.f %6.2f %6.2f %7.2f %5.2f %5.1f %6.2f %s %6.2f %6.1f %6.2f %6.2f %5.f %5.f %5.f %5.f\n",
-                   profileBio[0 + iCopied],                                           // hght
-                   nanify(profileBio[2 + iCopied]), nanify(profileBio[3 + iCopied]),  // u,v
-                   nanify(profileBio[4 + iCopied]), nanify(profileBio[5 + iCopied]),  // w,ff
-                   nanify(profileBio[6 + iCopied]), nanify(profileAll[7 + iCopied]),  // dd,sd_vvp
-                   profileBio[8 + iCopied] == TRUE ? "TRUE" : "FALSE",                       // gap
-                   nanify(profileBio[9 + iCopied]), nanify(profileBio[11 + iCopied]), //  dbz,eta
-                   nanify(profileBio[12 + iCopied]), nanify(profileAll[9 + iCopied]), //  dens, dbz_all (dbzh)
-                   nanify(profileBio[10 + iCopied]), nanify(profileBio[13 + iCopied]),
-                   nanify(profileAll[10 + iCopied]), nanify(profileAll[13 + iCopied]));
-        }
-        profileAll = NULL;
-        profileBio = NULL;
-        free((void *)profileAll);
-        free((void *)profileBio);
-
-        //}
-    } // getter scope end
-
+    vol2birdCachePrintStats(&alldata);
 
-    // ------------------------------------------------------------------- //
-    //                 end of the getter example section                   //
-    // ------------------------------------------------------------------- //
-
-    // map vol2bird profile data to Rave profile object
-    mapDataToRave(volume, &alldata);
-
-    // save rave profile to ODIM hdf5 or generate VPTS csv based on existence of .csv extension
-    if (fileVpOut != NULL)
-    {
-        int result;
-        if(isCSV(fileVpOut)){
-            result = saveToCSV(fileVpOut, &alldata, volume);
-        }
-        else{
-            result = saveToODIM((RaveCoreObject *)alldata.vp, fileVpOut);
-        }
-        
-        if (result == FALSE){
-            fprintf(stderr, "critical error, cannot write file %s\n", fileVpOut);
-            return -1;
-        }
-    }
-    
-    
     // tear down vol2bird, give memory back
     vol2birdTearDown(&alldata);
-    RAVE_OBJECT_RELEASE(volume);
 
     // output some performance data
     // clock_gettime(CLOCK_REALTIME, &ts);
     // double nSeconds = ((double) ts.tv_nsec)/1e9;
     // fprintf(stderr, "Processing done in %.2f seconds\n",nSeconds);
-    return 0;
-}
\ No newline at end of file
+    return result;
+}
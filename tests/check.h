@@ -0,0 +1,42 @@
+/** Checks shared by the tests of the C library
+ * @file check.h
+ *
+ * CHECK(condition) reports a failed condition with its file and line and
+ * counts it in nFailed, which main() turns into the exit status. Tests of
+ * sources that report errors through vol2bird_err_printf, but are not
+ * linked with libvol2bird.c, get a definition that prints to stderr;
+ * define CHECK_HAVE_ERR_PRINTF before including this file to leave it out.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdarg.h>
+
+static int nFailed = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(const int condition, const char* text, const char* file, const int line) {
+
+    if (!condition) {
+        fprintf(stderr, "%s:%i: check failed: %s\n", file, line, text);
+        nFailed++;
+    }
+
+} // check
+
+
+#ifndef CHECK_HAVE_ERR_PRINTF
+void vol2bird_err_printf(const char* fmt, ...) {
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+
+} // vol2bird_err_printf
+#endif
+
+#endif
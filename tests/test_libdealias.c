@@ -0,0 +1,197 @@
+/** Tests of the selection of the dealiasing test velocity fields
+ * @file test_libdealias.c
+ *
+ * Checks that the batched evaluation of the test velocity fields in
+ * dealias_points selects the same field as evaluating every field with
+ * test_field, the first one in case of ties, and that sincos_poly agrees
+ * with sin and cos. Exits with a non-zero status on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// the functions under test are static
+#include "../lib/libdealias.c"
+
+#include "check.h"
+
+#define NPOINTS_MAX 400
+#define NTRIALS 2000
+
+static double uniform(const double min, const double max) {
+
+    return min + (max - min) * rand() / (double) RAND_MAX;
+
+} // uniform
+
+
+// points of a wind field of speed 'speed' from direction 'direction' (degrees), folded
+// into the Nyquist interval. With 'singleRay', all points lie at azimuth 0, where the
+// u component does not contribute, such that the test fields that are each other's
+// mirror image about azimuth 0 fit equally well
+static void makePoints(float* points, float* nyquist, float* vo, const int nPoints, const double speed,
+                       const double direction, const int singleRay) {
+
+    const double nyquists[4] = {8, 12.5, 16, 25};
+    const double nyquistScan = nyquists[rand() % 4];
+
+    for (int iPoint = 0; iPoint < nPoints; iPoint++) {
+        points[2 * iPoint] = singleRay ? 0 : (float) uniform(0, 360);
+        points[2 * iPoint + 1] = (float) uniform(0.5, 10);
+        nyquist[iPoint] = (float) (rand() % 4 == 0 ? nyquists[rand() % 4] : nyquistScan);
+        double vrad = speed * cos((points[2 * iPoint] - direction) * DEG2RAD) * cos(points[2 * iPoint + 1] * DEG2RAD);
+        vrad += uniform(-2, 2);
+        vrad -= 2 * nyquist[iPoint] * floor((vrad + nyquist[iPoint]) / (2 * nyquist[iPoint]));
+        vo[iPoint] = (float) vrad;
+        // points that test_field skips
+        if (rand() % 50 == 0) {
+            vo[iPoint] = NAN;
+        }
+        if (rand() % 100 == 0) {
+            nyquist[iPoint] = 0;
+        }
+    }
+
+} // makePoints
+
+
+// compares the field selected by select_test_field with that of the scalar search of
+// all test fields, as dealias_points did before. Returns whether the minimum was tied
+static int compareSelection(const float* points, const float* nyquist, const float* vo, const int nPoints) {
+
+    const int nDims = 2;
+    const int m = DEALIAS_VAF;
+    const int n = DEALIAS_NF;
+    double uh[m * n];
+    double vh[m * n];
+    double x[NPOINTS_MAX];
+    double y[NPOINTS_MAX];
+    float pointsTrigon[3 * NPOINTS_MAX];
+    double pointsValid[7 * NPOINTS_MAX];
+    double esum[m * n];
+    double esumMin;
+    int nPointsValid = 0;
+    int i;
+    int j;
+
+    // as in dealias_points
+    for (i = 0; i < nPoints; i++) {
+        x[i] = nyquist[i] / M_PI * cos(vo[i] * M_PI / nyquist[i]);
+        y[i] = nyquist[i] / M_PI * sin(vo[i] * M_PI / nyquist[i]);
+        pointsTrigon[3 * i + 0] = sin(points[nDims * i] * DEG2RAD);
+        pointsTrigon[3 * i + 1] = cos(points[nDims * i] * DEG2RAD);
+        pointsTrigon[3 * i + 2] = cos(points[nDims * i + 1] * DEG2RAD);
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < m; j++) {
+            uh[i * m + j] = DEALIAS_VMAX / DEALIAS_VAF * (j + 1) * sin(2 * M_PI / DEALIAS_NF * i);
+            vh[i * m + j] = DEALIAS_VMAX / DEALIAS_VAF * (j + 1) * cos(2 * M_PI / DEALIAS_NF * i);
+        }
+    }
+    for (i = 0; i < nPoints; i++) {
+        if (isnan(x[i]) || isnan(y[i]) || !isfinite(nyquist[i]) || nyquist[i] == 0 ||
+            isnan(pointsTrigon[3 * i]) || isnan(pointsTrigon[3 * i + 1]) || isnan(pointsTrigon[3 * i + 2])) {
+            continue;
+        }
+        pointsValid[nPointsValid] = pointsTrigon[3 * i];
+        pointsValid[nPointsValid + nPoints] = pointsTrigon[3 * i + 1];
+        pointsValid[nPointsValid + 2 * nPoints] = pointsTrigon[3 * i + 2];
+        pointsValid[nPointsValid + 3 * nPoints] = x[i];
+        pointsValid[nPointsValid + 4 * nPoints] = y[i];
+        pointsValid[nPointsValid + 5 * nPoints] = nyquist[i] / M_PI;
+        pointsValid[nPointsValid + 6 * nPoints] = M_PI / nyquist[i];
+        nPointsValid++;
+    }
+    for (j = 1; j < 7; j++) {
+        memmove(&pointsValid[j * nPointsValid], &pointsValid[j * nPoints], sizeof(double) * nPointsValid);
+    }
+
+    void* params[7] = {(void*) points, (void*) pointsTrigon, (void*) &nPoints, (void*) &nDims, (void*) x, (void*) y, (void*) nyquist};
+
+    // the scalar search, keeping the first of equally good fields
+    double min1 = 1e32;
+    int eind = 0;
+    for (i = 0; i < m * n; i++) {
+        esum[i] = test_field((float) uh[i], (float) vh[i], points, pointsTrigon, nPoints, nDims, x, y, nyquist);
+        if (esum[i] < min1) {
+            min1 = esum[i];
+            eind = i;
+        }
+    }
+
+    CHECK(select_test_field(uh, vh, m * n, pointsValid, nPointsValid, &params, &esumMin, 1) == eind);
+    CHECK(esumMin == min1);
+    CHECK(select_test_field(uh, vh, m * n, pointsValid, nPointsValid, &params, &esumMin, 4) == eind);
+
+    for (i = eind + 1; i < m * n; i++) {
+        if (esum[i] == min1) {
+            return 1;
+        }
+    }
+    return 0;
+
+} // compareSelection
+
+
+static void testSelection(void) {
+
+    float points[2 * NPOINTS_MAX];
+    float nyquist[NPOINTS_MAX];
+    float vo[NPOINTS_MAX];
+    int nTies = 0;
+
+    srand(1);
+    for (int iTrial = 0; iTrial < NTRIALS; iTrial++) {
+        const int nPoints = 1 + rand() % NPOINTS_MAX;
+        makePoints(points, nyquist, vo, nPoints, uniform(0, 40), uniform(0, 360), iTrial % 2);
+        nTies += compareSelection(points, nyquist, vo, nPoints);
+    }
+
+    // no valid points, all test fields tie at zero
+    for (int iPoint = 0; iPoint < 10; iPoint++) {
+        points[2 * iPoint] = 10 * iPoint;
+        points[2 * iPoint + 1] = 1;
+        nyquist[iPoint] = 10;
+        vo[iPoint] = NAN;
+    }
+    CHECK(compareSelection(points, nyquist, vo, 10) == 1);
+
+    // the points along a single ray should produce ties
+    CHECK(nTies > 0);
+    fprintf(stderr, "test_libdealias: %i of %i random trials had tied test fields\n", nTies, NTRIALS);
+
+} // testSelection
+
+
+static void testSincos(void) {
+
+    double sint;
+    double cost;
+    double errMax = 0;
+
+    srand(2);
+    for (int i = 0; i < 100000; i++) {
+        const double t = i < 1000 ? (i - 500) * M_PI_4 : uniform(-100, 100);
+        sincos_poly(t, &sint, &cost);
+        errMax = fmax(errMax, fabs(sint - sin(t)));
+        errMax = fmax(errMax, fabs(cost - cos(t)));
+    }
+    CHECK(errMax < 1e-14);
+
+} // testSincos
+
+
+int main(void) {
+
+    testSincos();
+    testSelection();
+
+    if (nFailed > 0) {
+        fprintf(stderr, "test_libdealias: %i checks failed\n", nFailed);
+        return 1;
+    }
+    fprintf(stderr, "test_libdealias: all checks passed\n");
+
+    return 0;
+
+} // main
@@ -0,0 +1,76 @@
+/** Tests of the fit of the VVP model
+ * @file test_libsvdfit.c
+ *
+ * Checks that the closed-form fit vvpfit and the singular value decomposition
+ * svdfit give the same parameters and variances on random sets of points.
+ * Exits with a non-zero status on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libsvdfit.h"
+#include "check.h"
+
+#define NPOINTS_MAX 200
+#define NTRIALS 2000
+
+static double uniform(const double min, const double max) {
+
+    return min + (max - min) * rand() / (double) RAND_MAX;
+
+} // uniform
+
+
+static void testFits(void) {
+
+    float points[2 * NPOINTS_MAX];
+    float vradObs[NPOINTS_MAX];
+    float vradFitted[NPOINTS_MAX];
+    float parsSvd[3];
+    float parsVvp[3];
+    float avarSvd[3];
+    float avarVvp[3];
+
+    srand(1);
+    for (int iTrial = 0; iTrial < NTRIALS; iTrial++) {
+
+        const int nPoints = 10 + rand() % (NPOINTS_MAX - 10);
+        const double azimFirst = uniform(0, 360);
+        const double azimSpan = uniform(20, 360);
+        const double u = uniform(-20, 20);
+        const double v = uniform(-20, 20);
+
+        for (int iPoint = 0; iPoint < nPoints; iPoint++) {
+            const double azim = azimFirst + uniform(0, azimSpan);
+            const double elev = uniform(0.5, 10);
+            points[2 * iPoint] = (float) azim;
+            points[2 * iPoint + 1] = (float) elev;
+            vradObs[iPoint] = (float) ((u * sin(azim * DEG2RAD) + v * cos(azim * DEG2RAD)) * cos(elev * DEG2RAD) + uniform(-2, 2));
+        }
+
+        CHECK(svdfit(points, 2, vradObs, vradFitted, nPoints, parsSvd, avarSvd, 3, NULL) >= 0);
+        CHECK(vvpfit(points, 2, vradObs, vradFitted, nPoints, parsVvp, avarVvp, 3, NULL) >= 0);
+
+        for (int iPar = 0; iPar < 3; iPar++) {
+            CHECK(fabs(parsSvd[iPar] - parsVvp[iPar]) <= 1e-3 * (1 + fabs(parsVvp[iPar])));
+            CHECK(fabs(avarSvd[iPar] - avarVvp[iPar]) <= 1e-4 * fabs(avarVvp[iPar]));
+        }
+    }
+
+} // testFits
+
+
+int main(void) {
+
+    testFits();
+
+    if (nFailed > 0) {
+        fprintf(stderr, "test_libsvdfit: %i checks failed\n", nFailed);
+        return 1;
+    }
+    fprintf(stderr, "test_libsvdfit: all checks passed\n");
+
+    return 0;
+
+} // main
@@ -0,0 +1,384 @@
+/** Tests of the per-scan processing steps of libvol2bird
+ * @file test_libvol2bird.c
+ *
+ * Compares functions of libvol2bird.c that were rewritten for speed with
+ * the implementations they replaced, on random scans. Exits with a non-zero
+ * status on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// the functions under test are static
+#include "../lib/libvol2bird.c"
+
+// libvol2bird.c defines vol2bird_err_printf
+#define CHECK_HAVE_ERR_PRINTF
+#include "check.h"
+
+#define NTRIALS 500
+
+static double uniform(const double min, const double max) {
+
+    return min + (max - min) * rand() / (double) RAND_MAX;
+
+} // uniform
+
+
+// a scan with a parameter 'quantity' of nRang x nAzim values of type 'type'
+static PolarScan_t* newScan(const char* quantity, const long nRang, const long nAzim, const RaveDataType type) {
+
+    PolarScan_t* scan = RAVE_OBJECT_NEW(&PolarScan_TYPE);
+    PolarScanParam_t* param = RAVE_OBJECT_NEW(&PolarScanParam_TYPE);
+
+    if (scan == NULL || param == NULL || !PolarScanParam_setQuantity(param, quantity) ||
+        !PolarScanParam_createData(param, nRang, nAzim, type) || !PolarScan_addParameter(scan, param)) {
+        fprintf(stderr, "test_libvol2bird: failed to create a scan\n");
+        exit(1);
+    }
+    RAVE_OBJECT_RELEASE(param);
+
+    return scan;
+
+} // newScan
+
+
+static void testRangeBinsToLayers(void) {
+
+    // ------------------------------------------------------------- //
+    // mapRangeBinsToLayers against the range and height tests that  //
+    // getListOfSelectedGates applied for each layer separately      //
+    // ------------------------------------------------------------- //
+
+    vol2bird_t alldata;
+    int nOnBoundary = 0;
+
+    memset(&alldata, 0, sizeof(vol2bird_t));
+    srand(1);
+
+    for (int iTrial = 0; iTrial < NTRIALS; iTrial++) {
+
+        const int nRang = 1 + rand() % 1000;
+        const float rangeScale = (float) (rand() % 2 ? 250 : uniform(100, 2000));
+        const float elevAngle = (float) (uniform(0.2, 20) * DEG2RAD);
+
+        alldata.options.nLayers = 1 + rand() % 100;
+        alldata.options.layerThickness = (float) (rand() % 2 ? 200 : uniform(20, 500));
+        alldata.options.rangeMin = (float) uniform(0, 10000);
+        alldata.options.rangeMax = (float) uniform(alldata.options.rangeMin, 200000);
+
+        // a radar height that puts the middle of a gate exactly on a layer boundary
+        const int iRangBoundary = rand() % nRang;
+        const float gateRangeBoundary = ((float) iRangBoundary + 0.5f) * rangeScale;
+        const float radarHeight = (float) ((rand() % 10) * alldata.options.layerThickness
+                                           - range2height(gateRangeBoundary, elevAngle));
+
+        struct scanData geometry;
+        geometry.nRang = nRang;
+        geometry.nAzim = 360;
+        geometry.rangeScale = rangeScale;
+        geometry.elevAngle = elevAngle;
+        geometry.radarHeight = radarHeight;
+
+        int* iLayerFirst = malloc(sizeof(int) * nRang);
+        int* iLayerLast = malloc(sizeof(int) * nRang);
+
+        CHECK(mapRangeBinsToLayers(&geometry, iLayerFirst, iLayerLast, &alldata) == nRang);
+
+        for (int iRang = 0; iRang < nRang; iRang++) {
+
+            const float gateRange = ((float) iRang + 0.5f) * rangeScale;
+            const float gateHeight = range2height(gateRange, elevAngle) + radarHeight;
+
+            for (int iLayer = 0; iLayer < alldata.options.nLayers; iLayer++) {
+
+                const float altitudeMin = iLayer * alldata.options.layerThickness;
+                const float altitudeMax = (iLayer + 1) * alldata.options.layerThickness;
+
+                int selected = 1;
+                if (gateRange < alldata.options.rangeMin || gateRange > alldata.options.rangeMax) {
+                    selected = 0;
+                }
+                if (gateHeight < altitudeMin || gateHeight > altitudeMax) {
+                    selected = 0;
+                }
+                if (selected && gateHeight == altitudeMin && iLayer > 0) {
+                    nOnBoundary++;
+                }
+
+                CHECK(selected == (iLayerFirst[iRang] >= 0 && iLayerFirst[iRang] <= iLayer && iLayer <= iLayerLast[iRang]));
+            }
+        }
+
+        free((void*) iLayerFirst);
+        free((void*) iLayerLast);
+    }
+
+    // gates on a boundary between two layers should have been tested
+    CHECK(nOnBoundary > 0);
+
+} // testRangeBinsToLayers
+
+
+// the texture of gate (iRang,iAzim) as calcTexture calculated it before it kept running
+// sums: the standard deviation of the velocity differences between the gate and each of
+// its neighbors, in the units of the texture parameter
+static double textureReference(PolarScan_t* scan, vol2birdScanUse_t scanUse, vol2bird_t* alldata,
+                               const int iRang, const int iAzim) {
+
+    PolarScanParam_t* texImage = PolarScan_getParameter(scan, scanUse.texName);
+    PolarScanParam_t* vradImage = PolarScan_getParameter(scan, scanUse.vradName);
+    PolarScanParam_t* dbzImage = PolarScan_getParameter(scan, scanUse.dbzName);
+    const int nRang = (int) PolarScan_getNbins(scan);
+    const int nAzim = (int) PolarScan_getNrays(scan);
+    const int nNeighborhood = alldata->constants.nRangNeighborhood * alldata->constants.nAzimNeighborhood;
+    double vradValGlobal;
+    double vradValLocal;
+    double dbzValLocal;
+    double vmoment1 = 0;
+    double vmoment2 = 0;
+    double tex;
+    int count = 0;
+    int iRangLocal;
+    int iAzimLocal;
+
+    for (int iNeighborhood = 0; iNeighborhood < nNeighborhood; iNeighborhood++) {
+
+        if (findNearbyGateIndex(nAzim, nRang, iRang + iAzim * nRang, alldata->constants.nAzimNeighborhood,
+                                alldata->constants.nRangNeighborhood, iNeighborhood, &iAzimLocal, &iRangLocal) < 0) {
+            continue;
+        }
+
+        PolarScanParam_getValue(vradImage, iRang, iAzim, &vradValGlobal);
+        PolarScanParam_getValue(vradImage, iRangLocal, iAzimLocal, &vradValLocal);
+        PolarScanParam_getValue(dbzImage, iRangLocal, iAzimLocal, &dbzValLocal);
+
+        if (vradValLocal == PolarScanParam_getNodata(vradImage) || dbzValLocal == PolarScanParam_getNodata(dbzImage) ||
+            vradValLocal == PolarScanParam_getUndetect(vradImage) || dbzValLocal == PolarScanParam_getUndetect(dbzImage)) {
+            continue;
+        }
+
+        double vRadDiff = PolarScanParam_getOffset(vradImage) + PolarScanParam_getGain(vradImage) * (vradValGlobal - vradValLocal);
+        vmoment1 += vRadDiff;
+        vmoment2 += SQUARE(vRadDiff);
+        count++;
+    }
+
+    if (count < alldata->constants.nCountMin) {
+        tex = PolarScanParam_getNodata(texImage);
+    }
+    else {
+        vmoment1 /= count;
+        vmoment2 /= count;
+        tex = (float) ((sqrt(XABS(vmoment2 - SQUARE(vmoment1))) - PolarScanParam_getOffset(texImage)) / PolarScanParam_getGain(texImage));
+    }
+
+    RAVE_OBJECT_RELEASE(texImage);
+    RAVE_OBJECT_RELEASE(vradImage);
+    RAVE_OBJECT_RELEASE(dbzImage);
+
+    return tex;
+
+} // textureReference
+
+
+static void testTexture(void) {
+
+    // ------------------------------------------------------------- //
+    // calcTexture against the calculation per gate. The running     //
+    // sums add and subtract the values in another order, such that  //
+    // the textures agree to within rounding errors only. These are  //
+    // relative to the largest raw velocity value, and the textures  //
+    // of blocks of (nearly) equal velocities are the most affected  //
+    // ------------------------------------------------------------- //
+
+    const RaveDataType types[4] = {RaveDataType_UCHAR, RaveDataType_USHORT, RaveDataType_FLOAT, RaveDataType_DOUBLE};
+    const double gains[5] = {0.5, 0.1, 0.38, 1.0, 0.0122};
+    vol2birdScanUse_t scanUse;
+    vol2bird_t alldata;
+    struct scanData scanData;
+    double vradValue;
+    double tex;
+    double texReference;
+    long nMissing = 0;
+
+    memset(&alldata, 0, sizeof(vol2bird_t));
+    memset(&scanUse, 0, sizeof(vol2birdScanUse_t));
+    alldata.options.singlePol = TRUE;
+    scanUse.useScan = 1;
+    strcpy(scanUse.dbzName, "DBZH");
+    strcpy(scanUse.vradName, "VRADH");
+    strcpy(scanUse.texName, "VTEX");
+    strcpy(scanUse.cellName, "CELL");
+    srand(2);
+
+    for (int iTrial = 0; iTrial < NTRIALS; iTrial++) {
+
+        alldata.constants.nAzimNeighborhood = 1 + 2 * (rand() % 5);
+        alldata.constants.nRangNeighborhood = 1 + 2 * (rand() % 5);
+        alldata.constants.nCountMin = 1 + rand() % 20;
+
+        const RaveDataType type = types[rand() % 4];
+        const int nRang = 1 + rand() % 40;
+        const int nAzim = alldata.constants.nAzimNeighborhood + rand() % 40;
+        const int isFloat = type == RaveDataType_FLOAT || type == RaveDataType_DOUBLE;
+
+        PolarScan_t* scan = newScan("VRADH", nRang, nAzim, type);
+        PolarScanParam_t* vradImage = PolarScan_getParameter(scan, "VRADH");
+        PolarScanParam_setGain(vradImage, isFloat && rand() % 2 ? 1 : gains[rand() % 5]);
+        PolarScanParam_setOffset(vradImage, isFloat && rand() % 2 ? 0 : uniform(-70, 0));
+        PolarScanParam_setNodata(vradImage, isFloat ? -9999 : (type == RaveDataType_UCHAR ? 255 : 65535));
+        PolarScanParam_setUndetect(vradImage, isFloat ? -8888 : 0);
+
+        PolarScanParam_t* dbzImage = RAVE_OBJECT_NEW(&PolarScanParam_TYPE);
+        PolarScanParam_setQuantity(dbzImage, "DBZH");
+        PolarScanParam_createData(dbzImage, nRang, nAzim, RaveDataType_UCHAR);
+        PolarScanParam_setGain(dbzImage, 0.5);
+        PolarScanParam_setOffset(dbzImage, -32);
+        PolarScanParam_setNodata(dbzImage, 255);
+        PolarScanParam_setUndetect(dbzImage, 0);
+        PolarScan_addParameter(scan, dbzImage);
+
+        // the rounding errors scale with the largest raw value, including nodata and undetect
+        double vradRawMax = 0;
+        for (int iAzim = 0; iAzim < nAzim; iAzim++) {
+            for (int iRang = 0; iRang < nRang; iRang++) {
+                if (rand() % 20 == 0) {
+                    vradValue = PolarScanParam_getNodata(vradImage);
+                }
+                else if (rand() % 20 == 0) {
+                    vradValue = PolarScanParam_getUndetect(vradImage);
+                }
+                else if (isFloat) {
+                    vradValue = uniform(-30, 30);
+                }
+                else {
+                    vradValue = rand() % (type == RaveDataType_UCHAR ? 256 : 65536);
+                }
+                PolarScanParam_setValue(vradImage, iRang, iAzim, vradValue);
+                PolarScanParam_setValue(dbzImage, iRang, iAzim, rand() % 256);
+                vradRawMax = fmax(vradRawMax, fabs(vradValue));
+            }
+        }
+        const double tolerance = 1e-6 * PolarScanParam_getGain(vradImage) * vradRawMax;
+
+        initScanData(scan, scanUse, &scanData, &alldata);
+        calcTexture(&scanData, &alldata);
+
+        PolarScanParam_t* texImage = PolarScan_getParameter(scan, scanUse.texName);
+
+        for (int iAzim = 0; iAzim < nAzim; iAzim++) {
+            for (int iRang = 0; iRang < nRang; iRang++) {
+                PolarScanParam_getValue(texImage, iRang, iAzim, &tex);
+                texReference = textureReference(scan, scanUse, &alldata, iRang, iAzim);
+                if (texReference == PolarScanParam_getNodata(texImage)) {
+                    CHECK(tex == texReference);
+                    nMissing++;
+                }
+                else {
+                    CHECK(fabs(tex - texReference) <= tolerance + 1e-6 * fabs(texReference));
+                }
+            }
+        }
+
+        RAVE_OBJECT_RELEASE(texImage);
+        RAVE_OBJECT_RELEASE(dbzImage);
+        RAVE_OBJECT_RELEASE(vradImage);
+        RAVE_OBJECT_RELEASE(scan);
+    }
+
+    // gates with too few valid neighbors should have been tested
+    CHECK(nMissing > 0);
+
+} // testTexture
+
+
+// a view on 'data', with gain 1 and offset 0
+static void initView(vol2birdScanView_t* view, void* data, const RaveDataType type, const long nRang, const long nAzim) {
+
+    view->data = data;
+    view->type = type;
+    view->nRang = nRang;
+    view->nAzim = nAzim;
+    view->gain = 1;
+    view->offset = 0;
+    view->nodata = -9999;
+    view->undetect = -8888;
+
+} // initView
+
+
+static void testWeatherCells(void) {
+
+    // ------------------------------------------------------------- //
+    // findWeatherCells on two cases it used to label wrongly: a     //
+    // cell crossing azimuth 0 is a single cell, also when another   //
+    // cell was labelled last, and a gate that connects three cells  //
+    // merges all of them                                            //
+    // ------------------------------------------------------------- //
+
+    const int nRang = 40;
+    const int nAzim = 20;
+    double dbz[nRang * nAzim];
+    int cell[nRang * nAzim];
+    struct scanData scanData;
+    vol2bird_t alldata;
+
+    memset(&alldata, 0, sizeof(vol2bird_t));
+    alldata.misc.rCellMax = 1e6;
+    alldata.constants.nNeighborsMin = 0;
+
+    memset(&scanData, 0, sizeof(struct scanData));
+    scanData.nRang = nRang;
+    scanData.nAzim = nAzim;
+    scanData.rangeScale = 500;
+    initView(&scanData.dbz, dbz, RaveDataType_DOUBLE, nRang, nAzim);
+    initView(&scanData.cell, cell, RaveDataType_INT, nRang, nAzim);
+
+    // a cell on both sides of azimuth 0, and a cell at the last azimuth
+    for (int iGlobal = 0; iGlobal < nRang * nAzim; iGlobal++) {
+        dbz[iGlobal] = 0;
+    }
+    dbz[5] = 20;
+    dbz[5 + (nAzim - 1) * nRang] = 20;
+    dbz[30 + (nAzim - 1) * nRang] = 20;
+
+    CHECK(findWeatherCells(&scanData, &scanData.dbz, 10, TRUE, 2, TRUE, &alldata) == 5);
+    CHECK(cell[5] >= 2);
+    CHECK(cell[5 + (nAzim - 1) * nRang] == cell[5]);
+    CHECK(cell[30 + (nAzim - 1) * nRang] >= 2);
+    CHECK(cell[30 + (nAzim - 1) * nRang] != cell[5]);
+
+    // a labelled gate at (11,11) connecting the unconnected gates at (10,10) and (12,10)
+    for (int iGlobal = 0; iGlobal < nRang * nAzim; iGlobal++) {
+        dbz[iGlobal] = 0;
+        cell[iGlobal] = CELLINIT;
+    }
+    dbz[10 + 10 * nRang] = 20;
+    dbz[12 + 10 * nRang] = 20;
+    dbz[11 + 11 * nRang] = 20;
+    cell[11 + 11 * nRang] = 7;
+
+    findWeatherCells(&scanData, &scanData.dbz, 10, TRUE, 8, FALSE, &alldata);
+    CHECK(cell[10 + 10 * nRang] != CELLINIT);
+    CHECK(cell[12 + 10 * nRang] == cell[10 + 10 * nRang]);
+    CHECK(cell[11 + 11 * nRang] == cell[10 + 10 * nRang]);
+
+} // testWeatherCells
+
+
+int main(void) {
+
+    testRangeBinsToLayers();
+    testTexture();
+    testWeatherCells();
+
+    if (nFailed > 0) {
+        fprintf(stderr, "test_libvol2bird: %i checks failed\n", nFailed);
+        return 1;
+    }
+    fprintf(stderr, "test_libvol2bird: all checks passed\n");
+
+    return 0;
+
+} // main
@@ -0,0 +1,208 @@
+/** Tests of the vpb profile time series format
+ * @file test_libvpb.c
+ *
+ * Writes a vpb file with vpbAppend, reads it back with the memory-mapped
+ * reader, and checks that malformed headers are rejected by vpbOpen.
+ * Exits with a non-zero status on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "libvpb.h"
+#include "check.h"
+
+#define NLAYERS 5
+#define NCOLS 14
+
+static void fillProfile(float* profile, const float offset) {
+
+    for (int iLayer = 0; iLayer < NLAYERS; iLayer++) {
+        for (int iCol = 0; iCol < NCOLS; iCol++) {
+            profile[iLayer * NCOLS + iCol] = offset + iLayer * 100 + iCol;
+        }
+    }
+
+} // fillProfile
+
+
+static void putUint32(unsigned char* p, const uint32_t value) {
+
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char) (value >> (8 * i));
+    }
+
+} // putUint32
+
+
+// writes a file consisting of a header with the given fields and 'nBytes' zero bytes of records
+static void writeHeader(const char* filename, const uint32_t nLayers, const uint32_t nCols,
+                        const uint32_t nProfiles, const uint32_t recordSize, const size_t nBytes) {
+
+    unsigned char header[VPB_HEADER_SIZE];
+    FILE* fp = fopen(filename, "wb");
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, VPB_MAGIC, 8);
+    putUint32(header + 8, VPB_VERSION);
+    putUint32(header + 12, VPB_HEADER_SIZE);
+    putUint32(header + 16, nLayers);
+    putUint32(header + 20, nCols);
+    putUint32(header + 24, nProfiles);
+    putUint32(header + 28, recordSize);
+    fwrite(header, sizeof(header), 1, fp);
+    for (size_t i = 0; i < nBytes; i++) {
+        fputc(0, fp);
+    }
+    fclose(fp);
+
+} // writeHeader
+
+
+static void testTime(void) {
+
+    CHECK(vpbTime("19700101", "000000") == 0);
+    CHECK(vpbTime("20000301", "000000") == 951868800);
+    CHECK(vpbTime("20240229", "123456") == 1709210096);
+
+} // testTime
+
+
+static void testRoundTrip(const char* filename) {
+
+    float profileBio[NLAYERS * NCOLS];
+    float profileAll[NLAYERS * NCOLS];
+    float profile[NLAYERS * NCOLS];
+    float column[NLAYERS];
+    vpbMeta_t meta;
+
+    unlink(filename);
+
+    // two radars, appended out of time order
+    const char* radars[3] = {"KBGM", "KENX", "KBGM"};
+    const char* times[3] = {"120000", "120000", "110000"};
+    for (int iRecord = 0; iRecord < 3; iRecord++) {
+        memset(&meta, 0, sizeof(meta));
+        strcpy(meta.radar, radars[iRecord]);
+        meta.time = vpbTime("20240501", times[iRecord]);
+        meta.latitude = 42.2;
+        meta.longitude = -75.98;
+        meta.height = 490;
+        meta.wavelength = 10.7f;
+        meta.rcs = 11;
+        meta.sdVvpThresh = 2;
+        meta.vcp = 212 + iRecord;
+        fillProfile(profileBio, 1000 * iRecord);
+        fillProfile(profileAll, 1000 * iRecord + 0.5f);
+        CHECK(vpbAppend(filename, &meta, NLAYERS, NCOLS, profileBio, profileAll) == 0);
+    }
+
+    // a profile of another shape cannot be added
+    CHECK(vpbAppend(filename, &meta, NLAYERS + 1, NCOLS, profileBio, profileAll) != 0);
+
+    vpbReader_t* reader = vpbOpen(filename);
+    CHECK(reader != NULL);
+    if (reader == NULL) {
+        return;
+    }
+
+    CHECK(reader->nRecords == 3);
+    CHECK(reader->nLayers == NLAYERS);
+    CHECK(reader->nCols == NCOLS);
+    CHECK(reader->nProfiles == VPB_NPROFILES);
+
+    // the latest record at or before the time, of the radar
+    CHECK(vpbFind(reader, "KBGM", vpbTime("20240501", "120000")) == 0);
+    CHECK(vpbFind(reader, "KBGM", vpbTime("20240501", "115959")) == 2);
+    CHECK(vpbFind(reader, "KBGM", vpbTime("20240501", "105959")) == -1);
+    CHECK(vpbFind(reader, "KENX", vpbTime("20240502", "000000")) == 1);
+    CHECK(vpbFind(reader, "KAPX", vpbTime("20240502", "000000")) == -1);
+
+    CHECK(vpbGetMeta(reader, 1, &meta) == 0);
+    CHECK(strcmp(meta.radar, "KENX") == 0);
+    CHECK(meta.time == vpbTime("20240501", "120000"));
+    CHECK(meta.latitude == 42.2);
+    CHECK(meta.vcp == 213);
+    CHECK(meta.wavelength == 10.7f);
+
+    CHECK(vpbGetProfile(reader, 2, 0, profile) == 0);
+    fillProfile(profileBio, 2000);
+    CHECK(memcmp(profile, profileBio, sizeof(profile)) == 0);
+    CHECK(vpbGetProfile(reader, 2, 1, profile) == 0);
+    fillProfile(profileAll, 2000.5f);
+    CHECK(memcmp(profile, profileAll, sizeof(profile)) == 0);
+
+    CHECK(vpbGetColumn(reader, 1, 1, 9, column) == 0);
+    for (int iLayer = 0; iLayer < NLAYERS; iLayer++) {
+        CHECK(column[iLayer] == 1000.5f + iLayer * 100 + 9);
+    }
+
+    // out of range requests
+    CHECK(vpbGetMeta(reader, 3, &meta) != 0);
+    CHECK(vpbGetProfile(reader, 0, VPB_NPROFILES, profile) != 0);
+    CHECK(vpbGetColumn(reader, 0, 0, NCOLS, column) != 0);
+    CHECK(vpbGetColumn(reader, -1, 0, 0, column) != 0);
+
+    vpbClose(reader);
+
+} // testRoundTrip
+
+
+static void testMalformedHeaders(const char* filename) {
+
+    const uint32_t recordSize = VPB_META_SIZE + VPB_NPROFILES * NCOLS * NLAYERS * 4;
+    vpbReader_t* reader;
+
+    // a valid header with one record, and one incomplete record that is ignored
+    writeHeader(filename, NLAYERS, NCOLS, VPB_NPROFILES, recordSize, recordSize + 10);
+    reader = vpbOpen(filename);
+    CHECK(reader != NULL && reader->nRecords == 1);
+    vpbClose(reader);
+
+    // a product of the header fields that wraps around to the record size of 64 bytes
+    writeHeader(filename, 16, 1u << 30, 1u << 30, VPB_META_SIZE, 1024);
+    CHECK(vpbOpen(filename) == NULL);
+
+    // fields out of range
+    writeHeader(filename, 0, NCOLS, VPB_NPROFILES, VPB_META_SIZE, 0);
+    CHECK(vpbOpen(filename) == NULL);
+    writeHeader(filename, NLAYERS, 0, VPB_NPROFILES, VPB_META_SIZE, 0);
+    CHECK(vpbOpen(filename) == NULL);
+    writeHeader(filename, NLAYERS, NCOLS, 0, VPB_META_SIZE, 0);
+    CHECK(vpbOpen(filename) == NULL);
+    writeHeader(filename, VPB_NLAYERS_MAX + 1, NCOLS, VPB_NPROFILES, VPB_META_SIZE + VPB_NPROFILES * NCOLS * (VPB_NLAYERS_MAX + 1) * 4, 0);
+    CHECK(vpbOpen(filename) == NULL);
+
+    // a record size that does not match the fields
+    writeHeader(filename, NLAYERS, NCOLS, VPB_NPROFILES, recordSize + 4, recordSize + 4);
+    CHECK(vpbOpen(filename) == NULL);
+
+    // shorter than a header
+    FILE* fp = fopen(filename, "wb");
+    fwrite(VPB_MAGIC, 8, 1, fp);
+    fclose(fp);
+    CHECK(vpbOpen(filename) == NULL);
+
+} // testMalformedHeaders
+
+
+int main(void) {
+
+    char filename[] = "test_libvpb.vpb";
+
+    testTime();
+    testRoundTrip(filename);
+    testMalformedHeaders(filename);
+
+    unlink(filename);
+
+    if (nFailed > 0) {
+        fprintf(stderr, "test_libvpb: %i checks failed\n", nFailed);
+        return 1;
+    }
+    fprintf(stderr, "test_libvpb: all checks passed\n");
+
+    return 0;
+
+} // main
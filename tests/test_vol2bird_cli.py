@@ -0,0 +1,246 @@
+'''
+Regression tests of the vol2bird command line program, comparing the profiles
+it prints for data/KBGM_NEXRAD.gz across different ways of running it.
+'''
+import gzip
+import os
+import re
+import shutil
+import time
+import subprocess
+import tempfile
+import unittest
+
+TESTDIR = os.path.dirname(os.path.abspath(__file__))
+VOL2BIRD = os.path.join(TESTDIR, "..", "src", "vol2bird")
+NEXRAD = os.path.join(TESTDIR, "..", "data", "KBGM_NEXRAD.gz")
+
+
+def rsl_enabled():
+    '''Whether vol2bird was built with RSL, which reads the NEXRAD test data.'''
+    if not os.path.isfile(VOL2BIRD):
+        return False
+    result = subprocess.run([VOL2BIRD, "--help"], stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                            universal_newlines=True)
+    for line in result.stderr.splitlines():
+        if "input formats compatible with RSL" in line:
+            return "[enabled]" in line
+    return False
+
+
+@unittest.skipUnless(rsl_enabled(), "vol2bird is not built, or built without RSL")
+class Vol2BirdCliTest(unittest.TestCase):
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.env = dict(os.environ)
+        self.env.pop("OPTIONS_CONF", None)
+
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+
+    def _options(self, name, options):
+        '''Writes an options.conf with the given settings and returns its path.'''
+        path = os.path.join(self.tmpdir, name)
+        with open(path, "w") as f:
+            for key, value in options.items():
+                f.write("%s = %s\n" % (key, value))
+        return path
+
+
+    def _vol2bird(self, args, stdin=None, options=None):
+        '''Runs vol2bird and returns the completed process, with the output as text.'''
+        if options is not None:
+            args = args + ["-c", self._options("options%i.conf" % len(os.listdir(self.tmpdir)), options)]
+        return subprocess.run([VOL2BIRD] + args, stdin=stdin, stdout=subprocess.PIPE,
+                              stderr=subprocess.PIPE, universal_newlines=True,
+                              cwd=self.tmpdir, env=self.env)
+
+
+    def _rows(self, stdout):
+        '''The profile rows in the output of vol2bird, without comment lines.'''
+        return [line for line in stdout.splitlines() if line and not line.startswith("#")]
+
+
+    def _run(self, args, stdin=None, options=None):
+        '''Runs vol2bird and returns the profile rows it prints, without comment lines.'''
+        result = self._vol2bird(args, stdin=stdin, options=options)
+        self.assertEqual(result.returncode, 0, "vol2bird %s failed:\n%s" % (" ".join(args), result.stderr))
+        rows = self._rows(result.stdout)
+        self.assertTrue(len(rows) > 0, "vol2bird %s printed no profile" % " ".join(args))
+        return rows
+
+
+    def _cacheStats(self, stderr):
+        '''The hits, misses, stored and evicted counts of the profile cache statistics line.'''
+        match = re.search(r"profile cache .*: (\d+) hits, (\d+) misses, (\d+) stored, (\d+) evicted", stderr)
+        self.assertIsNotNone(match, "no profile cache statistics in:\n%s" % stderr)
+        return tuple(int(count) for count in match.groups())
+
+
+    def _cacheEntries(self, cacheDir):
+        '''The keys of the profile cache entries, with the total size of their files in bytes.'''
+        entries = {}
+        for name in os.listdir(cacheDir):
+            key, extension = os.path.splitext(name)
+            if extension in [".vpb", ".h5"]:
+                entries[key] = entries.get(key, 0) + os.path.getsize(os.path.join(cacheDir, name))
+        return entries
+
+
+    def test_stdin_matches_file(self):
+        '''A gzipped NEXRAD volume read from stdin gives the profile of the same file.'''
+        rowsFile = self._run(["-i", NEXRAD])
+        with open(NEXRAD, "rb") as f:
+            rowsStdin = self._run(["-i", "-"], stdin=f)
+        self.assertEqual(rowsFile, rowsStdin)
+
+
+    def test_threads_match_serial(self):
+        '''The profile calculated with several threads is identical to the serial one.'''
+        for dealias in ["FALSE", "TRUE"]:
+            options = {"DEALIAS_VRAD": dealias}
+            rows1 = self._run(["-i", NEXRAD], options=dict(options, NTHREADS=1))
+            rows4 = self._run(["-i", NEXRAD], options=dict(options, NTHREADS=4))
+            self.assertEqual(rows1, rows4, "profiles differ with DEALIAS_VRAD = %s" % dealias)
+
+
+    def test_dealias_seed_independent_of_threads(self):
+        '''With DEALIAS_SEED, the profile does not depend on the number of threads.'''
+        options = {"DEALIAS_VRAD": "TRUE", "DEALIAS_SEED": "TRUE"}
+        rows1 = self._run(["-i", NEXRAD], options=dict(options, NTHREADS=1))
+        rows4 = self._run(["-i", NEXRAD], options=dict(options, NTHREADS=4))
+        self.assertEqual(rows1, rows4)
+
+
+    def test_cache_hit_matches_calculation(self):
+        '''A second run with CACHE_DIR prints the profile of the first from the cache.'''
+        options = {"CACHE_DIR": os.path.join(self.tmpdir, "cache")}
+        first = self._vol2bird(["-i", NEXRAD], options=options)
+        self.assertEqual(first.returncode, 0, first.stderr)
+        self.assertEqual(self._cacheStats(first.stderr), (0, 1, 1, 0))
+        second = self._vol2bird(["-i", NEXRAD], options=options)
+        self.assertEqual(second.returncode, 0, second.stderr)
+        self.assertEqual(self._cacheStats(second.stderr), (1, 0, 0, 0))
+        self.assertEqual(self._rows(first.stdout), self._rows(second.stdout))
+        self.assertEqual(self._rows(second.stdout), self._run(["-i", NEXRAD]))
+
+
+    def test_cache_misses_on_changed_options_or_input(self):
+        '''Changing an option or the bytes of the input file gives a cache miss.'''
+        options = {"CACHE_DIR": os.path.join(self.tmpdir, "cache")}
+        result = self._vol2bird(["-i", NEXRAD], options=options)
+        self.assertEqual(self._cacheStats(result.stderr), (0, 1, 1, 0))
+
+        result = self._vol2bird(["-i", NEXRAD], options=dict(options, DEALIAS_VRAD="FALSE"))
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(self._cacheStats(result.stderr), (0, 1, 1, 0))
+
+        # the same volume, compressed differently
+        recompressed = os.path.join(self.tmpdir, "KBGM_NEXRAD_recompressed.gz")
+        with gzip.open(NEXRAD, "rb") as f:
+            data = f.read()
+        with gzip.GzipFile(recompressed, "wb", compresslevel=1, mtime=0) as f:
+            f.write(data)
+        result = self._vol2bird(["-i", recompressed], options=options)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(self._cacheStats(result.stderr), (0, 1, 1, 0))
+        self.assertEqual(self._rows(result.stdout), self._run(["-i", NEXRAD]))
+        self.assertEqual(len(self._cacheEntries(options["CACHE_DIR"])), 3)
+
+
+    def test_cache_evicts_oldest_entries(self):
+        '''When the cache exceeds CACHE_SIZE_MAX, the least recently used entries are removed.'''
+        cacheDir = os.path.join(self.tmpdir, "cache")
+        keys = []
+        for sigma in ["11.0", "11.1", "11.2"]:
+            self._run(["-i", NEXRAD], options={"CACHE_DIR": cacheDir, "SIGMA_BIRD": sigma})
+            keys.append((set(self._cacheEntries(cacheDir)) - set(keys)).pop())
+
+        # age the entries, the first one being the least recently used
+        now = time.time()
+        for iKey, key in enumerate(keys):
+            for name in os.listdir(cacheDir):
+                if name.startswith(key):
+                    os.utime(os.path.join(cacheDir, name), (now - 3000 + 1000 * iKey,) * 2)
+
+        # room for three and a half entries, such that storing a fourth removes only the oldest
+        entries = self._cacheEntries(cacheDir)
+        sizeMax = 3.5 * sum(entries.values()) / len(entries) / (1024 * 1024)
+        result = self._vol2bird(["-i", NEXRAD],
+                                options={"CACHE_DIR": cacheDir, "SIGMA_BIRD": "11.3", "CACHE_SIZE_MAX": sizeMax})
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(self._cacheStats(result.stderr), (0, 1, 1, 1))
+        remaining = set(self._cacheEntries(cacheDir))
+        self.assertNotIn(keys[0], remaining)
+        self.assertTrue(set(keys[1:]) <= remaining)
+        self.assertEqual(len(remaining), 3)
+
+
+    def test_vpts_sorted_and_deduplicated(self):
+        '''Volumes given out of time order give a single VPTS CSV file sorted by time, without duplicates.'''
+        try:
+            import h5py
+        except ImportError:
+            self.skipTest("h5py is not installed")
+
+        # two copies of the volume, an hour apart
+        pvol = os.path.join(self.tmpdir, "pvol.h5")
+        result = self._vol2bird(["-i", NEXRAD, "-p", pvol])
+        self.assertEqual(result.returncode, 0, result.stderr)
+        volumes = []
+        for hour in ["01", "02"]:
+            path = os.path.join(self.tmpdir, "pvol_%s.h5" % hour)
+            shutil.copy(pvol, path)
+            with h5py.File(path, "r+") as f:
+                f["what"].attrs["time"] = (hour + "0000").encode()
+            volumes.append(path)
+
+        batch = os.path.join(self.tmpdir, "batch.txt")
+        with open(batch, "w") as f:
+            f.write("\n".join([volumes[1], volumes[0], volumes[1]]) + "\n")
+        result = self._vol2bird(["-b", batch, "-t", "{radar}_{date}.csv"])
+        self.assertEqual(result.returncode, 0, result.stderr)
+
+        files = [name for name in os.listdir(self.tmpdir) if name.endswith(".csv")]
+        self.assertEqual(len(files), 1, files)
+        with open(os.path.join(self.tmpdir, files[0])) as f:
+            lines = f.read().splitlines()
+        header = lines[0].split(",")
+        rows = [line.split(",") for line in lines[1:]]
+        self.assertTrue(len(rows) > 0)
+        self.assertNotIn(lines[0], lines[1:])
+        iRadar, iDatetime, iHeight = header.index("radar"), header.index("datetime"), header.index("height")
+        keys = [(row[iDatetime], row[iRadar], float(row[iHeight])) for row in rows]
+        self.assertEqual(keys, sorted(keys))
+        self.assertEqual(len(keys), len(set(keys)))
+        self.assertEqual(len(set(key[0] for key in keys)), 2)
+
+
+    def test_batch_reports_each_line(self):
+        '''A batch reports the result of each line, fails when a line fails and prints the profiles of single runs.'''
+        missing = os.path.join(self.tmpdir, "missing.h5")
+        batch = os.path.join(self.tmpdir, "batch.txt")
+        with open(batch, "w") as f:
+            f.write(NEXRAD + "\n")
+            f.write("# a comment\n")
+            f.write(missing + "\n")
+            f.write("x" * 4000 + "\n")
+            f.write(NEXRAD + " -\n")
+        result = self._vol2bird(["-b", batch])
+        self.assertNotEqual(result.returncode, 0)
+
+        self.assertIn("batch line 1: %s OK" % NEXRAD, result.stderr)
+        self.assertNotIn("batch line 2:", result.stderr)
+        self.assertIn("batch line 3: %s FAILED" % missing, result.stderr)
+        self.assertIn("batch line 4: line too long", result.stderr)
+        self.assertIn("batch line 5: %s OK" % NEXRAD, result.stderr)
+        self.assertIn("batch done: 4 volumes processed, 2 succeeded, 2 failed", result.stderr)
+
+        rows = self._run(["-i", NEXRAD])
+        self.assertEqual(self._rows(result.stdout), rows + rows)
+
+
+if __name__ == "__main__":
+    unittest.main()